@@ -25,6 +25,54 @@ void benchmark_SparseMatrix_Insertion_Host(int N)
         " us" << std::endl;
 }
 
+// Concurrent insertion into the lock-free table preallocated from a capacity hint
+void benchmark_SparseMatrix_Hinted_Insertion_Host(int N)
+{
+    SparseMatrix_h<double> A;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    A.reserve(N);
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        A.insert_entry(i, i, 1.0);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Hinted insertion on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << \
+        " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    A.make_matrix();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Make matrix from hinted insertion on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << \
+        " us" << std::endl;
+}
+
+// Insertion bucketed by row from a sparsity pattern hint, make_matrix only sorts within rows
+void benchmark_SparseMatrix_Pattern_Insertion_Host(int N)
+{
+    SparseMatrix_h<double> A;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    A.set_pattern_hint(N, 9);
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = 4; k >= -4; k--)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, 1.0 + k);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Pattern hinted insertion of 9 entries per row on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << \
+        " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    A.make_matrix();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Make matrix from pattern hinted insertion on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << \
+        " us" << std::endl;
+}
+
 void benchmark_SparseMatrix_Insertion_Device(int N)
 {
     SparseMatrix_d<double> A;
@@ -88,6 +136,24 @@ void benchmark_SpMV_Host(int N)
 	std::cout << "Transpose SpMV on host of size " << N << ": " << \
 		std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
 		" us" << std::endl;
+
+    // Hand-written CSR kernels against the generic path above
+    if constexpr(std::is_same_v<T, dcomplex> || std::is_same_v<T, fcomplex> ||
+                 std::is_same_v<T, half> || std::is_same_v<T, __nv_bfloat16> ||
+                 std::is_same_v<T, hcomplex> || std::is_same_v<T, bcomplex>)
+    {
+        A.set_spmv_backend(SpMVBackend::SIMD);
+        for (int i = 0; i < 100; i++)
+            A.SpMV(x, y);
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 100; i++)
+            A.SpMV(x, y);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << SpMV_isa_name(SpMV_detect_isa()) << " SpMV on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+            " us" << std::endl;
+    }
     return;
 }
 
@@ -138,6 +204,536 @@ void benchmark_SpMV_Device(int N)
 }
 
 
+// Interleaved against split-complex storage for SpMV and the BLAS-1 kernels of a solve
+template<typename Real>
+void benchmark_SpMV_Split_Host(int N)
+{
+    using T = thrust::complex<Real>;
+    SparseMatrix_h<T> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, T(Real(1.0 + k), Real(0.5 * k)));
+    A.make_matrix();
+
+    Vector_h<T> x(N, T(1.0, 0.5)), y(N);
+    SplitVector<Real> xs(x), ys(N);
+
+    for (int i = 0; i < 10; i++)
+    {
+        A.SpMV(x, y);
+        A.SpMV(xs, ys);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        A.SpMV(x, y);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Interleaved SpMV on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        A.SpMV(xs, ys);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Split SpMV on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    A.set_spmv_backend(SpMVBackend::SIMD);
+    for (int i = 0; i < 10; i++)
+        A.SpMV(x, y);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        A.SpMV(x, y);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << SpMV_isa_name(SpMV_detect_isa()) << " SpMV on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        Vector_element_wise_multiply_Vector(x, y, y);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Interleaved pointwise multiply on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        Vector_element_wise_multiply_Vector(xs, ys, ys);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Split pointwise multiply on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+}
+
+
+// 16-bit storage with fp32 accumulation against the fp32 matrix of the same pattern, banded so the products are bandwidth bound
+template<typename T, typename Reference>
+void benchmark_SpMV_Half_Host(int N)
+{
+    SparseMatrix_h<T> A;
+    SparseMatrix_h<Reference> R;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -16; k <= 16; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+            {
+                A.insert_entry(i, i + 37 * k, T(1.0 + 0.01 * k));
+                R.insert_entry(i, i + 37 * k, Reference(1.0 + 0.01 * k));
+            }
+    A.make_matrix();
+    R.make_matrix();
+
+    Vector_h<T> x(N, T(1.0)), y(N);
+    Vector_h<Reference> xr(N, Reference(1.0)), yr(N);
+    if constexpr(std::is_same_v<Reference, fcomplex>)
+        R.set_spmv_backend(SpMVBackend::SIMD);
+    for (int i = 0; i < 10; i++)
+        R.SpMV(xr, yr);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        R.SpMV(xr, yr);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "fp32 SpMV on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    for (int i = 0; i < 10; i++)
+        A.SpMV(x, y);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        A.SpMV(x, y);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Generic 16-bit SpMV on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+
+    A.set_spmv_backend(SpMVBackend::SIMD);
+    for (int i = 0; i < 10; i++)
+        A.SpMV(x, y);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++)
+        A.SpMV(x, y);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << SpMV_isa_name(SpMV_detect_isa()) << " 16-bit SpMV with fp32 accumulation on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+        " us" << std::endl;
+}
+
+
+// Transposed products on the row-ordered storage, per parallelization strategy
+template<typename T>
+void benchmark_SpMV_Transpose_Host(int N, bool scattered)
+{
+    SparseMatrix_h<T> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+        {
+            long long j = scattered ? (i * 7919LL + k * 104729LL + N) % N : i + 37 * k;
+            if (j >= 0 && j < N)
+                A.insert_entry(i, j, T(1.0 + k));
+        }
+    A.make_matrix();
+
+    Vector_h<T> x(N, T(1.0)), y(N);
+    for (auto strategy : {TransposeStrategy::Auto, TransposeStrategy::Coloring, TransposeStrategy::ThreadBuffers, TransposeStrategy::Atomics})
+    {
+        A.set_transpose_strategy(strategy);
+        for (int i = 0; i < 10; i++)
+            A.SpMV(x, y, true);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 100; i++)
+            A.SpMV(x, y, true);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Transpose SpMV (" << Transpose_strategy_name(strategy) << " -> " << Transpose_strategy_name(A.get_transpose_strategy()) << \
+            (scattered ? ", scattered" : ", banded") << ") on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+            " us" << std::endl;
+    }
+}
+
+
+// Same product through every backend that takes T, the generic path is the reference
+template<typename T>
+void benchmark_SpMV_Backends_Host(int N)
+{
+    SparseMatrix_h<T> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, T(1.0 + k));
+    A.set_mv_hint(200, {SpMVOperation::NonTranspose, SpMVOperation::Transpose});
+    A.make_matrix();
+
+    Vector_h<T> x(N, T(1.0)), y(N);
+    constexpr bool simd = std::is_same_v<T, dcomplex> || std::is_same_v<T, fcomplex>;
+    for (auto backend : {SpMVBackend::Generic, SpMVBackend::SIMD, SpMVBackend::MKL})
+    {
+        if (backend == SpMVBackend::SIMD && !simd)
+            continue;
+        A.set_spmv_backend(backend);
+        for (bool transpose : {false, true})
+        {
+            for (int i = 0; i < 10; i++)
+                A.SpMV(x, y, transpose);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < 100; i++)
+                A.SpMV(x, y, transpose);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << SpMV_backend_name(backend) << (transpose ? " transpose" : "") << " SpMV on host of size " << N << ": " << \
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << \
+                " us" << std::endl;
+        }
+    }
+}
+
+
+// C = A * A and P^T A P with a fresh plan (symbolic + numeric) and with a reused plan (numeric only)
+template<typename T>
+void benchmark_SpGEMM_Host(int N)
+{
+    SparseMatrix_h<T> A, P, C;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+    {
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, T(1.0 + k));
+        P.insert_entry(i, i / 8, T(1.0));
+    }
+    A.make_matrix();
+    P.make_matrix();
+
+    for (bool triple : {false, true})
+    {
+        for (auto accumulator : {SpGEMMAccumulator::Dense, SpGEMMAccumulator::Hash})
+        {
+            SpGEMMPlan<INDEX_TYPE> plan;
+            auto run = [&]() {
+                if (triple) C.triple_product(P, A, plan, false, accumulator);
+                else C.multiply(A, A, plan, accumulator);
+            };
+            auto start = std::chrono::high_resolution_clock::now();
+            run();
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << (triple ? "Triple product" : "SpGEMM") << (accumulator == SpGEMMAccumulator::Dense ? " (dense" : " (hash") << \
+                ", symbolic + numeric) on host of size " << N << ": " << \
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < 10; i++)
+                run();
+            end = std::chrono::high_resolution_clock::now();
+            std::cout << (triple ? "Triple product" : "SpGEMM") << (accumulator == SpGEMMAccumulator::Dense ? " (dense" : " (hash") << \
+                ", numeric) on host of size " << N << ": " << \
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+        }
+    }
+}
+
+
+// C = alpha * A + beta * B by re-insertion, by the row merge and in place on a contained pattern
+template<typename T>
+void benchmark_Sparse_Add_Host(int N)
+{
+    SparseMatrix_h<T> A, B, C;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+            {
+                A.insert_entry(i, i + 37 * k, T(1.0 + k));
+                if (k % 2 == 0)
+                    B.insert_entry(i, i + 37 * k, T(0.5));
+            }
+    A.make_matrix();
+    B.make_matrix();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto* X : {&A, &B})
+    {
+        auto& x = X->get_matrix();
+        #pragma omp parallel for
+        for (long long k = 0; k < (long long)x.num_entries; k++)
+            C.insert_entry(x.row_indices[k], x.column_indices[k], x.values[k]);
+    }
+    C.make_matrix();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Sparse add (re-insertion) on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 10; i++)
+        C.add(T(1.0), A, T(-1.0), B);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Sparse add (merge) on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 10; i++)
+        A.add_inplace(T(1.0), T(-1.0), B);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Sparse add (in place) on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+}
+
+
+// SpMV on a decaying near-field band with and without a drop tolerance
+template<typename T>
+void benchmark_SpMV_Drop_Host(int N)
+{
+    for (double tolerance : {0.0, 1e-4, 1e-2})
+    {
+        SparseMatrix_h<T> A;
+        A.set_drop_policy({tolerance > 0 ? DropRule::DiagonalRelative : DropRule::None, tolerance});
+        #pragma omp parallel for
+        for (int i = 0; i < N; i++)
+            for (int k = -8; k <= 8; k++)
+                if (i + 37 * k >= 0 && i + 37 * k < N)
+                    A.insert_entry(i, i + 37 * k, T(std::pow(0.3, std::abs(k))));
+        A.make_matrix();
+
+        Vector_h<T> x(N, T(1.0)), y(N);
+        for (int i = 0; i < 10; i++)
+            A.SpMV(x, y);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 100; i++)
+            A.SpMV(x, y);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto& report = A.get_drop_report();
+        std::cout << "SpMV (drop " << tolerance << ", nnz " << report.kept_entries << ", dropped " << report.dropped_entries << \
+            ", relative dropped norm " << report.relative_dropped_norm() << ") on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << " us" << std::endl;
+    }
+}
+
+
+// Assembled near field against the matrix-free operator recomputing a 1/r kernel, without and with a row cache
+void benchmark_Near_Field_Operator_Host(int N)
+{
+    auto value = [](INDEX_TYPE i, INDEX_TYPE j) {
+        double r = 1.0 + std::abs((double)i - (double)j);
+        return dcomplex(std::cos(0.3 * r), -std::sin(0.3 * r)) / r;
+    };
+    SparseMatrix_h<dcomplex> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, value(i, i + 37 * k));
+    A.make_matrix();
+    NearFieldOperator<dcomplex, decltype(value)> F(value);
+    F.set_pattern(A);
+
+    Vector_h<dcomplex> x(N, dcomplex(1.0)), y(N);
+    auto time = [&](auto& op, const std::string& name) {
+        for (int i = 0; i < 5; i++)
+            op.SpMV(x, y);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 20; i++)
+            op.SpMV(x, y);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << name << " SpMV on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 20 << " us" << std::endl;
+    };
+    time(A, "Assembled near-field");
+    time(F, "Matrix-free near-field");
+    F.set_cache_budget(A.get_num_entries() / 2 * sizeof(dcomplex));
+    time(F, "Matrix-free near-field (half of the rows cached)");
+}
+
+
+// GMRES on a badly row-scaled matrix without and with equilibration
+void benchmark_GMRES_Equilibration_Host(int N)
+{
+    SparseMatrix_h<dcomplex> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, std::pow(10.0, (i % 7) - 3) * (k == 0 ? dcomplex(8.0, 1.0) : dcomplex(0.5, 0.1 * k)));
+    A.make_matrix();
+
+    Vector_h<dcomplex> b(N, dcomplex(1.0)), x(N);
+    for (auto method : {EquilibrationMethod::None, EquilibrationMethod::RowColumn, EquilibrationMethod::Ruiz})
+    {
+        A.set_equilibration(method);
+        thrust::fill(x.begin(), x.end(), dcomplex(0.0));
+        auto start = std::chrono::high_resolution_clock::now();
+        A.gmres(x, b, 50, 1000, 1e-8);
+        auto end = std::chrono::high_resolution_clock::now();
+        const char* name = method == EquilibrationMethod::None ? "none" : (method == EquilibrationMethod::Ruiz ? "Ruiz" : "row/column");
+        std::cout << "GMRES (equilibration " << name << ", " << A.get_gmres_iterations() << " iterations) on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+
+// Block-Jacobi over unit cells of 16 rows: setup, application and GMRES iterations
+void benchmark_Block_Jacobi_Host(int N)
+{
+    const int cell = 16;
+    SparseMatrix_h<dcomplex> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+    {
+        const int c = i / cell;
+        for (int j = c * cell; j < std::min(N, (c + 1) * cell); j++)
+            A.insert_entry(i, j, i == j ? dcomplex(4.0, 1.0) : dcomplex(1.0 / (1 + std::abs(i - j)), 0.2));
+        for (int k = 1; k <= 2; k++)
+        {
+            if (i + k * cell < N) A.insert_entry(i, i + k * cell, dcomplex(0.2, 0.1));
+            if (i >= k * cell) A.insert_entry(i, i - k * cell, dcomplex(0.2, -0.1));
+        }
+    }
+    A.make_matrix();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto M = A.block_jacobi(BlockJacobi<dcomplex>::uniform_blocks(N, cell));
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Block-Jacobi extraction and factorization (" << M.num_blocks() << " blocks) on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+    Vector_h<dcomplex> b(N, dcomplex(1.0)), x(N);
+    start = std::chrono::high_resolution_clock::now();
+    for (int k = 0; k < 10; k++)
+        M(b, x);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Block-Jacobi application on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+
+    for (bool preconditioned : {false, true})
+    {
+        thrust::fill(x.begin(), x.end(), dcomplex(0.0));
+        start = std::chrono::high_resolution_clock::now();
+        if (preconditioned) A.gmres(x, b, M, 50, 1000, 1e-8);
+        else A.gmres(x, b, 50, 1000, 1e-8);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "GMRES (" << (preconditioned ? "block-Jacobi" : "no preconditioner") << ", " << A.get_gmres_iterations() << \
+            " iterations) on host of size " << N << ": " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+
+// PARDISO phases against GMRES on a complex symmetric banded matrix: analysis once, factorization per value set, multi-RHS solves
+void benchmark_Pardiso_Host(int N)
+{
+    SparseMatrix_h<dcomplex> A, B;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+            {
+                A.insert_entry(i, i + 37 * k, k == 0 ? dcomplex(6.0, 1.0) : dcomplex(1.0 / (1 + std::abs(k)), 0.1));
+                B.insert_entry(i, i + 37 * k, dcomplex(0.01, 0.0));
+            }
+    A.make_matrix();
+    B.make_matrix();
+
+    const int nrhs = 10;
+    Vector_h<dcomplex> b(N * nrhs, dcomplex(1.0)), x;
+    for (auto type : {PardisoMatrixType::Unsymmetric, PardisoMatrixType::Symmetric})
+    {
+        const char* name = type == PardisoMatrixType::Symmetric ? "symmetric" : "unsymmetric";
+        auto start = std::chrono::high_resolution_clock::now();
+        A.direct_factorize(type);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "PARDISO analysis and factorization (" << name << ") on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        A.add_inplace(dcomplex(1.0), dcomplex(1.0), B);
+        start = std::chrono::high_resolution_clock::now();
+        A.direct_factorize(type);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "PARDISO refactorization (" << name << ") on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        A.direct_solve(x, b, nrhs, type);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "PARDISO solve (" << name << ", " << nrhs << " RHS) on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+    A.release_direct_solver();
+
+    Vector_h<dcomplex> b1(N, dcomplex(1.0)), x1(N, dcomplex(0.0));
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int k = 0; k < nrhs; k++)
+    {
+        thrust::fill(x1.begin(), x1.end(), dcomplex(0.0));
+        A.gmres(x1, b1, 50, 1000, 1e-8);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "GMRES (" << nrhs << " RHS) on host of size " << N << ": " << \
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+}
+
+
+// GMRES against the short recurrences COCG / COCR on a complex symmetric banded matrix
+void benchmark_COCG_COCR_Host(int N)
+{
+    SparseMatrix_h<dcomplex> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+            {
+                const int j = i + 37 * k;
+                A.insert_entry(i, j, k == 0 ? dcomplex(4.0, 1.0) : dcomplex(0.5 / std::abs(k), 0.1 * std::cos(0.01 * (i + j))));
+            }
+    A.make_matrix();
+
+    Vector_h<dcomplex> b(N, dcomplex(1.0)), x(N);
+    for (int solver = 0; solver < 3; solver++)
+    {
+        thrust::fill(x.begin(), x.end(), dcomplex(0.0));
+        auto start = std::chrono::high_resolution_clock::now();
+        if (solver == 0) A.gmres(x, b, 50, 1000, 1e-8);
+        if (solver == 1) A.cocg(x, b, 1000, 1e-8);
+        if (solver == 2) A.cocr(x, b, 1000, 1e-8);
+        auto end = std::chrono::high_resolution_clock::now();
+        const char* name = solver == 0 ? "GMRES(50)" : (solver == 1 ? "COCG" : "COCR");
+        std::cout << name << " (" << A.get_gmres_iterations() << " iterations) on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+
+// GMRES against IDR(s) and BiCGStab(l) on a non-symmetric banded matrix
+void benchmark_IDRs_BiCGStabl_Host(int N)
+{
+    SparseMatrix_h<dcomplex> A;
+    #pragma omp parallel for
+    for (int i = 0; i < N; i++)
+        for (int k = -4; k <= 4; k++)
+            if (i + 37 * k >= 0 && i + 37 * k < N)
+                A.insert_entry(i, i + 37 * k, k == 0 ? dcomplex(4.0, 1.0) : dcomplex((k > 0 ? 0.7 : 0.3) / std::abs(k), 0.1 * k));
+    A.make_matrix();
+
+    Vector_h<dcomplex> b(N, dcomplex(1.0)), x(N);
+    for (int solver = 0; solver < 5; solver++)
+    {
+        thrust::fill(x.begin(), x.end(), dcomplex(0.0));
+        auto start = std::chrono::high_resolution_clock::now();
+        if (solver == 0) A.gmres(x, b, 50, 1000, 1e-8);
+        if (solver == 1) A.idrs(x, b, 4, 1000, 1e-8);
+        if (solver == 2) A.idrs(x, b, 8, 1000, 1e-8);
+        if (solver == 3) A.bicgstabl(x, b, 2, 1000, 1e-8);
+        if (solver == 4) A.bicgstabl(x, b, 4, 1000, 1e-8);
+        auto end = std::chrono::high_resolution_clock::now();
+        const char* names[] = {"GMRES(50)", "IDR(4)", "IDR(8)", "BiCGStab(2)", "BiCGStab(4)"};
+        std::cout << names[solver] << " (" << A.get_gmres_iterations() << " iterations) on host of size " << N << ": " << \
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+
 int main()
 {
 #ifdef USE_OPENMP
@@ -147,6 +743,8 @@ int main()
     std::cout << "**********Benchmark initialized without OpenMP**********" << std::endl;
 #endif
     benchmark_SparseMatrix_Insertion_Host(1e6);
+    benchmark_SparseMatrix_Hinted_Insertion_Host(1e6);
+    benchmark_SparseMatrix_Pattern_Insertion_Host(1e6);
     benchmark_SparseMatrix_Insertion_Device(1e6);
     std::cout << "SpMV Benchmark: bcomplex" << std::endl;
     benchmark_SpMV_Host<puff::bcomplex>(1e6);
@@ -172,5 +770,42 @@ int main()
     std::cout << "SpMV Benchmark: double" << std::endl;
     benchmark_SpMV_Host<double>(1e6);
     benchmark_SpMV_Device<double>(1e6);
+    std::cout << "Split-complex Benchmark: fcomplex" << std::endl;
+    benchmark_SpMV_Split_Host<float>(1e6);
+    std::cout << "Split-complex Benchmark: dcomplex" << std::endl;
+    benchmark_SpMV_Split_Host<double>(1e6);
+    std::cout << "Transpose SpMV Benchmark: dcomplex" << std::endl;
+    benchmark_SpMV_Transpose_Host<dcomplex>(1e6, false);
+    benchmark_SpMV_Transpose_Host<dcomplex>(1e6, true);
+    std::cout << "16-bit storage Benchmark: half" << std::endl;
+    benchmark_SpMV_Half_Host<half, float>(1e6);
+    std::cout << "16-bit storage Benchmark: __nv_bfloat16" << std::endl;
+    benchmark_SpMV_Half_Host<__nv_bfloat16, float>(1e6);
+    std::cout << "16-bit storage Benchmark: hcomplex" << std::endl;
+    benchmark_SpMV_Half_Host<hcomplex, fcomplex>(1e6);
+    std::cout << "16-bit storage Benchmark: bcomplex" << std::endl;
+    benchmark_SpMV_Half_Host<bcomplex, fcomplex>(1e6);
+    std::cout << "SpMV backends Benchmark: double" << std::endl;
+    benchmark_SpMV_Backends_Host<double>(1e6);
+    std::cout << "SpMV backends Benchmark: dcomplex" << std::endl;
+    benchmark_SpMV_Backends_Host<dcomplex>(1e6);
+    std::cout << "SpGEMM Benchmark: dcomplex" << std::endl;
+    benchmark_SpGEMM_Host<dcomplex>(1e6);
+    std::cout << "Sparse add Benchmark: dcomplex" << std::endl;
+    benchmark_Sparse_Add_Host<dcomplex>(1e6);
+    std::cout << "Drop tolerance Benchmark: dcomplex" << std::endl;
+    benchmark_SpMV_Drop_Host<dcomplex>(1e6);
+    std::cout << "Near-field operator Benchmark: dcomplex" << std::endl;
+    benchmark_Near_Field_Operator_Host(1e6);
+    std::cout << "Equilibration Benchmark: dcomplex" << std::endl;
+    benchmark_GMRES_Equilibration_Host(1e5);
+    std::cout << "Block-Jacobi Benchmark: dcomplex" << std::endl;
+    benchmark_Block_Jacobi_Host(1e5);
+    std::cout << "PARDISO Benchmark: dcomplex" << std::endl;
+    benchmark_Pardiso_Host(1e5);
+    std::cout << "Complex symmetric solvers Benchmark: dcomplex" << std::endl;
+    benchmark_COCG_COCR_Host(1e5);
+    std::cout << "Short-recurrence solvers Benchmark: dcomplex" << std::endl;
+    benchmark_IDRs_BiCGStabl_Host(1e5);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "utils.h"
+#include "mkl.h"
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace puff {
+
+    // Block-Jacobi preconditioner: the dense diagonal blocks of a sorted CSR matrix for a partition of its rows
+    // (e.g. unit-cell subdomains), LU-factored with MKL ?getrf_batch and applied with ?getrs_batch.
+    // Blocks are stored column-major one after the other in partition order, blocks of equal size form one
+    // batch group. Host double / float / dcomplex / fcomplex, usable as a cusp preconditioner
+    template<typename ValueType, typename IndexType = INDEX_TYPE>
+    class BlockJacobi : public cusp::linear_operator<ValueType, cusp::host_memory, IndexType> {
+        public:
+            static_assert(std::is_same_v<ValueType, double> || std::is_same_v<ValueType, float> ||
+                          std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>,
+                          "Block-Jacobi supports double, float, dcomplex and fcomplex");
+            static_assert(sizeof(IndexType) == sizeof(MKL_INT), "Block offsets must match MKL_INT (LP64: 32-bit)");
+
+            BlockJacobi() : cusp::linear_operator<ValueType, cusp::host_memory, IndexType>(0, 0) {}
+
+            // block_offsets[b] .. block_offsets[b + 1] are the rows (and columns) of block b, covering all rows.
+            // Throws std::invalid_argument unless the offsets start at 0 and do not decrease
+            explicit BlockJacobi(std::vector<IndexType> block_offsets)
+                : cusp::linear_operator<ValueType, cusp::host_memory, IndexType>(checked_size(block_offsets), checked_size(block_offsets)),
+                  block_offsets(std::move(block_offsets)) {
+                const size_t blocks = num_blocks();
+                value_offsets.assign(blocks + 1, 0);
+                for(size_t b = 0; b < blocks; b++)
+                    value_offsets[b + 1] = value_offsets[b] + block_size(b) * block_size(b);
+                values.assign(value_offsets[blocks], ValueType(0));
+                pivots.assign(this->num_rows, 0);
+                make_groups();
+            }
+
+            // Partition of num_rows into blocks of block_size rows, the last one takes the remainder
+            static std::vector<IndexType> uniform_blocks(size_t num_rows, size_t block_size) {
+                if(block_size == 0) throw std::invalid_argument("BlockJacobi: block size must be positive");
+                if(num_rows > (size_t)std::numeric_limits<IndexType>::max())
+                    throw std::invalid_argument("BlockJacobi: number of rows exceeds IndexType");
+                std::vector<IndexType> offsets;
+                for(size_t r = 0; r < num_rows; r += block_size) offsets.push_back((IndexType)r);
+                offsets.push_back((IndexType)num_rows);
+                return offsets;
+            }
+
+            size_t num_blocks() const { return block_offsets.size() - 1; }
+            size_t block_size(size_t b) const { return block_offsets[b + 1] - block_offsets[b]; }
+            const std::vector<IndexType>& get_block_offsets() const { return block_offsets; }
+
+            // Column-major block b, factored in place after factor()
+            const ValueType* block(size_t b) const { return values.data() + value_offsets[b]; }
+
+            // Copies the diagonal blocks out of the CSR arrays in one parallel pass over the blocks,
+            // each row bisects to the start of its block's column range
+            void extract(const IndexType* row_offsets, const IndexType* column_indices, const ValueType* matrix_values) {
+                factored = false;
+                #pragma omp parallel for schedule(dynamic, 1)
+                for(long long b = 0; b < (long long)num_blocks(); b++)
+                {
+                    const IndexType first = block_offsets[b], last = block_offsets[b + 1], n = last - first;
+                    ValueType* dense = values.data() + value_offsets[b];
+                    std::fill(dense, dense + (size_t)n * n, ValueType(0));
+                    for(IndexType i = first; i < last; i++)
+                    {
+                        const IndexType* begin = column_indices + row_offsets[i];
+                        const IndexType* end = column_indices + row_offsets[i + 1];
+                        for(const IndexType* c = std::lower_bound(begin, end, first); c != end && *c < last; c++)
+                            dense[(size_t)(*c - first) * n + (i - first)] = matrix_values[c - column_indices];
+                    }
+                }
+            }
+
+            // LU with partial pivoting of every block, returns the number of singular blocks
+            size_t factor() {
+                // order holds the non-empty blocks only
+                std::vector<MKL_INT> info(order.size(), 0);
+                std::vector<ValueType*> a(order.size());
+                std::vector<MKL_INT*> ipiv(order.size());
+                for(size_t k = 0; k < order.size(); k++)
+                {
+                    a[k] = values.data() + value_offsets[order[k]];
+                    ipiv[k] = pivots.data() + block_offsets[order[k]];
+                }
+                const MKL_INT group_count = (MKL_INT)group_sizes.size();
+                if(group_count > 0)
+                {
+                    if constexpr(std::is_same_v<ValueType, double>)
+                        dgetrf_batch(group_n.data(), group_n.data(), a.data(), group_n.data(), ipiv.data(), &group_count, group_sizes.data(), info.data());
+                    else if constexpr(std::is_same_v<ValueType, float>)
+                        sgetrf_batch(group_n.data(), group_n.data(), a.data(), group_n.data(), ipiv.data(), &group_count, group_sizes.data(), info.data());
+                    else if constexpr(std::is_same_v<ValueType, dcomplex>)
+                        zgetrf_batch(group_n.data(), group_n.data(), reinterpret_cast<MKL_Complex16**>(a.data()), group_n.data(), ipiv.data(),
+                                     &group_count, group_sizes.data(), info.data());
+                    else
+                        cgetrf_batch(group_n.data(), group_n.data(), reinterpret_cast<MKL_Complex8**>(a.data()), group_n.data(), ipiv.data(),
+                                     &group_count, group_sizes.data(), info.data());
+                }
+                factored = true;
+                return (size_t)std::count_if(info.begin(), info.end(), [](MKL_INT i) { return i != 0; });
+            }
+
+            // y = M^{-1} x, block by block. x may alias y. Throws std::logic_error before factor()
+            void apply(const ValueType* x, ValueType* y) const {
+                if(!factored) throw std::logic_error("BlockJacobi: apply before factor");
+                if(x != y) std::copy(x, x + this->num_rows, y);
+                std::vector<ValueType*> a(order.size()), rhs(order.size());
+                std::vector<MKL_INT*> ipiv(order.size());
+                for(size_t k = 0; k < order.size(); k++)
+                {
+                    a[k] = const_cast<ValueType*>(values.data()) + value_offsets[order[k]];
+                    ipiv[k] = const_cast<MKL_INT*>(pivots.data()) + block_offsets[order[k]];
+                    rhs[k] = y + block_offsets[order[k]];
+                }
+                std::vector<MKL_INT> info(order.size(), 0);
+                const std::vector<char> trans(group_sizes.size(), 'N');
+                const std::vector<MKL_INT> nrhs(group_sizes.size(), 1);
+                const MKL_INT group_count = (MKL_INT)group_sizes.size();
+                if(group_count == 0) return;
+                if constexpr(std::is_same_v<ValueType, double>)
+                    dgetrs_batch(trans.data(), group_n.data(), nrhs.data(), a.data(), group_n.data(), ipiv.data(),
+                                 rhs.data(), group_n.data(), &group_count, group_sizes.data(), info.data());
+                else if constexpr(std::is_same_v<ValueType, float>)
+                    sgetrs_batch(trans.data(), group_n.data(), nrhs.data(), a.data(), group_n.data(), ipiv.data(),
+                                 rhs.data(), group_n.data(), &group_count, group_sizes.data(), info.data());
+                else if constexpr(std::is_same_v<ValueType, dcomplex>)
+                    zgetrs_batch(trans.data(), group_n.data(), nrhs.data(), reinterpret_cast<MKL_Complex16**>(a.data()), group_n.data(), ipiv.data(),
+                                 reinterpret_cast<MKL_Complex16**>(rhs.data()), group_n.data(), &group_count, group_sizes.data(), info.data());
+                else
+                    cgetrs_batch(trans.data(), group_n.data(), nrhs.data(), reinterpret_cast<MKL_Complex8**>(a.data()), group_n.data(), ipiv.data(),
+                                 reinterpret_cast<MKL_Complex8**>(rhs.data()), group_n.data(), &group_count, group_sizes.data(), info.data());
+            }
+
+            // cusp preconditioner interface
+            template<typename Array1, typename Array2>
+            void operator()(const Array1& x, Array2& y) const {
+                if(x.size() != (size_t)this->num_rows || y.size() != (size_t)this->num_rows)
+                    throw std::invalid_argument("BlockJacobi: vector length does not match the number of rows");
+                apply(&x[0], &y[0]);
+            }
+
+        private:
+            std::vector<IndexType> block_offsets;
+            std::vector<size_t> value_offsets; // block b starts at values[value_offsets[b]]
+            std::vector<ValueType> values;
+            std::vector<MKL_INT> pivots;       // pivots of block b start at pivots[block_offsets[b]]
+            bool factored = false;
+
+            // Batch groups: blocks sorted by size (stable), group_n[g] is the size of the group_sizes[g] blocks of group g
+            std::vector<size_t> order;
+            std::vector<MKL_INT> group_n, group_sizes;
+
+            static IndexType checked_size(const std::vector<IndexType>& offsets) {
+                if(offsets.size() < 2 || offsets.front() != 0)
+                    throw std::invalid_argument("BlockJacobi: block offsets must start at 0 and hold at least one block");
+                if(!std::is_sorted(offsets.begin(), offsets.end()))
+                    throw std::invalid_argument("BlockJacobi: block offsets must not decrease");
+                return offsets.back();
+            }
+
+            void make_groups() {
+                order.resize(num_blocks());
+                for(size_t b = 0; b < order.size(); b++) order[b] = b;
+                std::stable_sort(order.begin(), order.end(), [&](size_t u, size_t v) { return block_size(u) < block_size(v); });
+                group_n.clear();
+                group_sizes.clear();
+                for(size_t b : order)
+                {
+                    if(block_size(b) == 0) continue;
+                    if(group_n.empty() || group_n.back() != (MKL_INT)block_size(b))
+                    {
+                        group_n.push_back((MKL_INT)block_size(b));
+                        group_sizes.push_back(0);
+                    }
+                    group_sizes.back()++;
+                }
+                // Empty blocks come first in order and are left out of the batch
+                order.erase(order.begin(), order.begin() + (order.size() - std::accumulate(group_sizes.begin(), group_sizes.end(), (size_t)0)));
+            }
+    };
+
+}
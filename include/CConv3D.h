@@ -19,6 +19,34 @@ class FFT3D{
     ~FFT3D() {}
 };
 
+// Host 3D complex FFT on MKL DFTI, row-major (nx, ny, nz) with z fastest, in-place, unnormalized
+template<typename ValueType>
+class FFT3D<ValueType, cusp::host_memory>{
+    public:
+        FFT3D() {}
+        FFT3D(size_t nx, size_t ny, size_t nz) { plan(nx, ny, nz); }
+        ~FFT3D() { destroy(); }
+
+        FFT3D(const FFT3D&) = delete;
+        FFT3D& operator=(const FFT3D&) = delete;
+
+        void plan(size_t nx, size_t ny, size_t nz);
+
+        // data = sum exp(-i k.x) data
+        void forward(Vector<ValueType, cusp::host_memory>& data);
+
+        // data = sum exp(+i k.x) data
+        void backward(Vector<ValueType, cusp::host_memory>& data);
+
+        size_t size() const { return nx * ny * nz; }
+
+    private:
+        DFTI_DESCRIPTOR_HANDLE handle = nullptr;
+        size_t nx = 0, ny = 0, nz = 0;
+
+        void destroy();
+};
+
 
 template<typename ValueType, typename MemorySpace> // Derived class
 class CCONV3D{
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "utils.h"
+#include <atomic>
+#include <memory>
+
+namespace puff {
+
+    // Open-addressing hash table keyed on packed 64-bit (row, col) keys with "set" semantics from many threads.
+    // Slots are claimed with a CAS on the key and never released, so a key always lives inside the
+    // max_probe window of its home slot. When that window is full of other keys, assign() returns false
+    // and the caller keeps the entry elsewhere; the window stays full, so the same key never lands in both.
+    // Concurrent assigns of the same key serialize on a one byte slot flag, everything else is lock-free.
+    template<typename ValueType>
+    class ConcurrentHashMap {
+        public:
+            static constexpr uint64_t empty_key = ~uint64_t(0);
+
+            ConcurrentHashMap() {}
+            explicit ConcurrentHashMap(size_t capacity_hint, size_t max_probe = 128) { reserve(capacity_hint, max_probe); }
+
+            // Allocates a power of two of slots for a load factor of at most 0.7 and clears the table, not thread safe
+            void reserve(size_t capacity_hint, size_t max_probe = 128) {
+                size_t slots = 1;
+                shift = 64;
+                while(slots * 7 < capacity_hint * 10) { slots <<= 1; shift--; }
+                num_slots = capacity_hint > 0 ? slots : 0;
+                this->max_probe = std::min(max_probe, num_slots);
+                keys.reset(num_slots ? new std::atomic<uint64_t>[num_slots] : nullptr);
+                flags.reset(num_slots ? new std::atomic<uint8_t>[num_slots] : nullptr);
+                values.reset(num_slots ? new ValueType[num_slots] : nullptr);
+                #pragma omp parallel for schedule(static)
+                for(long long s = 0; s < (long long)num_slots; s++)
+                {
+                    keys[s].store(empty_key, std::memory_order_relaxed);
+                    flags[s].store(0, std::memory_order_relaxed);
+                }
+            }
+
+            // Empties the table but keeps its slots, not thread safe
+            void reset() {
+                #pragma omp parallel for schedule(static)
+                for(long long s = 0; s < (long long)num_slots; s++)
+                    keys[s].store(empty_key, std::memory_order_relaxed);
+            }
+
+            void clear() {
+                keys.reset();
+                flags.reset();
+                values.reset();
+                num_slots = 0;
+                max_probe = 0;
+            }
+
+            size_t capacity() const { return num_slots; }
+
+            // key -> value, overwriting an existing value. False when the probe window of key is full
+            bool assign(uint64_t key, const ValueType& value) {
+                if(num_slots == 0) return false;
+                for(size_t p = 0, s = home(key); p < max_probe; p++, s = (s + 1) & (num_slots - 1))
+                {
+                    uint64_t current = keys[s].load(std::memory_order_acquire);
+                    if(current == empty_key)
+                    {
+                        if(keys[s].compare_exchange_strong(current, key, std::memory_order_acq_rel))
+                            current = key;
+                    }
+                    if(current == key)
+                    {
+                        write(s, value);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Overwrites the value of key if present, no slot is claimed otherwise
+            bool update(uint64_t key, const ValueType& value) {
+                if(num_slots == 0) return false;
+                for(size_t p = 0, s = home(key); p < max_probe; p++, s = (s + 1) & (num_slots - 1))
+                {
+                    uint64_t current = keys[s].load(std::memory_order_acquire);
+                    if(current == empty_key) return false;
+                    if(current == key)
+                    {
+                        write(s, value);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            size_t size() const {
+                size_t count = 0;
+                #pragma omp parallel for schedule(static) reduction(+:count)
+                for(long long s = 0; s < (long long)num_slots; s++)
+                    count += keys[s].load(std::memory_order_relaxed) != empty_key;
+                return count;
+            }
+
+            // Parallel compaction of the occupied slots satisfying keep(value) into keys / values,
+            // in slot order (no rehash). Returns the number of entries written
+            template<typename Keep>
+            size_t extract(uint64_t* out_keys, ValueType* out_values, Keep keep) const {
+                const int threads = omp_get_max_threads();
+                std::vector<size_t> offsets(threads + 1, 0);
+                #pragma omp parallel num_threads(threads)
+                {
+                    const int t = omp_get_thread_num(), team = omp_get_num_threads();
+                    const size_t begin = num_slots * t / team, end = num_slots * (t + 1) / team;
+                    size_t count = 0;
+                    for(size_t s = begin; s < end; s++)
+                        count += keys[s].load(std::memory_order_relaxed) != empty_key && keep(values[s]);
+                    offsets[t + 1] = count;
+                    #pragma omp barrier
+                    #pragma omp single
+                    for(int u = 0; u < team; u++) offsets[u + 1] += offsets[u];
+                    size_t position = offsets[t];
+                    for(size_t s = begin; s < end; s++)
+                    {
+                        uint64_t key = keys[s].load(std::memory_order_relaxed);
+                        if(key == empty_key || !keep(values[s])) continue;
+                        out_keys[position] = key;
+                        out_values[position] = values[s];
+                        position++;
+                    }
+                }
+                size_t total = 0;
+                for(int t = 0; t < threads; t++) total = std::max(total, offsets[t + 1]);
+                return total;
+            }
+
+        private:
+            size_t num_slots = 0, max_probe = 0;
+            int shift = 64;
+            std::unique_ptr<std::atomic<uint64_t>[]> keys;
+            std::unique_ptr<std::atomic<uint8_t>[]> flags;
+            std::unique_ptr<ValueType[]> values;
+
+            // Fibonacci hashing, spreads consecutive columns of a row over the table
+            size_t home(uint64_t key) const { return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift); }
+
+            void write(size_t s, const ValueType& value) {
+                uint8_t expected = 0;
+                while(!flags[s].compare_exchange_weak(expected, 1, std::memory_order_acquire)) expected = 0;
+                values[s] = value;
+                flags[s].store(0, std::memory_order_release);
+            }
+    };
+
+}
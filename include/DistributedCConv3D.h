@@ -0,0 +1,451 @@
+#pragma once
+
+#include "CConv3D.h"
+#include "DistributedSparseMatrix.h"
+#include <mpi.h>
+
+namespace puff{
+
+// Pencil-decomposed 3D complex FFT over a P1 x P2 process grid, host memory only
+// Real space is in X-pencils: local array [nz_local][ny_local][Nx], x complete, y split over P1, z split over P2.
+// Spectral space is in Z-pencils: local array [nx_local][ny_local][Nz], z complete, x split over P1, y split over P2.
+// Each transpose is pipelined in chunks: the all-to-all of one chunk is in flight while the next chunk's 1D FFTs run,
+// pending exchanges are tested between the batches so the MPI library progresses them.
+template<typename ValueType>
+class DistributedFFT3D{
+    public:
+        DistributedFFT3D(MPI_Comm comm, size_t Nx, size_t Ny, size_t Nz, int P1 = 0, int P2 = 0, int chunks = 4);
+        ~DistributedFFT3D();
+
+        DistributedFFT3D(const DistributedFFT3D&) = delete;
+        DistributedFFT3D& operator=(const DistributedFFT3D&) = delete;
+
+        // X-pencil real space -> Z-pencil spectrum, exp(-i k.x), collective
+        void forward(const Vector<ValueType, cusp::host_memory>& in, Vector<ValueType, cusp::host_memory>& out);
+        // Z-pencil spectrum -> X-pencil real space, exp(+i k.x), unnormalized, collective
+        void backward(const Vector<ValueType, cusp::host_memory>& in, Vector<ValueType, cusp::host_memory>& out);
+
+        // Local extents and global offsets of the two layouts, index 0 = x, 1 = y, 2 = z
+        size_t real_size() const { return real_n[0] * real_n[1] * real_n[2]; }
+        size_t spectral_size() const { return spec_n[0] * spec_n[1] * spec_n[2]; }
+        const size_t* real_extent() const { return real_n; }
+        const size_t* real_offset() const { return real_o; }
+        const size_t* spectral_extent() const { return spec_n; }
+        const size_t* spectral_offset() const { return spec_o; }
+
+        // Accumulated seconds spent in communication (posting and waiting) and in local FFT / packing
+        double get_comm_time() const { return comm_time; }
+        double get_compute_time() const { return compute_time; }
+        void reset_timers() { comm_time = compute_time = 0; }
+
+    private:
+        MPI_Comm grid_comm, row_comm, col_comm;
+        int dims[2] = {0, 0};
+        int coords[2] = {0, 0};
+        size_t N[3];
+        int chunks;
+
+        size_t real_n[3], real_o[3];   // X-pencil
+        size_t mid_n[3], mid_o[3];     // Y-pencil, local array [nz][nx][Ny]
+        size_t spec_n[3], spec_o[3];   // Z-pencil
+
+        // Batched descriptors of each axis, keyed by their number of lines
+        std::vector<std::pair<size_t, DFTI_DESCRIPTOR_HANDLE>> batches[3];
+        Vector<ValueType, cusp::host_memory> mid, send_buffer, recv_buffer;
+
+        double comm_time = 0, compute_time = 0;
+
+        static size_t block_begin(size_t n, int parts, int p) { return n * p / parts; }
+        static size_t block_size(size_t n, int parts, int p) { return block_begin(n, parts, p + 1) - block_begin(n, parts, p); }
+
+        // In-place 1D transforms of count contiguous lines of length N[axis], one batched DFTI call
+        void fft_lines(int axis, ValueType* data, size_t count, bool forward);
+        DFTI_DESCRIPTOR_HANDLE batch(int axis, size_t count);
+
+        // MPI_Test on the pending requests
+        static void progress(std::vector<MPI_Request>& requests);
+
+        // X-pencil <-> Y-pencil within row_comm, Y-pencil <-> Z-pencil within col_comm
+        void transpose_xy(ValueType* x_pencil, bool forward);
+        void transpose_yz(ValueType* z_pencil, bool forward);
+};
+
+// Circular 3D convolution with the kernel spectrum kept in the distributed Z-pencil layout,
+// so the pointwise multiply needs no communication
+template<typename ValueType>
+class DistributedCCONV3D{
+    public:
+        DistributedCCONV3D(MPI_Comm comm, size_t Nx, size_t Ny, size_t Nz, int P1 = 0, int P2 = 0, int chunks = 4)
+            : fft3d(comm, Nx, Ny, Nz, P1, P2, chunks), scale(1.0 / (double(Nx) * Ny * Nz)) {}
+
+        // Kernel in X-pencil layout, transformed once
+        void set_kernel(const Vector<ValueType, cusp::host_memory>& kernel) {
+            fft3d.forward(kernel, kernel_spectrum);
+            Vector_element_wise_multiply_Constant(kernel_spectrum, ValueType(scale), kernel_spectrum);
+        }
+
+        // data = kernel (*) data, data in X-pencil layout, collective
+        void convolve(Vector<ValueType, cusp::host_memory>& data) {
+            fft3d.forward(data, spectrum);
+            Vector_element_wise_multiply_Vector(spectrum, kernel_spectrum, spectrum);
+            fft3d.backward(spectrum, data);
+        }
+
+        DistributedFFT3D<ValueType>& get_fft() { return fft3d; }
+
+    private:
+        DistributedFFT3D<ValueType> fft3d;
+        typename cusp::norm_type<ValueType>::type scale;
+        Vector<ValueType, cusp::host_memory> kernel_spectrum, spectrum;
+};
+
+template<typename ValueType>
+DistributedFFT3D<ValueType>::DistributedFFT3D(MPI_Comm comm, size_t Nx, size_t Ny, size_t Nz, int P1, int P2, int chunks)
+    : N{Nx, Ny, Nz}, chunks(std::max(1, chunks))
+{
+    static_assert(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>,
+                  "DistributedFFT3D supports dcomplex and fcomplex only");
+    int size;
+    MPI_Comm_size(comm, &size);
+    dims[0] = P1; dims[1] = P2;
+    MPI_Dims_create(size, 2, dims);
+    int periods[2] = {0, 0};
+    MPI_Cart_create(comm, 2, dims, periods, 0, &grid_comm);
+    int rank;
+    MPI_Comm_rank(grid_comm, &rank);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    int keep_p1[2] = {1, 0}, keep_p2[2] = {0, 1};
+    MPI_Cart_sub(grid_comm, keep_p1, &row_comm);
+    MPI_Cart_sub(grid_comm, keep_p2, &col_comm);
+
+    const int p1 = coords[0], p2 = coords[1];
+    real_n[0] = N[0];                            real_o[0] = 0;
+    real_n[1] = block_size(N[1], dims[0], p1);   real_o[1] = block_begin(N[1], dims[0], p1);
+    real_n[2] = block_size(N[2], dims[1], p2);   real_o[2] = block_begin(N[2], dims[1], p2);
+    mid_n[0] = block_size(N[0], dims[0], p1);    mid_o[0] = block_begin(N[0], dims[0], p1);
+    mid_n[1] = N[1];                             mid_o[1] = 0;
+    mid_n[2] = real_n[2];                        mid_o[2] = real_o[2];
+    spec_n[0] = mid_n[0];                        spec_o[0] = mid_o[0];
+    spec_n[1] = block_size(N[1], dims[1], p2);   spec_o[1] = block_begin(N[1], dims[1], p2);
+    spec_n[2] = N[2];                            spec_o[2] = 0;
+
+    mid.resize(mid_n[0] * mid_n[1] * mid_n[2]);
+    size_t buffer = std::max(real_size(), std::max(mid.size(), spectral_size()));
+    send_buffer.resize(buffer);
+    recv_buffer.resize(buffer);
+}
+
+template<typename ValueType>
+DistributedFFT3D<ValueType>::~DistributedFFT3D()
+{
+    for(auto& axis : batches)
+        for(auto& [count, handle] : axis) DftiFreeDescriptor(&handle);
+    int finalized;
+    MPI_Finalized(&finalized);
+    if(finalized) return;
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&col_comm);
+    MPI_Comm_free(&grid_comm);
+}
+
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::fft_lines(int axis, ValueType* data, size_t count, bool forward)
+{
+    if(N[axis] <= 1 || count == 0) return;
+    DFTI_DESCRIPTOR_HANDLE handle = batch(axis, count);
+    if(forward)
+    {
+        CHECK_DFTI(DftiComputeForward(handle, data));
+    }
+    else
+    {
+        CHECK_DFTI(DftiComputeBackward(handle, data));
+    }
+}
+
+// A chunking yields at most two line counts per axis besides the whole pencil, committed on first use
+template<typename ValueType>
+DFTI_DESCRIPTOR_HANDLE DistributedFFT3D<ValueType>::batch(int axis, size_t count)
+{
+    for(auto& [lines, handle] : batches[axis])
+        if(lines == count) return handle;
+    constexpr auto precision = std::is_same_v<ValueType, dcomplex> ? DFTI_DOUBLE : DFTI_SINGLE;
+    DFTI_DESCRIPTOR_HANDLE handle = nullptr;
+    CHECK_DFTI(DftiCreateDescriptor(&handle, precision, DFTI_COMPLEX, 1, (MKL_LONG)N[axis]));
+    CHECK_DFTI(DftiSetValue(handle, DFTI_PLACEMENT, DFTI_INPLACE));
+    CHECK_DFTI(DftiSetValue(handle, DFTI_NUMBER_OF_TRANSFORMS, (MKL_LONG)count));
+    CHECK_DFTI(DftiSetValue(handle, DFTI_INPUT_DISTANCE, (MKL_LONG)N[axis]));
+    CHECK_DFTI(DftiSetValue(handle, DFTI_OUTPUT_DISTANCE, (MKL_LONG)N[axis]));
+    CHECK_DFTI(DftiCommitDescriptor(handle));
+    batches[axis].emplace_back(count, handle);
+    return handle;
+}
+
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::progress(std::vector<MPI_Request>& requests)
+{
+    int flag;
+    for(auto& request : requests)
+        if(request != MPI_REQUEST_NULL) MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+}
+
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::forward(const Vector<ValueType, cusp::host_memory>& in, Vector<ValueType, cusp::host_memory>& out)
+{
+    assert(in.size() == real_size());
+    Vector<ValueType, cusp::host_memory> x_pencil(in);
+    out.resize(spectral_size());
+    transpose_xy(thrust::raw_pointer_cast(x_pencil.data()), true);
+    transpose_yz(thrust::raw_pointer_cast(out.data()), true);
+    double t0 = MPI_Wtime();
+    fft_lines(2, thrust::raw_pointer_cast(out.data()), spec_n[0] * spec_n[1], true);
+    compute_time += MPI_Wtime() - t0;
+}
+
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::backward(const Vector<ValueType, cusp::host_memory>& in, Vector<ValueType, cusp::host_memory>& out)
+{
+    assert(in.size() == spectral_size());
+    Vector<ValueType, cusp::host_memory> z_pencil(in);
+    out.resize(real_size());
+    transpose_yz(thrust::raw_pointer_cast(z_pencil.data()), false);
+    transpose_xy(thrust::raw_pointer_cast(out.data()), false);
+    double t0 = MPI_Wtime();
+    fft_lines(0, thrust::raw_pointer_cast(out.data()), real_n[1] * real_n[2], false);
+    compute_time += MPI_Wtime() - t0;
+}
+
+// forward: x-FFT on the X-pencil chunk by chunk of z planes, exchange into mid, then y-FFT on mid
+// backward: y-IFFT on mid chunk by chunk of z planes, exchange into the X-pencil
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::transpose_xy(ValueType* x_pencil, bool forward)
+{
+    const int P = dims[0], me = coords[0];
+    const size_t nz = real_n[2], ny = real_n[1], nx = mid_n[0];
+    ValueType* y_pencil = thrust::raw_pointer_cast(mid.data());
+    ValueType* sbuf = thrust::raw_pointer_cast(send_buffer.data());
+    ValueType* rbuf = thrust::raw_pointer_cast(recv_buffer.data());
+
+    const int num_chunks = (int)std::max<size_t>(1, std::min<size_t>(chunks, nz));
+    std::vector<MPI_Request> requests(num_chunks, MPI_REQUEST_NULL);
+    std::vector<AlltoallvPlan> plans(num_chunks, AlltoallvPlan(P));
+    std::vector<size_t> offsets(num_chunks + 1);
+    for(int c = 0; c <= num_chunks; c++) offsets[c] = block_begin(nz, num_chunks, c);
+
+    for(int c = 0; c < num_chunks; c++)
+    {
+        const size_t z0 = offsets[c], nzc = offsets[c + 1] - offsets[c];
+        double t0 = MPI_Wtime();
+        // Chunk c covers z planes [z0, z0 + nzc), its share of either buffer starts at z0 times the per-plane volume
+        size_t sd = z0 * (forward ? ny * N[0] : nx * N[1]), rd = z0 * (forward ? nx * N[1] : ny * N[0]);
+        for(int q = 0; q < P; q++)
+        {
+            size_t ns = forward ? nzc * ny * block_size(N[0], P, q) : nzc * nx * block_size(N[1], P, q);
+            size_t nr = forward ? nzc * block_size(N[1], P, q) * nx : nzc * block_size(N[0], P, q) * ny;
+            plans[c].scounts[q] = ns; plans[c].sdispls[q] = sd; sd += ns;
+            plans[c].rcounts[q] = nr; plans[c].rdispls[q] = rd; rd += nr;
+        }
+
+        if(forward)
+        {
+            fft_lines(0, x_pencil + z0 * ny * N[0], nzc * ny, true);
+            // [z][y][x in x-range of q]
+            #pragma omp parallel for
+            for(int q = 0; q < P; q++)
+            {
+                const size_t xq0 = block_begin(N[0], P, q), nxq = block_size(N[0], P, q);
+                ValueType* dst = sbuf + plans[c].sdispls[q];
+                for(size_t z = 0; z < nzc; z++)
+                    for(size_t y = 0; y < ny; y++)
+                    {
+                        const ValueType* src = x_pencil + ((z0 + z) * ny + y) * N[0] + xq0;
+                        std::copy(src, src + nxq, dst);
+                        dst += nxq;
+                    }
+            }
+        }
+        else
+        {
+            fft_lines(1, y_pencil + z0 * nx * N[1], nzc * nx, false);
+            // [z][x][y in y-range of q]
+            #pragma omp parallel for
+            for(int q = 0; q < P; q++)
+            {
+                const size_t yq0 = block_begin(N[1], P, q), nyq = block_size(N[1], P, q);
+                ValueType* dst = sbuf + plans[c].sdispls[q];
+                for(size_t z = 0; z < nzc; z++)
+                    for(size_t x = 0; x < nx; x++)
+                    {
+                        const ValueType* src = y_pencil + ((z0 + z) * nx + x) * N[1] + yq0;
+                        std::copy(src, src + nyq, dst);
+                        dst += nyq;
+                    }
+            }
+        }
+        double t1 = MPI_Wtime();
+        plans[c].start(sbuf, rbuf, mpi_type<ValueType>(), row_comm, &requests[c]);
+        progress(requests);
+        double t2 = MPI_Wtime();
+        compute_time += t1 - t0;
+        comm_time += t2 - t1;
+    }
+
+    for(int c = 0; c < num_chunks; c++)
+    {
+        double t0 = MPI_Wtime();
+        MPI_Wait(&requests[c], MPI_STATUS_IGNORE);
+        double t1 = MPI_Wtime();
+        const size_t z0 = offsets[c], nzc = offsets[c + 1] - offsets[c];
+        #pragma omp parallel for
+        for(int s = 0; s < P; s++)
+        {
+            const ValueType* src = rbuf + plans[c].rdispls[s];
+            if(forward)
+            {
+                // from s: [z][y in y-range of s][x in my x-range] -> mid [z][x][y]
+                const size_t ys0 = block_begin(N[1], P, s), nys = block_size(N[1], P, s);
+                for(size_t z = 0; z < nzc; z++)
+                    for(size_t y = 0; y < nys; y++)
+                        for(size_t x = 0; x < nx; x++)
+                            y_pencil[((z0 + z) * nx + x) * N[1] + ys0 + y] = *src++;
+            }
+            else
+            {
+                // from s: [z][x in x-range of s][y in my y-range] -> X-pencil [z][y][x]
+                const size_t xs0 = block_begin(N[0], P, s), nxs = block_size(N[0], P, s);
+                for(size_t z = 0; z < nzc; z++)
+                    for(size_t x = 0; x < nxs; x++)
+                        for(size_t y = 0; y < ny; y++)
+                            x_pencil[((z0 + z) * ny + y) * N[0] + xs0 + x] = *src++;
+            }
+        }
+        progress(requests);
+        comm_time += t1 - t0;
+        compute_time += MPI_Wtime() - t1;
+    }
+
+    if(forward)
+    {
+        double t0 = MPI_Wtime();
+        fft_lines(1, y_pencil, nz * nx, true);
+        compute_time += MPI_Wtime() - t0;
+    }
+}
+
+// forward: exchange mid (already y-transformed) into the Z-pencil chunk by chunk of x rows
+// backward: z-IFFT on the Z-pencil chunk by chunk of x rows, exchange into mid
+template<typename ValueType>
+void DistributedFFT3D<ValueType>::transpose_yz(ValueType* z_pencil, bool forward)
+{
+    const int P = dims[1];
+    const size_t nx = mid_n[0], nz = mid_n[2], ny = spec_n[1];
+    ValueType* y_pencil = thrust::raw_pointer_cast(mid.data());
+    ValueType* sbuf = thrust::raw_pointer_cast(send_buffer.data());
+    ValueType* rbuf = thrust::raw_pointer_cast(recv_buffer.data());
+
+    const int num_chunks = (int)std::max<size_t>(1, std::min<size_t>(chunks, nx));
+    std::vector<MPI_Request> requests(num_chunks, MPI_REQUEST_NULL);
+    std::vector<AlltoallvPlan> plans(num_chunks, AlltoallvPlan(P));
+    std::vector<size_t> offsets(num_chunks + 1);
+    for(int c = 0; c <= num_chunks; c++) offsets[c] = block_begin(nx, num_chunks, c);
+
+    // Chunk c covers x rows [x0, x0 + nxc), its share of either buffer starts at x0 times the per-row volume
+    const size_t row_mid = nz * N[1], row_spec = ny * N[2];
+    for(int c = 0; c < num_chunks; c++)
+    {
+        const size_t x0 = offsets[c], nxc = offsets[c + 1] - offsets[c];
+        double t0 = MPI_Wtime();
+        size_t sd = x0 * (forward ? row_mid : row_spec), rd = x0 * (forward ? row_spec : row_mid);
+        for(int q = 0; q < P; q++)
+        {
+            size_t ns = forward ? nz * nxc * block_size(N[1], P, q) : nxc * ny * block_size(N[2], P, q);
+            size_t nr = forward ? block_size(N[2], P, q) * nxc * ny : nxc * block_size(N[1], P, q) * nz;
+            plans[c].scounts[q] = ns; plans[c].sdispls[q] = sd; sd += ns;
+            plans[c].rcounts[q] = nr; plans[c].rdispls[q] = rd; rd += nr;
+        }
+
+        if(forward)
+        {
+            // [z][x in chunk][y in y-range of q]
+            #pragma omp parallel for
+            for(int q = 0; q < P; q++)
+            {
+                const size_t yq0 = block_begin(N[1], P, q), nyq = block_size(N[1], P, q);
+                ValueType* dst = sbuf + plans[c].sdispls[q];
+                for(size_t z = 0; z < nz; z++)
+                    for(size_t x = 0; x < nxc; x++)
+                    {
+                        const ValueType* src = y_pencil + (z * nx + x0 + x) * N[1] + yq0;
+                        std::copy(src, src + nyq, dst);
+                        dst += nyq;
+                    }
+            }
+        }
+        else
+        {
+            fft_lines(2, z_pencil + x0 * ny * N[2], nxc * ny, false);
+            // [x in chunk][y][z in z-range of q]
+            #pragma omp parallel for
+            for(int q = 0; q < P; q++)
+            {
+                const size_t zq0 = block_begin(N[2], P, q), nzq = block_size(N[2], P, q);
+                ValueType* dst = sbuf + plans[c].sdispls[q];
+                for(size_t x = 0; x < nxc; x++)
+                    for(size_t y = 0; y < ny; y++)
+                    {
+                        const ValueType* src = z_pencil + ((x0 + x) * ny + y) * N[2] + zq0;
+                        std::copy(src, src + nzq, dst);
+                        dst += nzq;
+                    }
+            }
+        }
+        double t1 = MPI_Wtime();
+        plans[c].start(sbuf, rbuf, mpi_type<ValueType>(), col_comm, &requests[c]);
+        progress(requests);
+        double t2 = MPI_Wtime();
+        compute_time += t1 - t0;
+        comm_time += t2 - t1;
+    }
+
+    for(int c = 0; c < num_chunks; c++)
+    {
+        double t0 = MPI_Wtime();
+        MPI_Wait(&requests[c], MPI_STATUS_IGNORE);
+        double t1 = MPI_Wtime();
+        const size_t x0 = offsets[c], nxc = offsets[c + 1] - offsets[c];
+        #pragma omp parallel for
+        for(int s = 0; s < P; s++)
+        {
+            const ValueType* src = rbuf + plans[c].rdispls[s];
+            if(forward)
+            {
+                // from s: [z in z-range of s][x in chunk][y in my y-range] -> Z-pencil [x][y][z]
+                const size_t zs0 = block_begin(N[2], P, s), nzs = block_size(N[2], P, s);
+                for(size_t z = 0; z < nzs; z++)
+                    for(size_t x = 0; x < nxc; x++)
+                        for(size_t y = 0; y < ny; y++)
+                            z_pencil[((x0 + x) * ny + y) * N[2] + zs0 + z] = *src++;
+            }
+            else
+            {
+                // from s: [x in chunk][y in y-range of s][z in my z-range] -> mid [z][x][y]
+                const size_t ys0 = block_begin(N[1], P, s), nys = block_size(N[1], P, s);
+                for(size_t x = 0; x < nxc; x++)
+                    for(size_t y = 0; y < nys; y++)
+                        for(size_t z = 0; z < nz; z++)
+                            y_pencil[(z * nx + x0 + x) * N[1] + ys0 + y] = *src++;
+            }
+        }
+        progress(requests);
+        comm_time += t1 - t0;
+        compute_time += MPI_Wtime() - t1;
+    }
+}
+
+template<typename ValueType>
+using DistributedFFT3D_h = DistributedFFT3D<ValueType>;
+
+template<typename ValueType>
+using DistributedCCONV3D_h = DistributedCCONV3D<ValueType>;
+
+}
@@ -0,0 +1,502 @@
+#pragma once
+
+#include "SparseMatrix.h"
+#include <mpi.h>
+#include <climits>
+#include <numeric>
+
+namespace puff {
+
+    template<typename ValueType>
+    MPI_Datatype mpi_type() {
+        if constexpr(std::is_same_v<ValueType, double>) return MPI_DOUBLE;
+        else if constexpr(std::is_same_v<ValueType, float>) return MPI_FLOAT;
+        else if constexpr(std::is_same_v<ValueType, dcomplex>) return MPI_C_DOUBLE_COMPLEX;
+        else if constexpr(std::is_same_v<ValueType, fcomplex>) return MPI_C_FLOAT_COMPLEX;
+        else if constexpr(std::is_same_v<ValueType, uint32_t>) return MPI_UINT32_T;
+        else if constexpr(std::is_same_v<ValueType, uint64_t>) return MPI_UINT64_T;
+        else static_assert(sizeof(ValueType) == 0, "No MPI datatype for this type");
+    }
+
+    // Counts and displacements of an all-to-all in elements of its datatype, 64-bit on the caller side.
+    // MPI-4 takes them as MPI_Count / MPI_Aint. Older MPIs exchange blocks of the largest contiguous unit dividing
+    // all of them so the int arguments cover larger volumes, and abort when a value still does not fit.
+    // The plan must stay alive until a nonblocking exchange has completed
+    struct AlltoallvPlan {
+        std::vector<size_t> scounts, sdispls, rcounts, rdispls;
+
+        explicit AlltoallvPlan(int size = 0) : scounts(size, 0), sdispls(size, 0), rcounts(size, 0), rdispls(size, 0) {}
+
+        void exchange(const void* sbuf, void* rbuf, MPI_Datatype type, MPI_Comm comm) { post(sbuf, rbuf, type, comm, nullptr); }
+        void start(const void* sbuf, void* rbuf, MPI_Datatype type, MPI_Comm comm, MPI_Request* request) { post(sbuf, rbuf, type, comm, request); }
+
+        private:
+#if MPI_VERSION >= 4
+            std::vector<MPI_Count> sc, rc;
+            std::vector<MPI_Aint> sd, rd;
+
+            void post(const void* sbuf, void* rbuf, MPI_Datatype type, MPI_Comm comm, MPI_Request* request) {
+                sc.assign(scounts.begin(), scounts.end()); sd.assign(sdispls.begin(), sdispls.end());
+                rc.assign(rcounts.begin(), rcounts.end()); rd.assign(rdispls.begin(), rdispls.end());
+                if(request != nullptr)
+                    MPI_Ialltoallv_c(sbuf, sc.data(), sd.data(), type, rbuf, rc.data(), rd.data(), type, comm, request);
+                else
+                    MPI_Alltoallv_c(sbuf, sc.data(), sd.data(), type, rbuf, rc.data(), rd.data(), type, comm);
+            }
+#else
+            std::vector<int> sc, sd, rc, rd;
+
+            void post(const void* sbuf, void* rbuf, MPI_Datatype type, MPI_Comm comm, MPI_Request* request) {
+                size_t unit = 0;
+                for(const auto* values : {&scounts, &sdispls, &rcounts, &rdispls})
+                    for(size_t n : *values) unit = std::gcd(unit, n);
+                unit = std::max<size_t>(unit, 1);
+                auto narrow = [&](const std::vector<size_t>& in, std::vector<int>& out) {
+                    out.resize(in.size());
+                    for(size_t r = 0; r < in.size(); r++)
+                    {
+                        if(unit > (size_t)INT_MAX || in[r] / unit > (size_t)INT_MAX)
+                        {
+                            fprintf(stderr, "All-to-all of %zu elements exceeds the int counts of MPI %d.%d\n", in[r], MPI_VERSION, MPI_SUBVERSION);
+                            MPI_Abort(comm, EXIT_FAILURE);
+                        }
+                        out[r] = (int)(in[r] / unit);
+                    }
+                };
+                narrow(scounts, sc); narrow(sdispls, sd);
+                narrow(rcounts, rc); narrow(rdispls, rd);
+                MPI_Datatype block;
+                MPI_Type_contiguous((int)unit, type, &block);
+                MPI_Type_commit(&block);
+                if(request != nullptr)
+                    MPI_Ialltoallv(sbuf, sc.data(), sd.data(), block, rbuf, rc.data(), rd.data(), block, comm, request);
+                else
+                    MPI_Alltoallv(sbuf, sc.data(), sd.data(), block, rbuf, rc.data(), rd.data(), block, comm);
+                // A pending exchange keeps the type alive until it completes
+                MPI_Type_free(&block);
+            }
+#endif
+    };
+
+    // Row-partitioned sparse matrix over the ranks of a communicator, host memory only
+    // Rank r owns rows and vector entries [offsets[r], offsets[r + 1]) of a balanced block partition.
+    // make_matrix routes entries to their owners and computes the halo plan from the column pattern,
+    // SpMV overlaps the halo exchange with the product of the locally owned columns.
+    template<typename IndexType, typename ValueType>
+    class DistributedSparseMatrixWrapper {
+        public:
+            typedef typename cusp::norm_type<ValueType>::type Real;
+
+            DistributedSparseMatrixWrapper(MPI_Comm comm, size_t num_rows, size_t num_cols)
+                : comm(comm), num_rows(num_rows), num_cols(num_cols) {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &size);
+                row_offsets_global.resize(size + 1);
+                col_offsets_global.resize(size + 1);
+                for(int r = 0; r <= size; r++)
+                {
+                    row_offsets_global[r] = num_rows * r / size;
+                    col_offsets_global[r] = num_cols * r / size;
+                }
+            }
+
+            size_t get_num_rows() { return num_rows; }
+            size_t get_num_cols() { return num_cols; }
+            size_t row_begin() { return row_offsets_global[rank]; }
+            size_t row_end() { return row_offsets_global[rank + 1]; }
+            size_t col_begin() { return col_offsets_global[rank]; }
+            size_t col_end() { return col_offsets_global[rank + 1]; }
+            size_t local_rows() { return row_end() - row_begin(); }
+            size_t local_cols() { return col_end() - col_begin(); }
+            size_t halo_size() { return halo_cols.size(); }
+
+            // Any rank may insert any global entry, make_matrix sends it to the owner of its row
+            // Entries for the same position from different ranks overwrite in unspecified order
+            void insert_entry(IndexType row, IndexType col, ValueType val) {
+                std::lock_guard<std::mutex> lock(mtx);
+                entries[((KEY_TYPE)row << 32) + col] = val;
+            }
+
+            // Collective
+            void make_matrix();
+
+            // y = A * x on the local slices, collective
+            void SpMV(Vector<ValueType, cusp::host_memory>& x, Vector<ValueType, cusp::host_memory>& y);
+
+            // Global conj(a) . b, collective
+            ValueType dot(const Vector<ValueType, cusp::host_memory>& a, const Vector<ValueType, cusp::host_memory>& b);
+
+            // Global 2-norm, collective
+            Real nrm2(const Vector<ValueType, cusp::host_memory>& a);
+
+            // Restarted GMRES on the distributed operator, returns the residual norm, collective
+            Real gmres(Vector<ValueType, cusp::host_memory>& x,
+                       Vector<ValueType, cusp::host_memory>& b,
+                       size_t restart = 50,
+                       size_t maxiter = 1000,
+                       Real tol = Real(1e-6),
+                       bool verbose = false);
+
+            size_t get_last_iterations() { return last_iterations; }
+
+        private:
+            struct Triplet {
+                IndexType row;
+                IndexType col;
+                ValueType val;
+            };
+
+            MPI_Comm comm;
+            int rank = 0, size = 1;
+            size_t num_rows, num_cols;
+            std::vector<size_t> row_offsets_global, col_offsets_global;
+
+            std::unordered_map<KEY_TYPE, ValueType> entries;
+            std::mutex mtx;
+
+            // Local CSR split into owned columns (local index) and halo columns (halo index)
+            Vector<IndexType, cusp::host_memory> interior_offsets, interior_cols;
+            Vector<ValueType, cusp::host_memory> interior_vals;
+            Vector<IndexType, cusp::host_memory> boundary_offsets, boundary_cols;
+            Vector<ValueType, cusp::host_memory> boundary_vals;
+
+            // Halo plan, neighbours and their displacements into halo / send buffers
+            std::vector<IndexType> halo_cols;          // global columns received, grouped by owner
+            std::vector<int> recv_ranks, recv_counts, recv_displs;
+            std::vector<int> send_ranks, send_counts, send_displs;
+            std::vector<IndexType> send_indices;       // local indices of x to send
+            Vector<ValueType, cusp::host_memory> halo_buffer, send_buffer;
+
+            size_t last_iterations = 0;
+
+            int col_owner(size_t col) {
+                return (int)(std::upper_bound(col_offsets_global.begin(), col_offsets_global.end(), col) - col_offsets_global.begin()) - 1;
+            }
+
+            int row_owner(size_t row) {
+                return (int)(std::upper_bound(row_offsets_global.begin(), row_offsets_global.end(), row) - row_offsets_global.begin()) - 1;
+            }
+
+            static ValueType conj_value(const ValueType& v) {
+                if constexpr(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>)
+                    return thrust::conj(v);
+                else
+                    return v;
+            }
+
+            static Real abs_value(const ValueType& v) {
+                if constexpr(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>)
+                    return thrust::abs(v);
+                else
+                    return std::abs(v);
+            }
+
+            void csr_product(const Vector<IndexType, cusp::host_memory>& offsets,
+                             const Vector<IndexType, cusp::host_memory>& cols,
+                             const Vector<ValueType, cusp::host_memory>& vals,
+                             const ValueType* x, ValueType* y, bool accumulate) {
+                #pragma omp parallel for schedule(static)
+                for(long long i = 0; i < (long long)offsets.size() - 1; i++)
+                {
+                    ValueType sum = accumulate ? y[i] : ValueType(0);
+                    for(IndexType k = offsets[i]; k < offsets[i + 1]; k++)
+                        sum += vals[k] * x[cols[k]];
+                    y[i] = sum;
+                }
+            }
+    };
+
+    template<typename IndexType, typename ValueType>
+    void DistributedSparseMatrixWrapper<IndexType, ValueType>::make_matrix()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // Route entries to the owners of their rows
+        std::vector<std::vector<Triplet>> outgoing(size);
+        for(auto& [key, value] : entries)
+        {
+            IndexType row = static_cast<IndexType>(key >> 32);
+            IndexType col = static_cast<IndexType>(key);
+            outgoing[row_owner(row)].push_back({row, col, value});
+        }
+        {
+            std::unordered_map<KEY_TYPE, ValueType> temp_entries;
+            std::swap(entries, temp_entries); // force entries to free memory
+        }
+
+        // Counts and displacements in triplets, not bytes, accumulated in 64 bits
+        MPI_Datatype triplet_type;
+        MPI_Type_contiguous((int)sizeof(Triplet), MPI_BYTE, &triplet_type);
+        MPI_Type_commit(&triplet_type);
+        AlltoallvPlan plan(size);
+        std::vector<uint64_t> sendcounts(size), recvcounts(size);
+        for(int r = 0; r < size; r++)
+            sendcounts[r] = outgoing[r].size();
+        MPI_Alltoall(sendcounts.data(), 1, MPI_UINT64_T, recvcounts.data(), 1, MPI_UINT64_T, comm);
+        size_t sent = 0, received = 0;
+        for(int r = 0; r < size; r++)
+        {
+            plan.scounts[r] = sendcounts[r]; plan.sdispls[r] = sent; sent += sendcounts[r];
+            plan.rcounts[r] = recvcounts[r]; plan.rdispls[r] = received; received += recvcounts[r];
+        }
+        std::vector<Triplet> sendbuf(sent), triplets(received);
+        for(int r = 0; r < size; r++)
+            std::copy(outgoing[r].begin(), outgoing[r].end(), sendbuf.begin() + plan.sdispls[r]);
+        std::vector<std::vector<Triplet>>().swap(outgoing);
+        plan.exchange(sendbuf.data(), triplets.data(), triplet_type, comm);
+        MPI_Type_free(&triplet_type);
+        std::vector<Triplet>().swap(sendbuf);
+
+        // Sort by (row, col), later duplicates win
+        std::stable_sort(triplets.begin(), triplets.end(), [](const Triplet& a, const Triplet& b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        });
+        size_t unique = 0;
+        for(size_t k = 0; k < triplets.size(); k++)
+        {
+            if(unique > 0 && triplets[unique - 1].row == triplets[k].row && triplets[unique - 1].col == triplets[k].col)
+                triplets[unique - 1].val = triplets[k].val;
+            else
+                triplets[unique++] = triplets[k];
+        }
+        triplets.resize(unique);
+
+        // Halo columns grouped by owner rank, then by column
+        const size_t c0 = col_begin(), c1 = col_end();
+        halo_cols.clear();
+        for(auto& t : triplets)
+            if(t.col < c0 || t.col >= c1) halo_cols.push_back(t.col);
+        std::sort(halo_cols.begin(), halo_cols.end());
+        halo_cols.erase(std::unique(halo_cols.begin(), halo_cols.end()), halo_cols.end());
+
+        std::vector<int> need(size, 0);
+        for(auto col : halo_cols) need[col_owner(col)]++;
+        std::vector<int> give(size, 0);
+        MPI_Alltoall(need.data(), 1, MPI_INT, give.data(), 1, MPI_INT, comm);
+
+        std::vector<int> need_displs(size + 1, 0), give_displs(size + 1, 0);
+        for(int r = 0; r < size; r++)
+        {
+            need_displs[r + 1] = need_displs[r] + need[r];
+            give_displs[r + 1] = give_displs[r] + give[r];
+        }
+        std::vector<IndexType> requested(give_displs[size]);
+        MPI_Alltoallv(halo_cols.data(), need.data(), need_displs.data(), mpi_type<IndexType>(),
+                      requested.data(), give.data(), give_displs.data(), mpi_type<IndexType>(), comm);
+
+        recv_ranks.clear(); recv_counts.clear(); recv_displs.clear();
+        send_ranks.clear(); send_counts.clear(); send_displs.clear();
+        for(int r = 0; r < size; r++)
+        {
+            if(need[r] > 0)
+            {
+                recv_ranks.push_back(r);
+                recv_counts.push_back(need[r]);
+                recv_displs.push_back(need_displs[r]);
+            }
+            if(give[r] > 0)
+            {
+                send_ranks.push_back(r);
+                send_counts.push_back(give[r]);
+                send_displs.push_back(give_displs[r]);
+            }
+        }
+        send_indices.resize(requested.size());
+        for(size_t k = 0; k < requested.size(); k++)
+            send_indices[k] = requested[k] - (IndexType)c0;
+        halo_buffer.resize(halo_cols.size());
+        send_buffer.resize(send_indices.size());
+
+        // Split into interior / boundary CSR
+        const size_t n = local_rows();
+        const IndexType r0 = (IndexType)row_begin();
+        interior_offsets = Vector<IndexType, cusp::host_memory>(n + 1, 0);
+        boundary_offsets = Vector<IndexType, cusp::host_memory>(n + 1, 0);
+        for(auto& t : triplets)
+        {
+            if(t.col >= c0 && t.col < c1) interior_offsets[t.row - r0 + 1]++;
+            else boundary_offsets[t.row - r0 + 1]++;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            interior_offsets[i + 1] += interior_offsets[i];
+            boundary_offsets[i + 1] += boundary_offsets[i];
+        }
+        interior_cols.resize(interior_offsets[n]); interior_vals.resize(interior_offsets[n]);
+        boundary_cols.resize(boundary_offsets[n]); boundary_vals.resize(boundary_offsets[n]);
+        size_t ki = 0, kb = 0;
+        for(auto& t : triplets)
+        {
+            if(t.col >= c0 && t.col < c1)
+            {
+                interior_cols[ki] = t.col - (IndexType)c0;
+                interior_vals[ki++] = t.val;
+            }
+            else
+            {
+                boundary_cols[kb] = (IndexType)(std::lower_bound(halo_cols.begin(), halo_cols.end(), t.col) - halo_cols.begin());
+                boundary_vals[kb++] = t.val;
+            }
+        }
+    }
+
+    template<typename IndexType, typename ValueType>
+    void DistributedSparseMatrixWrapper<IndexType, ValueType>::SpMV(Vector<ValueType, cusp::host_memory>& x,
+                                                                   Vector<ValueType, cusp::host_memory>& y)
+    {
+        assert(x.size() == local_cols());
+        y.resize(local_rows());
+        Vector<ValueType, cusp::host_memory> temp;
+        ValueType* y_ptr = thrust::raw_pointer_cast(y.data());
+        if(&x == &y)
+        {
+            temp.resize(local_rows());
+            y_ptr = thrust::raw_pointer_cast(temp.data());
+        }
+        const ValueType* x_ptr = thrust::raw_pointer_cast(x.data());
+
+        // Post halo receives and sends, then multiply the owned columns while messages are in flight
+        std::vector<MPI_Request> requests(recv_ranks.size() + send_ranks.size());
+        for(size_t k = 0; k < recv_ranks.size(); k++)
+            MPI_Irecv(thrust::raw_pointer_cast(halo_buffer.data()) + recv_displs[k], recv_counts[k], mpi_type<ValueType>(),
+                      recv_ranks[k], 0, comm, &requests[k]);
+        #pragma omp parallel for
+        for(long long k = 0; k < (long long)send_indices.size(); k++)
+            send_buffer[k] = x_ptr[send_indices[k]];
+        for(size_t k = 0; k < send_ranks.size(); k++)
+            MPI_Isend(thrust::raw_pointer_cast(send_buffer.data()) + send_displs[k], send_counts[k], mpi_type<ValueType>(),
+                      send_ranks[k], 0, comm, &requests[recv_ranks.size() + k]);
+
+        csr_product(interior_offsets, interior_cols, interior_vals, x_ptr, y_ptr, false);
+        MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+        csr_product(boundary_offsets, boundary_cols, boundary_vals, thrust::raw_pointer_cast(halo_buffer.data()), y_ptr, true);
+
+        if(&x == &y) y.swap(temp);
+    }
+
+    template<typename IndexType, typename ValueType>
+    ValueType DistributedSparseMatrixWrapper<IndexType, ValueType>::dot(const Vector<ValueType, cusp::host_memory>& a,
+                                                                       const Vector<ValueType, cusp::host_memory>& b)
+    {
+        assert(a.size() == b.size());
+        ValueType local = thrust::inner_product(a.begin(), a.end(), b.begin(), ValueType(0), thrust::plus<ValueType>(),
+                                                [](const ValueType& u, const ValueType& v) { return conj_value(u) * v; });
+        ValueType global;
+        MPI_Allreduce(&local, &global, 1, mpi_type<ValueType>(), MPI_SUM, comm);
+        return global;
+    }
+
+    template<typename IndexType, typename ValueType>
+    typename DistributedSparseMatrixWrapper<IndexType, ValueType>::Real
+    DistributedSparseMatrixWrapper<IndexType, ValueType>::nrm2(const Vector<ValueType, cusp::host_memory>& a)
+    {
+        Real local = thrust::transform_reduce(a.begin(), a.end(),
+                                             [](const ValueType& u) { Real m = abs_value(u); return m * m; },
+                                             Real(0), thrust::plus<Real>());
+        Real global;
+        MPI_Allreduce(&local, &global, 1, mpi_type<Real>(), MPI_SUM, comm);
+        return std::sqrt(global);
+    }
+
+    template<typename IndexType, typename ValueType>
+    typename DistributedSparseMatrixWrapper<IndexType, ValueType>::Real
+    DistributedSparseMatrixWrapper<IndexType, ValueType>::gmres(Vector<ValueType, cusp::host_memory>& x,
+                                                               Vector<ValueType, cusp::host_memory>& b,
+                                                               size_t restart,
+                                                               size_t maxiter,
+                                                               Real tol,
+                                                               bool verbose)
+    {
+        const size_t n = local_rows();
+        const Real b_norm = nrm2(b);
+        std::vector<Vector<ValueType, cusp::host_memory>> V(restart + 1, Vector<ValueType, cusp::host_memory>(n));
+        std::vector<ValueType> H((restart + 1) * restart), g(restart + 1), cs(restart), sn(restart), y(restart);
+        Vector<ValueType, cusp::host_memory> w(n);
+        auto h = [&](size_t i, size_t j) -> ValueType& { return H[i * restart + j]; };
+
+        size_t iteration = 0;
+        Real residual = 0;
+        while(true)
+        {
+            // r = b - A x
+            SpMV(x, w);
+            thrust::transform(b.begin(), b.end(), w.begin(), V[0].begin(), thrust::minus<ValueType>());
+            residual = nrm2(V[0]);
+            if(verbose && rank == 0)
+                printf("GMRES iteration %zu residual %e\n", iteration, (double)residual);
+            if(residual <= tol * b_norm || iteration >= maxiter || residual == Real(0))
+                break;
+
+            Vector_element_wise_multiply_Constant(V[0], ValueType(Real(1) / residual), V[0]);
+            std::fill(g.begin(), g.end(), ValueType(0));
+            g[0] = ValueType(residual);
+
+            size_t k = 0;
+            while(k < restart && iteration < maxiter)
+            {
+                // Arnoldi step with modified Gram-Schmidt, one global reduction per projection
+                SpMV(V[k], w);
+                for(size_t i = 0; i <= k; i++)
+                {
+                    h(i, k) = dot(V[i], w);
+                    ValueType hik = h(i, k);
+                    thrust::transform(w.begin(), w.end(), V[i].begin(), w.begin(),
+                                      [hik](const ValueType& a, const ValueType& v) { return a - hik * v; });
+                }
+                Real w_norm = nrm2(w);
+                h(k + 1, k) = ValueType(w_norm);
+                if(w_norm != Real(0))
+                    Vector_element_wise_multiply_Constant(w, ValueType(Real(1) / w_norm), V[k + 1]);
+
+                // Apply previous Givens rotations, then eliminate h(k + 1, k)
+                for(size_t i = 0; i < k; i++)
+                {
+                    ValueType t = cs[i] * h(i, k) + sn[i] * h(i + 1, k);
+                    h(i + 1, k) = -conj_value(sn[i]) * h(i, k) + cs[i] * h(i + 1, k);
+                    h(i, k) = t;
+                }
+                Real a = abs_value(h(k, k)), d = std::sqrt(a * a + w_norm * w_norm);
+                if(a == Real(0))
+                {
+                    cs[k] = ValueType(0);
+                    sn[k] = ValueType(1);
+                }
+                else
+                {
+                    cs[k] = ValueType(a / d);
+                    sn[k] = h(k, k) / ValueType(a) * ValueType(w_norm / d);
+                }
+                h(k, k) = cs[k] * h(k, k) + sn[k] * h(k + 1, k);
+                h(k + 1, k) = ValueType(0);
+                g[k + 1] = -conj_value(sn[k]) * g[k];
+                g[k] = cs[k] * g[k];
+
+                k++;
+                iteration++;
+                if(abs_value(g[k]) <= tol * b_norm || w_norm == Real(0))
+                    break;
+            }
+
+            // Back substitution and update x += V y
+            for(long long i = (long long)k - 1; i >= 0; i--)
+            {
+                ValueType s = g[i];
+                for(size_t j = i + 1; j < k; j++)
+                    s -= h(i, j) * y[j];
+                y[i] = s / h(i, i);
+            }
+            for(size_t i = 0; i < k; i++)
+            {
+                ValueType yi = y[i];
+                thrust::transform(x.begin(), x.end(), V[i].begin(), x.begin(),
+                                  [yi](const ValueType& a, const ValueType& v) { return a + yi * v; });
+            }
+        }
+        last_iterations = iteration;
+        return residual;
+    }
+
+    template<typename ValueType>
+    using DistributedSparseMatrix_h = DistributedSparseMatrixWrapper<INDEX_TYPE, ValueType>;
+
+}
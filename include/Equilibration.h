@@ -0,0 +1,42 @@
+#pragma once
+
+#include "utils.h"
+#include "Sparsification.h"
+#include "SpMVKernels.h"
+#include <atomic>
+#include <cstring>
+
+namespace puff {
+
+    // Diagonal scaling A_s = D_r A D_c that evens out the row and column magnitudes before a Krylov solve
+    enum class EquilibrationMethod {
+        None,
+        RowColumn, // one sweep: rows to unit infinity norm, then columns of the row-scaled matrix
+        Ruiz       // repeated square-root scaling until all row and column infinity norms are close to 1
+    };
+
+    struct EquilibrationReport {
+        EquilibrationMethod method = EquilibrationMethod::None;
+        size_t sweeps = 0;
+        // max / min infinity norm over the non-empty rows (columns), before and after scaling
+        double row_spread_before = 1.0, row_spread_after = 1.0;
+        double col_spread_before = 1.0, col_spread_after = 1.0;
+    };
+
+    // Scaling factors of a sorted CSR matrix, rows in parallel. Ruiz stops after max_sweeps or when every
+    // row and column norm is within tolerance of 1. Empty rows and columns keep a factor of 1
+    template<typename ValueType, typename IndexType, typename Real>
+    EquilibrationReport Equilibrate(EquilibrationMethod method,
+                                    size_t num_rows,
+                                    size_t num_cols,
+                                    const IndexType* row_offsets,
+                                    const IndexType* column_indices,
+                                    const ValueType* values,
+                                    std::vector<Real>& row_scale,
+                                    std::vector<Real>& col_scale,
+                                    size_t max_sweeps = 20,
+                                    double tolerance = 1e-2);
+
+}
+
+#include "details/Equilibration.inl"
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "utils.h"
+#include "PGF.h"
+#include "mkl.h"
+
+namespace puff {
+
+    // One Floquet mode of the 2D lattice, same (m, n) enumeration as __2D_PGF__
+    template<typename T>
+    struct FloquetMode {
+        int m;
+        int n;
+        std::complex<T> Kxm;
+        std::complex<T> Kyn;
+        std::complex<T> Kzmn;
+    };
+
+    // Enumerate all propagating Floquet modes (real Kzmn) of a lattice periodic in x and y
+    template<typename T>
+    std::vector<FloquetMode<T>> Floquet_propagating_modes(T Lx, T Ly,
+                                                          std::complex<T> Kx,
+                                                          std::complex<T> Ky,
+                                                          std::complex<T> K0)
+    {
+        std::vector<FloquetMode<T>> modes;
+        T k0 = std::abs(K0.real());
+        int m_min = (int)std::ceil((-k0 - Kx.real()) * Lx / (2 * M_PI_));
+        int m_max = (int)std::floor((k0 - Kx.real()) * Lx / (2 * M_PI_));
+        int n_min = (int)std::ceil((-k0 - Ky.real()) * Ly / (2 * M_PI_));
+        int n_max = (int)std::floor((k0 - Ky.real()) * Ly / (2 * M_PI_));
+        for(int m = m_min; m <= m_max; m++)
+        {
+            std::complex<T> Kxm = Kx + T(2 * M_PI_ * m / Lx);
+            for(int n = n_min; n <= n_max; n++)
+            {
+                std::complex<T> Kyn = Ky + T(2 * M_PI_ * n / Ly);
+                std::complex<T> Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+                // Grazing and evanescent modes carry no power to the far field
+                if(Kzmn.real() <= std::abs(Kzmn.imag()))
+                    continue;
+                modes.push_back({m, n, Kxm, Kyn, Kzmn});
+            }
+        }
+        return modes;
+    }
+
+    // Floquet amplitudes radiated by the unit cell currents J at (x, y, z)
+    // Above all sources the field is sum_mn T_mn * exp(-i(Kxm x + Kyn y + Kzmn z)),
+    // below all sources it is sum_mn R_mn * exp(-i(Kxm x + Kyn y - Kzmn z)),
+    // consistent with the spectral representation in __2D_PGF__
+    template<typename T>
+    void Floquet_coefficients(const Vector_h<T>& x,
+                              const Vector_h<T>& y,
+                              const Vector_h<T>& z,
+                              const Vector_h<std::complex<T>>& J,
+                              T Lx, T Ly,
+                              const std::vector<FloquetMode<T>>& modes,
+                              Vector_h<std::complex<T>>& R,
+                              Vector_h<std::complex<T>>& Tr)
+    {
+        assert(x.size() == J.size() && y.size() == J.size() && z.size() == J.size());
+        R.resize(modes.size());
+        Tr.resize(modes.size());
+        const std::complex<T> I(0, 1);
+        const size_t num_sources = J.size();
+
+        #pragma omp parallel for schedule(dynamic)
+        for(long long k = 0; k < (long long)modes.size(); k++)
+        {
+            const auto& mode = modes[k];
+            std::complex<T> up(0, 0), down(0, 0);
+            for(size_t i = 0; i < num_sources; i++)
+            {
+                auto transverse = std::exp(I * (mode.Kxm * x[i] + mode.Kyn * y[i]));
+                auto vertical = std::exp(I * mode.Kzmn * z[i]);
+                up += J[i] * transverse * vertical;
+                down += J[i] * transverse / vertical;
+            }
+            auto denominator = T(2) * I * mode.Kzmn * Lx * Ly;
+            Tr[k] = up / denominator;
+            R[k] = down / denominator;
+        }
+    }
+
+    // Far-field pattern F(theta_a, phi_a; k) = sum_i J(i, k) * exp(i K0 rhat_a . r_i)
+    // J holds nrhs current sets column-major (num_sources x nrhs), F is column-major (num_angles x nrhs)
+    // Angles are processed in tiles in parallel, each tile is one complex GEMM against all current sets
+    template<typename T>
+    void Radiation_pattern(const Vector_h<T>& x,
+                           const Vector_h<T>& y,
+                           const Vector_h<T>& z,
+                           const Vector_h<std::complex<T>>& J,
+                           size_t nrhs,
+                           const Vector_h<T>& theta,
+                           const Vector_h<T>& phi,
+                           T K0,
+                           Vector_h<std::complex<T>>& F,
+                           size_t tile = 256)
+    {
+        static_assert(std::is_same_v<T, double> || std::is_same_v<T, float>, "Radiation_pattern supports float and double only");
+        const size_t num_sources = x.size();
+        const size_t num_angles = theta.size();
+        assert(J.size() == num_sources * nrhs && phi.size() == num_angles);
+        F.resize(num_angles * nrhs);
+        if(num_angles == 0 || nrhs == 0)
+            return;
+        if(num_sources == 0)
+        {
+            thrust::fill(F.begin(), F.end(), std::complex<T>(0, 0));
+            return;
+        }
+
+        const size_t num_tiles = (num_angles + tile - 1) / tile;
+        #pragma omp parallel
+        {
+            // Per-thread phase matrix, tile x num_sources column-major
+            std::vector<std::complex<T>> P(tile * num_sources);
+            #pragma omp for schedule(dynamic)
+            for(long long t = 0; t < (long long)num_tiles; t++)
+            {
+                const size_t a0 = t * tile;
+                const size_t na = std::min(tile, num_angles - a0);
+                for(size_t i = 0; i < num_sources; i++)
+                {
+                    for(size_t a = 0; a < na; a++)
+                    {
+                        T st = std::sin(theta[a0 + a]);
+                        T phase = K0 * (st * std::cos(phi[a0 + a]) * x[i] +
+                                        st * std::sin(phi[a0 + a]) * y[i] +
+                                        std::cos(theta[a0 + a]) * z[i]);
+                        P[i * na + a] = std::complex<T>(std::cos(phase), std::sin(phase));
+                    }
+                }
+                const std::complex<T> alpha(1, 0), beta(0, 0);
+                if constexpr(std::is_same_v<T, double>)
+                    cblas_zgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                                na, nrhs, num_sources,
+                                &alpha, P.data(), na,
+                                thrust::raw_pointer_cast(J.data()), num_sources,
+                                &beta, thrust::raw_pointer_cast(F.data()) + a0, num_angles);
+                else
+                    cblas_cgemm(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                                na, nrhs, num_sources,
+                                &alpha, P.data(), na,
+                                thrust::raw_pointer_cast(J.data()), num_sources,
+                                &beta, thrust::raw_pointer_cast(F.data()) + a0, num_angles);
+            }
+        }
+    }
+
+    // Array factor of a finite Nx x Ny array driven with the Bloch phase (Kx, Ky) of the unit cell
+    // AF = sum_p sum_q exp(i p psi_x) exp(i q psi_y), psi_x = (K0 sin(theta) cos(phi) - Kx) Lx
+    template<typename T>
+    void Array_factor(const Vector_h<T>& theta,
+                      const Vector_h<T>& phi,
+                      T K0, T Kx, T Ky,
+                      T Lx, T Ly,
+                      size_t Nx, size_t Ny,
+                      Vector_h<std::complex<T>>& AF)
+    {
+        const size_t num_angles = theta.size();
+        assert(phi.size() == num_angles);
+        AF.resize(num_angles);
+
+        // sum_{p < N} exp(i p psi), stable at the grating lobes psi = 2 pi k
+        auto geometric_sum = [](T psi, size_t N) {
+            std::complex<T> e = std::exp(std::complex<T>(0, psi));
+            if(std::abs(std::sin(psi / 2)) < T(1e-6))
+            {
+                std::complex<T> s(0, 0), p(1, 0);
+                for(size_t k = 0; k < N; k++, p *= e)
+                    s += p;
+                return s;
+            }
+            return (std::exp(std::complex<T>(0, psi * N)) - T(1)) / (e - T(1));
+        };
+
+        #pragma omp parallel for
+        for(long long a = 0; a < (long long)num_angles; a++)
+        {
+            T st = std::sin(theta[a]);
+            T psi_x = (K0 * st * std::cos(phi[a]) - Kx) * Lx;
+            T psi_y = (K0 * st * std::sin(phi[a]) - Ky) * Ly;
+            AF[a] = geometric_sum(psi_x, Nx) * geometric_sum(psi_y, Ny);
+        }
+    }
+}
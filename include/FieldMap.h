@@ -0,0 +1,314 @@
+#pragma once
+
+#include "utils.h"
+#include "PGF.h"
+#include "CConv3D.h"
+#include "MappedFile.h"
+#include <functional>
+#include <limits>
+#include <future>
+#include <memory>
+
+namespace puff {
+
+    // Fills up to count observation points starting at global offset, returns how many were produced (0 at the end)
+    template<typename T>
+    using PointGenerator = std::function<size_t(size_t offset, size_t count, T* x, T* y, T* z)>;
+
+    // Receives count field values belonging to observation points [offset, offset + count)
+    template<typename T>
+    using FieldSink = std::function<void(size_t offset, const std::complex<T>* values, size_t count)>;
+
+    // Regular observation grid, flattened row-major (nx, ny, nz) with z fastest like FFT3D
+    template<typename T>
+    struct GridDescriptor {
+        T x0 = 0, y0 = 0, z0 = 0;
+        T dx = 0, dy = 0, dz = 0;
+        size_t nx = 1, ny = 1, nz = 1;
+
+        size_t size() const { return nx * ny * nz; }
+
+        void point(size_t idx, T& x, T& y, T& z) const {
+            size_t k = idx % nz;
+            size_t j = (idx / nz) % ny;
+            size_t i = idx / (ny * nz);
+            x = x0 + i * dx;
+            y = y0 + j * dy;
+            z = z0 + k * dz;
+        }
+
+        PointGenerator<T> generator() const {
+            GridDescriptor<T> grid = *this;
+            return [grid](size_t offset, size_t count, T* x, T* y, T* z) -> size_t {
+                if(offset >= grid.size()) return 0;
+                count = std::min(count, grid.size() - offset);
+                #pragma omp parallel for
+                for(long long p = 0; p < (long long)count; p++)
+                    grid.point(offset + p, x[p], y[p], z[p]);
+                return count;
+            };
+        }
+    };
+
+    // Chunked reader of observation points stored as binary (x, y, z) triples of type T
+    template<typename T>
+    PointGenerator<T> make_point_file_reader(const std::string& path) {
+        auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+        if(!file->good())
+        {
+            fprintf(stderr, "make_point_file_reader: cannot open %s\n", path.c_str());
+            exit(EXIT_FAILURE);
+        }
+        auto chunk = std::make_shared<std::vector<T>>();
+        return [file, chunk](size_t offset, size_t count, T* x, T* y, T* z) -> size_t {
+            file->seekg((std::streamoff)(offset * 3 * sizeof(T)));
+            chunk->resize(3 * count);
+            file->read(reinterpret_cast<char*>(chunk->data()), 3 * count * sizeof(T));
+            size_t read = (size_t)file->gcount() / (3 * sizeof(T));
+            file->clear();
+            for(size_t p = 0; p < read; p++)
+            {
+                x[p] = (*chunk)[3 * p];
+                y[p] = (*chunk)[3 * p + 1];
+                z[p] = (*chunk)[3 * p + 2];
+            }
+            return read;
+        };
+    }
+
+    // Sink writing field values into a memory mapped file of total complex<T> entries
+    template<typename T>
+    FieldSink<T> make_mapped_file_sink(std::shared_ptr<MappedFile> file) {
+        return [file](size_t offset, const std::complex<T>* values, size_t count) {
+            assert((offset + count) * sizeof(std::complex<T>) <= file->size());
+            std::memcpy(static_cast<std::complex<T>*>(file->data()) + offset, values, count * sizeof(std::complex<T>));
+            // Let the kernel write the tile back so resident pages stay bounded
+            file->flush(offset * sizeof(std::complex<T>), count * sizeof(std::complex<T>));
+        };
+    }
+
+    // Shared plane loop of the grid fast paths, coefficient(Kxm, Kyn, z) gives the z-dependent mode weight
+    // epsilon is the relative truncation tolerance of the calling PGF
+    template<typename T, typename Coefficient>
+    void __PGF_Grid__(const GridDescriptor<T>& grid,
+                      T Lx, T Ly,
+                      std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0,
+                      const Coefficient& coefficient,
+                      Vector_h<std::complex<T>>& G,
+                      T xs, T ys, T zs,
+                      double epsilon)
+    {
+        static_assert(std::is_same_v<T, double> || std::is_same_v<T, float>, "PGF grid evaluation supports float and double only");
+        const size_t nx = grid.nx, ny = grid.ny, nz = grid.nz;
+        G.resize(grid.size());
+        const std::complex<T> I(0, 1);
+
+        // FFT path when the grid samples exactly one lattice period, up to the rounding of dx = Lx / nx
+        // (or of nx accumulated steps) in T
+        const T eps = std::numeric_limits<T>::epsilon();
+        const bool periodic_grid = nx > 1 && ny > 1 &&
+                                   std::abs(grid.dx * nx - Lx) <= T(4) * nx * eps * Lx &&
+                                   std::abs(grid.dy * ny - Ly) <= T(4) * ny * eps * Ly;
+        FFT3D<thrust::complex<T>, cusp::host_memory> fft;
+        if(periodic_grid) fft.plan(nx, ny, 1);
+
+        std::vector<std::complex<T>> plane(nx * ny);
+        for(size_t k = 0; k < nz; k++)
+        {
+            const T z = grid.z0 + k * grid.dz - zs;
+            assert(z != 0);
+            // Same truncation as __2D_PGF__ / __3D_PGF__, grazing modes outside the window are added one by one
+            int M = __Floquet_truncation__<T>(Lx, Ly, z, epsilon);
+            const size_t P = 2 * M + 1;
+            const auto grazing = __Floquet_grazing_modes__<T>(Lx, Ly, Kx, Ky, K0, M);
+
+            if(periodic_grid)
+            {
+                // Fold modes onto the grid, exp(-i 2 pi m i / nx) aliases m to m mod nx
+                Vector_h<thrust::complex<T>> folded(nx * ny, thrust::complex<T>(0, 0));
+                auto fold = [&](int m, int n) {
+                    std::complex<T> Kxm = Kx + T(2 * M_PI_ * m / Lx);
+                    std::complex<T> shift_x = std::exp(-I * T(2 * M_PI_ * m * (grid.x0 - xs) / Lx));
+                    size_t gm = (size_t)(((long long)m % (long long)nx + (long long)nx) % (long long)nx);
+                    std::complex<T> Kyn = Ky + T(2 * M_PI_ * n / Ly);
+                    std::complex<T> shift_y = std::exp(-I * T(2 * M_PI_ * n * (grid.y0 - ys) / Ly));
+                    size_t gn = (size_t)(((long long)n % (long long)ny + (long long)ny) % (long long)ny);
+                    auto c = coefficient(Kxm, Kyn, z) * shift_x * shift_y;
+                    folded[gm * ny + gn] += thrust::complex<T>(c.real(), c.imag());
+                };
+                for(int m = -M; m <= M; m++)
+                    for(int n = -M; n <= M; n++)
+                        fold(m, n);
+                for(auto [m, n] : grazing)
+                    fold(m, n);
+                fft.forward(folded);
+                #pragma omp parallel for
+                for(long long i = 0; i < (long long)nx; i++)
+                {
+                    for(size_t j = 0; j < ny; j++)
+                    {
+                        // Bloch phase exp(-i(Kx x + Ky y)) of the incident wave
+                        T x = grid.x0 + i * grid.dx - xs, y = grid.y0 + j * grid.dy - ys;
+                        auto v = folded[i * ny + j];
+                        plane[i * ny + j] = std::complex<T>(v.real(), v.imag()) * std::exp(-I * (Kx * x + Ky * y));
+                    }
+                }
+            }
+            else
+            {
+                // Ex (P x nx), Ey (P x ny), C (P x P), all row-major
+                std::vector<std::complex<T>> Ex(P * nx), Ey(P * ny), C(P * P), W(P * ny);
+                #pragma omp parallel for
+                for(int m = -M; m <= M; m++)
+                {
+                    std::complex<T> Kxm = Kx + T(2 * M_PI_ * m / Lx);
+                    for(size_t i = 0; i < nx; i++)
+                        Ex[(m + M) * nx + i] = std::exp(-I * Kxm * (grid.x0 + i * grid.dx - xs));
+                    for(int n = -M; n <= M; n++)
+                        C[(m + M) * P + (n + M)] = coefficient(Kxm, Ky + T(2 * M_PI_ * n / Ly), z);
+                }
+                #pragma omp parallel for
+                for(int n = -M; n <= M; n++)
+                {
+                    std::complex<T> Kyn = Ky + T(2 * M_PI_ * n / Ly);
+                    for(size_t j = 0; j < ny; j++)
+                        Ey[(n + M) * ny + j] = std::exp(-I * Kyn * (grid.y0 + j * grid.dy - ys));
+                }
+
+                const std::complex<T> alpha(1, 0), beta(0, 0);
+                if constexpr(std::is_same_v<T, double>)
+                {
+                    cblas_zgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, P, ny, P,
+                                &alpha, C.data(), P, Ey.data(), ny, &beta, W.data(), ny);
+                    cblas_zgemm(CblasRowMajor, CblasTrans, CblasNoTrans, nx, ny, P,
+                                &alpha, Ex.data(), nx, W.data(), ny, &beta, plane.data(), ny);
+                }
+                else
+                {
+                    cblas_cgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, P, ny, P,
+                                &alpha, C.data(), P, Ey.data(), ny, &beta, W.data(), ny);
+                    cblas_cgemm(CblasRowMajor, CblasTrans, CblasNoTrans, nx, ny, P,
+                                &alpha, Ex.data(), nx, W.data(), ny, &beta, plane.data(), ny);
+                }
+                // Rank-one update per grazing mode outside the window
+                for(auto [m, n] : grazing)
+                {
+                    std::complex<T> Kxm = Kx + T(2 * M_PI_ * m / Lx), Kyn = Ky + T(2 * M_PI_ * n / Ly);
+                    auto c = coefficient(Kxm, Kyn, z);
+                    #pragma omp parallel for
+                    for(long long i = 0; i < (long long)nx; i++)
+                    {
+                        auto ci = c * std::exp(-I * Kxm * (grid.x0 + i * grid.dx - xs));
+                        for(size_t j = 0; j < ny; j++)
+                            plane[i * ny + j] += ci * std::exp(-I * Kyn * (grid.y0 + j * grid.dy - ys));
+                    }
+                }
+            }
+
+            #pragma omp parallel for
+            for(long long ij = 0; ij < (long long)(nx * ny); ij++)
+                G[ij * nz + k] = plane[ij];
+        }
+    }
+
+    // Regular grid fast path of __2D_PGF__(r - r_source) with a grid in grid order (z fastest)
+    // exp(-i(Kxm x + Kyn y)) separates into exp(-i Kxm x_i) exp(-i Kyn y_j), so each z-plane is
+    // G = Ex^T (C Ey) with one coefficient C_mn = exp(-i Kzmn |z|) / (2i Kzmn Lx Ly) per mode, i.e. two GEMMs.
+    // When the grid covers exactly one period (dx = Lx / nx, dy = Ly / ny) the plane is a single 2D FFT of the folded C.
+    template<typename T>
+    void __2D_PGF_Grid__(const GridDescriptor<T>& grid,
+                         T Lx, T Ly,
+                         std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0,
+                         Vector_h<std::complex<T>>& G,
+                         T xs = 0, T ys = 0, T zs = 0,
+                         double epi = 1e-10)
+    {
+        auto coefficient = [&](std::complex<T> Kxm, std::complex<T> Kyn, T z) {
+            auto Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+            return std::exp(std::complex<T>(0, -1) * Kzmn * std::abs(z)) / (T(2) * std::complex<T>(0, 1) * Kzmn * Lx * Ly);
+        };
+        __PGF_Grid__(grid, Lx, Ly, Kx, Ky, K0, coefficient, G, xs, ys, zs, epi / std::min(Lx, Ly));
+    }
+
+    // Regular grid fast path of __3D_PGF__(r - r_source), same separation as __2D_PGF_Grid__ with the
+    // z-bracket of the triply periodic series folded into the per-plane coefficient
+    template<typename T>
+    void __3D_PGF_Grid__(const GridDescriptor<T>& grid,
+                         T Lx, T Ly, T Lz,
+                         std::complex<T> Kx, std::complex<T> Ky, std::complex<T> Kz, std::complex<T> K0,
+                         Vector_h<std::complex<T>>& G,
+                         T xs = 0, T ys = 0, T zs = 0,
+                         double epi = 1e-10)
+    {
+        const std::complex<T> I(0, 1);
+        auto coefficient = [&](std::complex<T> Kxm, std::complex<T> Kyn, T z) {
+            auto Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+            return __3D_PGF_bracket__<T>(Kzmn, Kz, z, Lz) / (T(2) * I * Lx * Ly);
+        };
+        __PGF_Grid__(grid, Lx, Ly, Kx, Ky, K0, coefficient, G, xs, ys, zs, epi / std::min(Lx, std::min(Ly, Lz)));
+    }
+
+    // Streaming evaluation of __2D_PGF__(r - r_source) over arbitrarily many observation points
+    // Points are pulled from a generator in fixed size tiles, each tile is evaluated by the OpenMP team
+    // and handed to the sink asynchronously while the next tile computes, so memory is two tiles regardless of grid size
+    template<typename T>
+    class PGFStreamEvaluator {
+        public:
+            PGFStreamEvaluator(T Lx, T Ly,
+                               std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0,
+                               double epi = 1e-10,
+                               size_t tile_size = size_t(1) << 16)
+                : Lx(Lx), Ly(Ly), Kx(Kx), Ky(Ky), K0(K0), epi(epi), tile_size(tile_size) {
+                for(auto& tile : tiles)
+                {
+                    tile.x.resize(tile_size);
+                    tile.y.resize(tile_size);
+                    tile.z.resize(tile_size);
+                    tile.values.resize(tile_size);
+                }
+            }
+
+            // Returns the number of points evaluated
+            size_t run(const PointGenerator<T>& generator, const FieldSink<T>& sink,
+                       T xs = 0, T ys = 0, T zs = 0) {
+                size_t offset = 0;
+                int current = 0;
+                std::future<void> pending;
+                while(true)
+                {
+                    Tile& tile = tiles[current];
+                    size_t count = generator(offset, tile_size, tile.x.data(), tile.y.data(), tile.z.data());
+                    if(count == 0) break;
+
+                    #pragma omp parallel for schedule(dynamic, 64)
+                    for(long long p = 0; p < (long long)count; p++)
+                        tile.values[p] = __2D_PGF__<T>(tile.x[p] - xs, tile.y[p] - ys, tile.z[p] - zs,
+                                                       Lx, Ly, T(0), Kx, Ky, std::complex<T>(0, 0), K0, epi);
+
+                    // The other tile buffer is reused next iteration, its write must have finished
+                    if(pending.valid()) pending.get();
+                    pending = std::async(std::launch::async, [&sink, &tile, offset, count]() {
+                        sink(offset, tile.values.data(), count);
+                    });
+
+                    offset += count;
+                    current ^= 1;
+                }
+                if(pending.valid()) pending.get();
+                return offset;
+            }
+
+        private:
+            struct Tile {
+                std::vector<T> x, y, z;
+                std::vector<std::complex<T>> values;
+            };
+
+            T Lx, Ly;
+            std::complex<T> Kx, Ky, K0;
+            double epi;
+            size_t tile_size;
+            Tile tiles[2];
+    };
+
+}
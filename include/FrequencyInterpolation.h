@@ -0,0 +1,272 @@
+#pragma once
+
+#include "utils.h"
+#include "PGF.h"
+#include <functional>
+
+namespace puff {
+
+    // Piecewise Chebyshev interpolation in K0 of a vector of values (PGF samples or assembled matrix entries)
+    // Segments are split at Wood's anomalies, where a Floquet mode grazes (Kzmn -> 0) and the values behave
+    // like 1 / sqrt(K0 - w). Between two anomalies w1 < w2 a single segment uses the angle t with
+    // K0 = (w1 + w2) / 2 - (w2 - w1) / 2 cos(t) and interpolates sin(t) * f, which is smooth at both ends.
+    // Next to the one anomaly w of an outer interval the variable is t = sqrt(|K0 - w|) and the quantity t * f.
+    // Segments are bisected until they pass an a-posteriori check against fresh evaluations; a guard band
+    // around each anomaly and segments that fail to converge are evaluated directly.
+    template<typename T>
+    class FrequencyInterpolant {
+        public:
+            // Fills values[0 .. num_values) at frequency K0
+            using Evaluator = std::function<void(T K0, std::complex<T>* values)>;
+
+            // nodes is the largest degree of a segment, tried from nodes / 3^k (at least 4) upward
+            FrequencyInterpolant(size_t num_values, Evaluator evaluator, T tol = 1e-8, int nodes = 24, int max_depth = 12)
+                : num_values(num_values), evaluator(evaluator), tol(tol), nodes(std::max(nodes, 3)), max_depth(max_depth) {}
+
+            // guard is the half width of the directly evaluated band around each anomaly
+            void build(T K0_min, T K0_max, const std::vector<T>& anomalies = {}, T guard = 0) {
+                segments.clear();
+                build_evaluations = 0;
+                direct_evaluations = 0;
+                this->K0_min = K0_min;
+                this->K0_max = K0_max;
+                this->guard = guard;
+                this->anomalies.clear();
+                for(T w : anomalies)
+                    if(w > K0_min && w < K0_max) this->anomalies.push_back(w);
+                std::sort(this->anomalies.begin(), this->anomalies.end());
+
+                // One segment between consecutive breakpoints, mapped after the anomalies at its ends
+                std::vector<T> breaks{K0_min};
+                breaks.insert(breaks.end(), this->anomalies.begin(), this->anomalies.end());
+                breaks.push_back(K0_max);
+                for(size_t i = 0; i + 1 < breaks.size(); i++)
+                {
+                    T lo = breaks[i], hi = breaks[i + 1];
+                    bool left = i > 0, right = i + 2 < breaks.size();
+                    if(left) lo += guard;
+                    if(right) hi -= guard;
+                    if(lo >= hi) continue;
+                    Map map;
+                    if(left && right) map = {Variable::Angle, breaks[i], 1, breaks[i + 1]};
+                    else if(left) map = {Variable::Sqrt, breaks[i], 1, 0};
+                    else if(right) map = {Variable::Sqrt, breaks[i + 1], -1, 0};
+                    T ta = to_t(map, lo), tb = to_t(map, hi);
+                    add_segment(std::min(ta, tb), std::max(ta, tb), map, 0);
+                }
+                std::sort(segments.begin(), segments.end(), [](const Segment& u, const Segment& v) { return u.a < v.a; });
+            }
+
+            // Interpolated where a converged segment covers K0, direct evaluation otherwise
+            void evaluate(T K0, std::complex<T>* values) {
+                const Segment* segment = find(K0);
+                if(segment == nullptr)
+                {
+                    evaluator(K0, values);
+                    direct_evaluations++;
+                    return;
+                }
+                interpolate(*segment, K0, values);
+            }
+
+            void evaluate(T K0, std::vector<std::complex<T>>& values) {
+                values.resize(num_values);
+                evaluate(K0, values.data());
+            }
+
+            size_t get_build_evaluations() const { return build_evaluations; }
+            size_t get_direct_evaluations() const { return direct_evaluations; }
+            size_t get_num_segments() const { return segments.size(); }
+            const std::vector<T>& get_anomalies() const { return anomalies; }
+
+            void report(FILE* out = stdout) const {
+                size_t direct = 0;
+                for(auto& segment : segments) direct += segment.direct;
+                fprintf(out, "FrequencyInterpolant: %zu segments (%zu direct), %zu anomalies, %zu build and %zu direct evaluations\n",
+                        segments.size(), direct, anomalies.size(), build_evaluations, direct_evaluations);
+            }
+
+        private:
+            // Interpolation variable t of a segment and the weight the values are multiplied by
+            enum class Variable {
+                K0,    // t = K0, weight 1
+                Sqrt,  // t = sqrt(side * (K0 - w)), weight t
+                Angle  // K0 = (w + w2) / 2 - (w2 - w) / 2 cos(t), weight sin(t)
+            };
+            struct Map {
+                Variable variable = Variable::K0;
+                T w = 0, side = 1, w2 = 0;
+            };
+            struct Segment {
+                T a, b;                              // K0 range
+                Map map;
+                bool direct = false;
+                std::vector<T> t, weights;           // first kind Chebyshev nodes in t and barycentric weights
+                std::vector<std::complex<T>> values; // [node][value] of f times the weight
+            };
+
+            size_t num_values;
+            Evaluator evaluator;
+            T tol;
+            int nodes, max_depth;
+            T K0_min = 0, K0_max = 0, guard = 0;
+            std::vector<T> anomalies;
+            std::vector<Segment> segments;
+            size_t build_evaluations = 0, direct_evaluations = 0;
+
+            static T to_t(const Map& m, T K0) {
+                if(m.variable == Variable::Sqrt) return std::sqrt(std::max(T(0), m.side * (K0 - m.w)));
+                if(m.variable == Variable::Angle) return std::acos(std::clamp((m.w + m.w2 - 2 * K0) / (m.w2 - m.w), T(-1), T(1)));
+                return K0;
+            }
+            static T to_K0(const Map& m, T t) {
+                if(m.variable == Variable::Sqrt) return m.w + m.side * t * t;
+                if(m.variable == Variable::Angle) return (m.w + m.w2) / 2 - (m.w2 - m.w) / 2 * std::cos(t);
+                return t;
+            }
+            static T weight(const Map& m, T t) {
+                if(m.variable == Variable::Sqrt) return t;
+                if(m.variable == Variable::Angle) return std::sin(t);
+                return 1;
+            }
+
+            const Segment* find(T K0) const {
+                if(K0 < K0_min || K0 > K0_max) return nullptr;
+                auto it = std::upper_bound(segments.begin(), segments.end(), K0, [](T k, const Segment& s) { return k < s.a; });
+                if(it == segments.begin()) return nullptr;
+                --it;
+                if(K0 > it->b || it->direct) return nullptr;
+                if(it->map.variable != Variable::K0 && (K0 == it->map.w || (it->map.variable == Variable::Angle && K0 == it->map.w2))) return nullptr;
+                return &*it;
+            }
+
+            void interpolate(const Segment& segment, T K0, std::complex<T>* values) const {
+                const T t = to_t(segment.map, K0);
+                const T unscale = 1 / weight(segment.map, t);
+                std::vector<T> c(segment.t.size());
+                T denominator = 0;
+                for(size_t j = 0; j < segment.t.size(); j++)
+                {
+                    if(t == segment.t[j])
+                    {
+                        for(size_t i = 0; i < num_values; i++)
+                            values[i] = segment.values[j * num_values + i] * unscale;
+                        return;
+                    }
+                    c[j] = segment.weights[j] / (t - segment.t[j]);
+                    denominator += c[j];
+                }
+                for(size_t i = 0; i < num_values; i++)
+                {
+                    std::complex<T> numerator(0, 0);
+                    for(size_t j = 0; j < segment.t.size(); j++)
+                        numerator += c[j] * segment.values[j * num_values + i];
+                    values[i] = numerator / denominator * unscale;
+                }
+            }
+
+            void add_segment(T ta, T tb, const Map& map, int depth) {
+                Segment segment;
+                segment.map = map;
+                T Ka = to_K0(map, ta), Kb = to_K0(map, tb);
+                segment.a = std::min(Ka, Kb);
+                segment.b = std::max(Ka, Kb);
+                if(depth >= max_depth)
+                {
+                    segment.direct = true;
+                    segments.push_back(std::move(segment));
+                    return;
+                }
+
+                // Degrees grow by three up to nodes: the first kind nodes of n are every third node of 3 n,
+                // so a segment that needs the full degree costs no more than with a fixed one
+                int n = nodes;
+                while(n % 3 == 0 && n / 3 >= 4) n /= 3;
+                bool converged = false;
+                T scale = 1;
+                std::vector<std::complex<T>> previous;
+                for(int first = n; ; n *= 3)
+                {
+                    previous.swap(segment.values);
+                    segment.t.resize(n);
+                    segment.weights.resize(n);
+                    segment.values.resize((size_t)n * num_values);
+                    for(int j = 0; j < n; j++)
+                    {
+                        T theta = (2 * j + 1) * M_PI_ / (2 * n);
+                        segment.t[j] = (ta + tb) / 2 - (tb - ta) / 2 * std::cos(theta);
+                        segment.weights[j] = ((j % 2) ? -1 : 1) * std::sin(theta);
+                        std::complex<T>* v = &segment.values[(size_t)j * num_values];
+                        if(n > first && j % 3 == 1)
+                        {
+                            std::copy_n(&previous[(size_t)(j / 3) * num_values], num_values, v);
+                            continue;
+                        }
+                        evaluator(to_K0(map, segment.t[j]), v);
+                        build_evaluations++;
+                        const T scale_j = weight(map, segment.t[j]);
+                        for(size_t i = 0; i < num_values; i++) v[i] *= scale_j;
+                    }
+
+                    scale = 0;
+                    for(auto& v : segment.values) scale = std::max(scale, std::abs(v));
+                    if(scale == 0) scale = 1;
+
+                    // Free check first: the last two Chebyshev coefficients of every entry must be below tolerance
+                    converged = true;
+                    for(size_t i = 0; i < num_values && converged; i++)
+                    {
+                        for(int k = n - 2; k < n; k++)
+                        {
+                            std::complex<T> ck(0, 0);
+                            for(int j = 0; j < n; j++)
+                                ck += segment.values[(size_t)j * num_values + i] * T(std::cos(k * (2 * j + 1) * M_PI_ / (2 * n)));
+                            if(std::abs(ck) * 2 / n > tol * scale) converged = false;
+                        }
+                    }
+                    if(converged || n * 3 > nodes) break;
+                }
+
+                // A-posteriori check against fresh evaluations between the outermost nodes, where errors peak
+                if(converged)
+                {
+                    std::vector<std::complex<T>> exact(num_values), approx(num_values);
+                    for(T t : {(segment.t[0] + segment.t[1]) / 2, (segment.t[n - 2] + segment.t[n - 1]) / 2})
+                    {
+                        T K0 = to_K0(map, t);
+                        evaluator(K0, exact.data());
+                        build_evaluations++;
+                        interpolate(segment, K0, approx.data());
+                        const T scale_t = weight(map, t);
+                        for(size_t i = 0; i < num_values; i++)
+                            if(std::abs(exact[i] - approx[i]) * scale_t > tol * scale) converged = false;
+                    }
+                }
+
+                if(converged)
+                {
+                    segments.push_back(std::move(segment));
+                    return;
+                }
+                add_segment(ta, (ta + tb) / 2, map, depth + 1);
+                add_segment((ta + tb) / 2, tb, map, depth + 1);
+            }
+    };
+
+    // Evaluator of __2D_PGF__ at a fixed set of observation points, Bloch wavenumbers Kx + sx * K0 and Ky + sy * K0
+    template<typename T>
+    typename FrequencyInterpolant<T>::Evaluator make_PGF_frequency_evaluator(const std::vector<T>& x,
+                                                                              const std::vector<T>& y,
+                                                                              const std::vector<T>& z,
+                                                                              T Lx, T Ly, T Kx, T Ky,
+                                                                              T sx = 0, T sy = 0,
+                                                                              double epi = 1e-10) {
+        return [=](T K0, std::complex<T>* values) {
+            std::complex<T> kx(Kx + sx * K0, 0), ky(Ky + sy * K0, 0), k0(K0, 0);
+            #pragma omp parallel for
+            for(long long p = 0; p < (long long)x.size(); p++)
+                values[p] = __2D_PGF__<T>(x[p], y[p], z[p], Lx, Ly, 0, kx, ky, 0, k0, epi);
+        };
+    }
+
+}
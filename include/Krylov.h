@@ -0,0 +1,50 @@
+#pragma once
+
+#include "utils.h"
+#include <random>
+
+namespace puff {
+
+    // Short-recurrence Krylov solvers on host arrays with the conventions of cusp::krylov: A and M are
+    // anything cusp::multiply accepts (matrices, linear operators), monitor is a cusp::monitor fed the
+    // true residual b - A x, M approximates A^{-1} and defaults to the identity (no products, no copies).
+    // Vector updates of a sweep are fused with the dot products that follow them to save passes over memory
+
+    // Conjugate orthogonal CG for complex symmetric A (A = A^T, not Hermitian): CG with the unconjugated
+    // bilinear form x^T y. One product with A per iteration and four vectors besides x. M must be complex symmetric
+    template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+    void cocg(LinearOperator& A, Array& x, const Array& b, Monitor& monitor, Preconditioner& M);
+
+    template<typename LinearOperator, typename Array, typename Monitor>
+    void cocg(LinearOperator& A, Array& x, const Array& b, Monitor& monitor);
+
+    // Conjugate orthogonal CR for complex symmetric A: minimizes in the A-bilinear form, which gives
+    // smoother residual histories than COCG at the same cost (one product with A per iteration, six vectors)
+    template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+    void cocr(LinearOperator& A, Array& x, const Array& b, Monitor& monitor, Preconditioner& M);
+
+    template<typename LinearOperator, typename Array, typename Monitor>
+    void cocr(LinearOperator& A, Array& x, const Array& b, Monitor& monitor);
+
+    // IDR(s) for general A: s shadow vectors, one product per iteration and 3s + 4 vectors whatever the
+    // iteration count. Right preconditioned, so the monitor sees the true residual.
+    // The biorthogonalization of a step takes one fused pass of s dot products and one of 2k axpys
+    template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+    void idrs(LinearOperator& A, Array& x, const Array& b, size_t s, Monitor& monitor, Preconditioner& M);
+
+    template<typename LinearOperator, typename Array, typename Monitor>
+    void idrs(LinearOperator& A, Array& x, const Array& b, size_t s, Monitor& monitor);
+
+    // BiCGStab(l) for general A: l BiCG steps followed by a degree l minimal residual polynomial, which
+    // copes with the complex spectra where BiCGStab stagnates. 2l products per cycle and 2l + 5 vectors.
+    // The residual polynomial comes from the Gram matrix of the l + 1 residuals, computed in one pass.
+    // Right preconditioned
+    template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+    void bicgstabl(LinearOperator& A, Array& x, const Array& b, size_t l, Monitor& monitor, Preconditioner& M);
+
+    template<typename LinearOperator, typename Array, typename Monitor>
+    void bicgstabl(LinearOperator& A, Array& x, const Array& b, size_t l, Monitor& monitor);
+
+}
+
+#include "details/Krylov.inl"
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "utils.h"
+#include "mkl.h"
+#include "mkl_spblas.h"
+
+namespace puff {
+
+    // Operation of a host product y = op(A) x, used for the inspector hints
+    enum class SpMVOperation {
+        NonTranspose,
+        Transpose,
+        ConjugateTranspose
+    };
+
+    // Expected number of products per operation, registered with mkl_sparse_set_mv_hint before the single mkl_sparse_optimize
+    struct MKLSparseHint {
+        size_t expected_calls = 100;
+        std::vector<SpMVOperation> operations{SpMVOperation::NonTranspose};
+    };
+
+    // Inspector-executor handle over CSR arrays owned by the caller (no copy), double / float / dcomplex / fcomplex.
+    // The arrays must stay alive and unmoved while the handle exists
+    template<typename ValueType>
+    class MKLSparseMatrix {
+        public:
+            static constexpr bool supported = std::is_same_v<ValueType, double> || std::is_same_v<ValueType, float> ||
+                                              std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>;
+
+            MKLSparseMatrix() {}
+            ~MKLSparseMatrix() { reset(); }
+            MKLSparseMatrix(const MKLSparseMatrix&) = delete;
+            MKLSparseMatrix& operator=(const MKLSparseMatrix&) = delete;
+
+            template<typename IndexType>
+            void create(size_t num_rows, size_t num_cols,
+                        const IndexType* row_offsets, const IndexType* column_indices, const ValueType* values,
+                        const MKLSparseHint& hint = MKLSparseHint()) {
+                static_assert(supported, "MKL sparse backend supports double, float, dcomplex and fcomplex");
+                static_assert(sizeof(IndexType) == sizeof(MKL_INT), "CSR indices must match MKL_INT (LP64: 32-bit)");
+                reset();
+                if(num_rows == 0) return;
+                MKL_INT* rows_start = reinterpret_cast<MKL_INT*>(const_cast<IndexType*>(row_offsets));
+                MKL_INT* columns = reinterpret_cast<MKL_INT*>(const_cast<IndexType*>(column_indices));
+                if constexpr(std::is_same_v<ValueType, double>)
+                    CHECK_MKL_SPARSE(mkl_sparse_d_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, (MKL_INT)num_rows, (MKL_INT)num_cols,
+                                                             rows_start, rows_start + 1, columns, const_cast<double*>(values)))
+                else if constexpr(std::is_same_v<ValueType, float>)
+                    CHECK_MKL_SPARSE(mkl_sparse_s_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, (MKL_INT)num_rows, (MKL_INT)num_cols,
+                                                             rows_start, rows_start + 1, columns, const_cast<float*>(values)))
+                else if constexpr(std::is_same_v<ValueType, dcomplex>)
+                    CHECK_MKL_SPARSE(mkl_sparse_z_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, (MKL_INT)num_rows, (MKL_INT)num_cols,
+                                                             rows_start, rows_start + 1, columns,
+                                                             reinterpret_cast<MKL_Complex16*>(const_cast<ValueType*>(values))))
+                else
+                    CHECK_MKL_SPARSE(mkl_sparse_c_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, (MKL_INT)num_rows, (MKL_INT)num_cols,
+                                                             rows_start, rows_start + 1, columns,
+                                                             reinterpret_cast<MKL_Complex8*>(const_cast<ValueType*>(values))))
+
+                // Hints are advisory, MKL may decline them (SPARSE_STATUS_NOT_SUPPORTED) and still run the product
+                for(auto operation : hint.operations)
+                    mkl_sparse_set_mv_hint(handle, to_mkl(operation), general(), (MKL_INT)hint.expected_calls);
+                CHECK_MKL_SPARSE(mkl_sparse_optimize(handle))
+            }
+
+            void reset() {
+                if(handle != nullptr) mkl_sparse_destroy(handle);
+                handle = nullptr;
+            }
+
+            bool valid() const { return handle != nullptr; }
+
+            // y = alpha * op(A) * x + beta * y
+            void mv(SpMVOperation operation, ValueType alpha, const ValueType* x, ValueType beta, ValueType* y) const {
+                if constexpr(std::is_same_v<ValueType, double>)
+                    CHECK_MKL_SPARSE(mkl_sparse_d_mv(to_mkl(operation), alpha, handle, general(), x, beta, y))
+                else if constexpr(std::is_same_v<ValueType, float>)
+                    CHECK_MKL_SPARSE(mkl_sparse_s_mv(to_mkl(operation), alpha, handle, general(), x, beta, y))
+                else if constexpr(std::is_same_v<ValueType, dcomplex>)
+                    CHECK_MKL_SPARSE(mkl_sparse_z_mv(to_mkl(operation), MKL_Complex16{alpha.real(), alpha.imag()}, handle, general(),
+                                                     reinterpret_cast<const MKL_Complex16*>(x),
+                                                     MKL_Complex16{beta.real(), beta.imag()},
+                                                     reinterpret_cast<MKL_Complex16*>(y)))
+                else
+                    CHECK_MKL_SPARSE(mkl_sparse_c_mv(to_mkl(operation), MKL_Complex8{alpha.real(), alpha.imag()}, handle, general(),
+                                                     reinterpret_cast<const MKL_Complex8*>(x),
+                                                     MKL_Complex8{beta.real(), beta.imag()},
+                                                     reinterpret_cast<MKL_Complex8*>(y)))
+            }
+
+        private:
+            sparse_matrix_t handle = nullptr;
+
+            static matrix_descr general() {
+                matrix_descr descr;
+                descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+                descr.mode = SPARSE_FILL_MODE_FULL;
+                descr.diag = SPARSE_DIAG_NON_UNIT;
+                return descr;
+            }
+
+            static sparse_operation_t to_mkl(SpMVOperation operation) {
+                switch(operation)
+                {
+                    case SpMVOperation::Transpose: return SPARSE_OPERATION_TRANSPOSE;
+                    case SpMVOperation::ConjugateTranspose: return SPARSE_OPERATION_CONJUGATE_TRANSPOSE;
+                    default: return SPARSE_OPERATION_NON_TRANSPOSE;
+                }
+            }
+    };
+
+}
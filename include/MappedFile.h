@@ -0,0 +1,159 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace puff {
+
+    // RAII file mapping, read-only for existing files or read-write with a fixed size for new files
+    // Falls back to a heap copy flushed on destruction where mmap is unavailable
+    class MappedFile {
+        public:
+            MappedFile() {}
+
+            // Map an existing file read-only
+            explicit MappedFile(const std::string& path) {
+                open_read(path);
+            }
+
+            // Create (or truncate) a file of the given size and map it read-write
+            MappedFile(const std::string& path, size_t bytes) {
+                open_write(path, bytes);
+            }
+
+            ~MappedFile() {
+                close();
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            MappedFile(MappedFile&& other) noexcept {
+                *this = std::move(other);
+            }
+
+            MappedFile& operator=(MappedFile&& other) noexcept {
+                if(this != &other)
+                {
+                    close();
+                    std::swap(path, other.path);
+                    std::swap(ptr, other.ptr);
+                    std::swap(bytes, other.bytes);
+                    std::swap(writable, other.writable);
+                    std::swap(fallback, other.fallback);
+                }
+                return *this;
+            }
+
+            void* data() { return ptr; }
+            const void* data() const { return ptr; }
+            size_t size() const { return bytes; }
+
+            // Write back a byte range to the file without unmapping
+            void flush(size_t offset, size_t length, bool async = true) {
+#ifndef _WIN32
+                if(!writable || ptr == nullptr || length == 0) return;
+                long page = sysconf(_SC_PAGESIZE);
+                size_t begin = offset / page * page;
+                msync(static_cast<char*>(ptr) + begin, offset + length - begin, async ? MS_ASYNC : MS_SYNC);
+#endif
+            }
+
+            void close() {
+                if(ptr == nullptr) return;
+#ifndef _WIN32
+                if(writable) msync(ptr, bytes, MS_SYNC);
+                munmap(ptr, bytes);
+#else
+                if(writable)
+                {
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    out.write(fallback.data(), fallback.size());
+                }
+                std::vector<char>().swap(fallback);
+#endif
+                ptr = nullptr;
+                bytes = 0;
+            }
+
+        private:
+            std::string path;
+            void* ptr = nullptr;
+            size_t bytes = 0;
+            bool writable = false;
+            std::vector<char> fallback;
+
+            void open_read(const std::string& file) {
+                path = file;
+                writable = false;
+#ifndef _WIN32
+                int fd = ::open(file.c_str(), O_RDONLY);
+                if(fd < 0)
+                {
+                    fprintf(stderr, "MappedFile: cannot open %s\n", file.c_str());
+                    exit(EXIT_FAILURE);
+                }
+                struct stat st;
+                fstat(fd, &st);
+                bytes = (size_t)st.st_size;
+                if(bytes > 0)
+                {
+                    ptr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+                    if(ptr == MAP_FAILED)
+                    {
+                        fprintf(stderr, "MappedFile: mmap of %s failed\n", file.c_str());
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                ::close(fd);
+#else
+                std::ifstream in(file, std::ios::binary | std::ios::ate);
+                bytes = (size_t)in.tellg();
+                fallback.resize(bytes);
+                in.seekg(0);
+                in.read(fallback.data(), bytes);
+                ptr = bytes ? fallback.data() : nullptr;
+#endif
+            }
+
+            void open_write(const std::string& file, size_t size) {
+                path = file;
+                writable = true;
+                bytes = size;
+#ifndef _WIN32
+                int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if(fd < 0 || ftruncate(fd, (off_t)size) != 0)
+                {
+                    fprintf(stderr, "MappedFile: cannot create %s\n", file.c_str());
+                    exit(EXIT_FAILURE);
+                }
+                if(bytes > 0)
+                {
+                    ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if(ptr == MAP_FAILED)
+                    {
+                        fprintf(stderr, "MappedFile: mmap of %s failed\n", file.c_str());
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                ::close(fd);
+#else
+                fallback.assign(size, 0);
+                ptr = size ? fallback.data() : nullptr;
+#endif
+            }
+    };
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CConv3D.h"
+#include "PGF.h"
+
+namespace puff{
+
+// Spreading kernel of the NUFFT, evaluated on z in [-1, 1]
+enum class NUFFTKernel {
+    ExponentialSemicircle, // exp(beta * (sqrt(1 - z^2) - 1))
+    Gaussian               // exp(-beta * z^2)
+};
+
+// Non-uniform FFT in up to 3 dimensions, host version built on FFT3D_h
+// Points live on the periodic box [-pi, pi)^d, modes k_d run over [-N_d / 2, (N_d - 1) / 2]
+// type 1: f_k = sum_j c_j exp(iflag * i k.x_j)   (non-uniform -> uniform)
+// type 2: c_j = sum_k f_k exp(iflag * i k.x_j)   (uniform -> non-uniform)
+// Modes are stored row-major (N1, N2, N3), unit dimensions are ignored
+template<typename ValueType, typename MemorySpace>
+class NUFFT3D;
+
+template<typename ValueType>
+class NUFFT3D<ValueType, cusp::host_memory>{
+    public:
+        using Real = typename ValueType::value_type;
+
+        NUFFT3D() {}
+        NUFFT3D(size_t N1, size_t N2, size_t N3, int iflag = -1, double tol = 1e-9,
+                NUFFTKernel kernel = NUFFTKernel::ExponentialSemicircle) {
+            plan(N1, N2, N3, iflag, tol, kernel);
+        }
+
+        void plan(size_t N1, size_t N2, size_t N3, int iflag = -1, double tol = 1e-9,
+                  NUFFTKernel kernel = NUFFTKernel::ExponentialSemicircle);
+
+        // Set non-uniform points, unused dimensions may pass empty vectors
+        // Points are binned into fine grid tiles once and reused by every execute call
+        void set_points(const Vector<Real, cusp::host_memory>& x1,
+                        const Vector<Real, cusp::host_memory>& x2,
+                        const Vector<Real, cusp::host_memory>& x3);
+
+        void type1(const Vector<ValueType, cusp::host_memory>& c, Vector<ValueType, cusp::host_memory>& f);
+        void type2(const Vector<ValueType, cusp::host_memory>& f, Vector<ValueType, cusp::host_memory>& c);
+
+        size_t num_modes() const { return N[0] * N[1] * N[2]; }
+        size_t num_points() const { return M; }
+        int kernel_width() const { return w; }
+
+    private:
+        static constexpr int TILE = 16;
+
+        size_t N[3] = {1, 1, 1};   // number of modes
+        size_t n[3] = {1, 1, 1};   // fine grid size
+        int iflag = -1;
+        int w = 1;                 // kernel width in fine grid points
+        Real beta = 0;
+        NUFFTKernel kernel = NUFFTKernel::ExponentialSemicircle;
+
+        FFT3D<ValueType, cusp::host_memory> fft;
+        Vector<ValueType, cusp::host_memory> fine;
+        Vector<Real, cusp::host_memory> correction[3]; // 1 / kernel transform per mode
+
+        size_t M = 0;
+        Vector<Real, cusp::host_memory> x[3];          // points scaled to fine grid units [0, n)
+        Vector<size_t, cusp::host_memory> order;       // point indices sorted by tile
+        Vector<size_t, cusp::host_memory> tile_offsets;
+        size_t num_tiles[3] = {1, 1, 1};
+
+        static void gauss_legendre(int q, std::vector<double>& nodes, std::vector<double>& weights);
+        Real kernel_value(Real z) const;
+        // Kernel weights along one dimension, returns the first fine grid index touched
+        long long kernel_weights(int d, Real xd, Real* weights) const;
+        void spread(const Vector<ValueType, cusp::host_memory>& c);
+        void interpolate(Vector<ValueType, cusp::host_memory>& c) const;
+};
+
+// Evaluate the 2D PGF (as in __2D_PGF__) at many observation points of a common height z above a source at the origin
+// The Floquet sum sum_mn exp(-i(Kxm x + Kyn y)) exp(-i Kzmn |z|) / (2i Kzmn Lx Ly) is a type 2 NUFFT in (x, y),
+// so M points cost O(M + P^2 log P) for P^2 Floquet modes instead of O(M P^2)
+template<typename T>
+void __2D_PGF_Plane_NUFFT__(const Vector<T, cusp::host_memory>& x,
+                            const Vector<T, cusp::host_memory>& y,
+                            T z, T Lx, T Ly,
+                            std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0,
+                            Vector<thrust::complex<T>, cusp::host_memory>& G,
+                            double epi = 1e-10);
+
+template<typename ValueType>
+using NUFFT3D_h = NUFFT3D<ValueType, cusp::host_memory>;
+
+}
+
+#include "details/NUFFT.inl"
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "SparseMatrix.h"
+
+namespace puff {
+
+    // Matrix-free near-field operator: only the interaction pattern is stored, the values are recomputed
+    // by kernel inside every product, row by row into a small per-thread buffer that is consumed right away.
+    // kernel is either batched, kernel(row, const IndexType* cols, size_t n, ValueType* out) filling a whole
+    // row (the place to vectorize across its entries), or scalar, kernel(row, col) -> ValueType.
+    // A cache budget keeps the values of the most expensive rows. Host only, same SpMV interface as SparseMatrixWrapper
+    template<typename ValueType, typename Kernel, typename IndexType = INDEX_TYPE>
+    class NearFieldOperator {
+        public:
+            typedef typename cusp::norm_type<ValueType>::type Real;
+
+            NearFieldOperator(Kernel kernel) : kernel(std::move(kernel)) {}
+
+            size_t get_num_rows() const { return num_rows; }
+            size_t get_num_cols() const { return num_cols; }
+            size_t get_num_entries() const { return column_indices.size(); }
+
+            // Sorted CSR interaction pattern
+            void set_pattern(size_t num_rows, size_t num_cols, std::vector<IndexType> row_offsets, std::vector<IndexType> column_indices) {
+                this->num_rows = num_rows;
+                this->num_cols = num_cols;
+                this->row_offsets = std::move(row_offsets);
+                this->column_indices = std::move(column_indices);
+                max_row_entries = 0;
+                for(size_t i = 0; i < num_rows; i++)
+                    max_row_entries = std::max<size_t>(max_row_entries, this->row_offsets[i + 1] - this->row_offsets[i]);
+                row_cost.clear();
+                invalidate_cache();
+            }
+
+            // Pattern of an assembled matrix, e.g. from a pass that only inserted the near-field pairs
+            template<typename MatrixValueType>
+            void set_pattern(const SparseMatrixWrapper<IndexType, MatrixValueType, cusp::host_memory>& A) {
+                auto& a = A.get_matrix();
+                auto& offsets = A.get_row_offsets();
+                set_pattern(a.num_rows, a.num_cols,
+                            std::vector<IndexType>(offsets.begin(), offsets.end()),
+                            std::vector<IndexType>(a.column_indices.begin(), a.column_indices.end()));
+            }
+
+            // New kernel (e.g. next frequency), cached rows are recomputed at the next product
+            void set_kernel(Kernel kernel) {
+                this->kernel = std::move(kernel);
+                invalidate_cache();
+            }
+
+            // Keeps the values of the rows with the highest cost per stored byte within max_bytes.
+            // The cost of a row defaults to its number of entries, set_row_cost ranks e.g. singular self terms first
+            void set_cache_budget(size_t max_bytes) {
+                cache_budget = max_bytes;
+                invalidate_cache();
+            }
+
+            void set_row_cost(std::vector<double> cost) {
+                row_cost = std::move(cost);
+                invalidate_cache();
+            }
+
+            size_t get_cached_rows() const { return cached_rows; }
+            size_t get_cache_bytes() const { return cache_values.size() * sizeof(ValueType); }
+
+            void invalidate_cache() {
+                cache_valid = false;
+            }
+
+            void SpMV(Vector<ValueType, cusp::host_memory>& x,
+                      Vector<ValueType, cusp::host_memory>& y,
+                      bool transpose = false,
+                      bool conjugate = false) {
+                SpMVP(ValueType(1), x, ValueType(0), y, transpose, conjugate);
+            }
+
+            // y = alpha * A * x + beta * y, the scaling is fused into the row loop
+            void SpMVP(ValueType alpha,
+                       Vector<ValueType, cusp::host_memory>& x,
+                       ValueType beta,
+                       Vector<ValueType, cusp::host_memory>& y,
+                       bool transpose = false,
+                       bool conjugate = false) {
+                const size_t num_y = transpose ? num_cols : num_rows;
+                if(&x == &y)
+                {
+                    Vector<ValueType, cusp::host_memory> temp(x);
+                    SpMVP(alpha, temp, beta, y, transpose, conjugate);
+                    return;
+                }
+                if(beta == ValueType(0)) y.resize(num_y);
+                apply(alpha, thrust::raw_pointer_cast(x.data()), beta, thrust::raw_pointer_cast(y.data()), transpose, conjugate);
+            }
+
+            // Solving Ax = b using GMRES, the products recompute the values
+            ValueType gmres(Vector<ValueType, cusp::host_memory>& x,
+                            Vector<ValueType, cusp::host_memory>& b,
+                            size_t restart = 50,
+                            size_t maxiter = 1000,
+                            Real tol = Real(1e-6),
+                            bool verbose = false)
+            {
+                cusp::monitor<Real> monitor(b, maxiter, tol, 0, verbose);
+                Operator A(*this);
+                cusp::krylov::gmres(A, x, b, restart, monitor);
+                return monitor.residual_norm();
+            }
+
+        private:
+            Kernel kernel;
+            size_t num_rows = 0, num_cols = 0, max_row_entries = 0;
+            std::vector<IndexType> row_offsets, column_indices;
+
+            size_t cache_budget = 0, cached_rows = 0;
+            bool cache_valid = false;
+            std::vector<double> row_cost;
+            std::vector<size_t> cache_offsets; // values of row i at cache_values[cache_offsets[i]], npos when not cached
+            std::vector<ValueType> cache_values;
+            std::vector<ValueType> transpose_workspace; // per-thread partial results of the transpose
+
+            static constexpr size_t npos = std::numeric_limits<size_t>::max();
+            static constexpr bool batched = std::is_invocable_v<const Kernel&, IndexType, const IndexType*, size_t, ValueType*>;
+
+            struct Operator : public cusp::linear_operator<ValueType, cusp::host_memory, IndexType> {
+                NearFieldOperator* A;
+
+                Operator(NearFieldOperator& A)
+                    : cusp::linear_operator<ValueType, cusp::host_memory, IndexType>(A.num_rows, A.num_cols), A(&A) {}
+
+                template<typename Array1, typename Array2>
+                void operator()(const Array1& x, Array2& y) const {
+                    A->apply(ValueType(1), &x[0], ValueType(0), &y[0], false, false);
+                }
+            };
+
+            // Values of row i into out
+            void evaluate_row(size_t i, ValueType* out) const {
+                const IndexType begin = row_offsets[i], n = row_offsets[i + 1] - begin;
+                if constexpr(batched)
+                    kernel((IndexType)i, column_indices.data() + begin, (size_t)n, out);
+                else
+                {
+                    const IndexType* cols = column_indices.data() + begin;
+                    #pragma omp simd
+                    for(IndexType k = 0; k < n; k++)
+                        out[k] = kernel((IndexType)i, cols[k]);
+                }
+            }
+
+            // Picks the cached rows greedily by cost density and evaluates them once
+            void build_cache() {
+                cache_valid = true;
+                cached_rows = 0;
+                cache_offsets.assign(num_rows, npos);
+                cache_values.clear();
+                const size_t budget = cache_budget / sizeof(ValueType);
+                if(budget == 0) return;
+
+                std::vector<IndexType> order;
+                for(size_t i = 0; i < num_rows; i++)
+                    if(row_offsets[i + 1] > row_offsets[i]) order.push_back((IndexType)i);
+                auto density = [&](IndexType i) { return row_cost.size() == num_rows ? row_cost[i] / (row_offsets[i + 1] - row_offsets[i]) : 1.0; };
+                std::stable_sort(order.begin(), order.end(), [&](IndexType a, IndexType b) { return density(a) > density(b); });
+                size_t used = 0;
+                for(IndexType i : order)
+                {
+                    const size_t n = row_offsets[i + 1] - row_offsets[i];
+                    if(used + n > budget) continue;
+                    cache_offsets[i] = used;
+                    used += n;
+                    cached_rows++;
+                }
+                cache_values.resize(used);
+                #pragma omp parallel for schedule(dynamic, 64)
+                for(long long i = 0; i < (long long)num_rows; i++)
+                    if(cache_offsets[i] != npos) evaluate_row(i, cache_values.data() + cache_offsets[i]);
+            }
+
+            // y = alpha * op(A) * x + beta * y on raw arrays, x and y distinct
+            void apply(ValueType alpha, const ValueType* x, ValueType beta, ValueType* y, bool transpose, bool conjugate) {
+                if(!cache_valid) build_cache();
+                if(!transpose)
+                {
+                    #pragma omp parallel
+                    {
+                        std::vector<ValueType> buffer(max_row_entries);
+                        #pragma omp for schedule(dynamic, 64)
+                        for(long long i = 0; i < (long long)num_rows; i++)
+                        {
+                            const IndexType begin = row_offsets[i], end = row_offsets[i + 1];
+                            const ValueType* values = cache_offsets[i] != npos ? cache_values.data() + cache_offsets[i] : buffer.data();
+                            if(values == buffer.data()) evaluate_row(i, buffer.data());
+                            ValueType sum(0);
+                            for(IndexType k = begin; k < end; k++)
+                                sum += detail::transpose_value(values[k - begin], conjugate) * x[column_indices[k]];
+                            y[i] = beta == ValueType(0) ? alpha * sum : alpha * sum + beta * y[i];
+                        }
+                    }
+                    return;
+                }
+
+                // Rows scatter into y: per-thread partial results, summed column-wise in parallel
+                const int threads = omp_get_max_threads();
+                transpose_workspace.assign((size_t)threads * num_cols, ValueType(0));
+                int team = 1;
+                #pragma omp parallel num_threads(threads)
+                {
+                    #pragma omp single
+                    team = omp_get_num_threads();
+                    ValueType* partial = transpose_workspace.data() + (size_t)omp_get_thread_num() * num_cols;
+                    std::vector<ValueType> buffer(max_row_entries);
+                    #pragma omp for schedule(dynamic, 64)
+                    for(long long i = 0; i < (long long)num_rows; i++)
+                    {
+                        const IndexType begin = row_offsets[i], end = row_offsets[i + 1];
+                        const ValueType* values = cache_offsets[i] != npos ? cache_values.data() + cache_offsets[i] : buffer.data();
+                        if(values == buffer.data()) evaluate_row(i, buffer.data());
+                        for(IndexType k = begin; k < end; k++)
+                            partial[column_indices[k]] += detail::transpose_value(values[k - begin], conjugate) * x[i];
+                    }
+                    #pragma omp for schedule(static)
+                    for(long long j = 0; j < (long long)num_cols; j++)
+                    {
+                        ValueType sum(0);
+                        for(int t = 0; t < team; t++) sum += transpose_workspace[(size_t)t * num_cols + j];
+                        y[j] = beta == ValueType(0) ? alpha * sum : alpha * sum + beta * y[j];
+                    }
+                }
+            }
+    };
+
+}
@@ -1,11 +1,158 @@
 #pragma once
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
 #include "complex_bessel.h"
 
 namespace puff
 {
 	static constexpr double M_PI_ = 3.14159265358979323846264338327950288419716939937510L; // pi
 
+	// Floquet mode propagation constant Kzmn = sqrt(K0^2 - Kxm^2 - Kyn^2)
+	// Branch is chosen with Im(Kzmn) <= 0 so evanescent modes decay away from the lattice plane
+	template<typename T>
+	std::complex<T> __Floquet_Kzmn__(std::complex<T> Kxm, std::complex<T> Kyn, std::complex<T> K0)
+	{
+		auto Kzmn = std::sqrt(K0 * K0 - Kxm * Kxm - Kyn * Kyn);
+		if(Kzmn.imag() > 0)
+		{
+			Kzmn = -Kzmn;
+		}
+		return Kzmn;
+	}
+
+	// Modes with |Kzmn| max(Lx, Ly) < 1 are close to grazing (Wood's anomaly) and get special treatment
+	template<typename T>
+	bool __Floquet_grazing__(std::complex<T> Kzmn, T Lx, T Ly)
+	{
+		return std::abs(Kzmn) * std::max(Lx, Ly) < 1;
+	}
+
+	// Mode truncation of the spectral PGF series at height z, evanescent modes decay like exp(-2 pi |m| |z| / L)
+	template<typename T>
+	int __Floquet_truncation__(T Lx, T Ly, T z, double epsilon)
+	{
+		return (int)std::sqrt(Lx * Ly * std::log(1 / epsilon) * std::log(1 / epsilon) / (4 * M_PI_ * M_PI_ * z * z));
+	}
+
+	// Grazing modes (m, n) outside the truncation window [-M, M]^2. The series adds them on their own, so a
+	// Wood's anomaly beyond the window is still treated analytically without widening the window for all modes
+	template<typename T>
+	std::vector<std::pair<int, int>> __Floquet_grazing_modes__(T Lx, T Ly, std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0, int M)
+	{
+		std::vector<std::pair<int, int>> modes;
+		// |K0^2 - Kxm^2 - Kyn^2| < 1 / max(Lx, Ly)^2 bounds Re(Kxm)^2 + Re(Kyn)^2 by R^2
+		const T L = std::max(Lx, Ly);
+		const T R = std::sqrt(std::norm(K0) + 1 / (L * L) + Kx.imag() * Kx.imag() + Ky.imag() * Ky.imag());
+		const int Mx = (int)std::ceil((R + std::abs(Kx.real())) * Lx / (2 * M_PI_));
+		const int Ny = (int)std::ceil((R + std::abs(Ky.real())) * Ly / (2 * M_PI_));
+		if(Mx <= M && Ny <= M)
+		{
+			return modes;
+		}
+		for(int m = -Mx; m <= Mx; m++)
+		{
+			for(int n = -Ny; n <= Ny; n++)
+			{
+				if(std::abs(m) <= M && std::abs(n) <= M) continue;
+				auto Kzmn = __Floquet_Kzmn__<T>(Kx + T(2 * M_PI_ * m / Lx), Ky + T(2 * M_PI_ * n / Ly), K0);
+				if(__Floquet_grazing__<T>(Kzmn, Lx, Ly)) modes.emplace_back(m, n);
+			}
+		}
+		return modes;
+	}
+
+	// (exp(-i a) - 1) / a without cancellation, Taylor series -i sum_k (-i a)^k / (k + 1)! for small |a|
+	template<typename T>
+	std::complex<T> __expm1i_over__(std::complex<T> a)
+	{
+		if(std::abs(a) > 0.5)
+		{
+			return (std::exp(std::complex<T>(0, -1) * a) - T(1)) / a;
+		}
+		std::complex<T> term(0, -1), sum(0, 0);
+		for(int k = 1; k <= 24; k++)
+		{
+			sum += term;
+			term *= std::complex<T>(0, -1) * a / T(k + 1);
+			if(std::abs(term) <= std::numeric_limits<T>::epsilon() * std::abs(sum)) break;
+		}
+		return sum;
+	}
+
+	// z-bracket of the triply periodic series divided by Kzmn,
+	// (exp(-i Kzmn |z|) + exp(-i (Kzmn - Kz) Lz - i Kzmn z) / (1 - exp(-i (Kzmn - Kz) Lz))
+	//                   + exp(-i (Kzmn + Kz) Lz + i Kzmn z) / (1 - exp(-i (Kzmn + Kz) Lz))) / Kzmn
+	// The bracket vanishes at Kzmn = 0, so near grazing every term is written as its difference to the
+	// Kzmn = 0 value, which is an exact multiple of Kzmn through (exp(-i a) - 1) / a.
+	// That expansion divides by 1 - exp(+-i Kz Lz), which vanishes when Kz Lz is a multiple of 2 pi (e.g. at
+	// the Gamma point). The bracket then has a genuine pole at Kzmn = 0 and nothing cancels, so the direct
+	// formula is used whenever |1 - exp(+-i Kz Lz)| is not larger than |Kzmn| Lz
+	template<typename T>
+	std::complex<T> __3D_PGF_bracket__(std::complex<T> Kzmn, std::complex<T> Kz, T z, T Lz)
+	{
+		const std::complex<T> I(0, 1);
+		auto w0 = std::exp(I * Kz * Lz), w0c = std::exp(-I * Kz * Lz);
+		const T a = std::abs(Kzmn) * Lz;
+		if(std::abs(Kzmn) * std::max(Lz, std::abs(z)) >= 1 || std::abs(T(1) - w0) <= a || std::abs(T(1) - w0c) <= a)
+		{
+			auto term1 = std::exp(-I * Kzmn * std::abs(z));
+			auto term2 = std::exp(-I * (Kzmn - Kz) * Lz) * std::exp(-I * Kzmn * z) / (T(1) - std::exp(-I * (Kzmn - Kz) * Lz));
+			auto term3 = std::exp(-I * (Kzmn + Kz) * Lz) * std::exp(I * Kzmn * z) / (T(1) - std::exp(-I * (Kzmn + Kz) * Lz));
+			return (term1 + term2 + term3) / Kzmn;
+		}
+		auto shift = std::exp(-I * Kzmn * Lz);
+		auto w = w0 * shift, wc = w0c * shift;
+		auto phi_L = __expm1i_over__<T>(Kzmn * Lz);
+		auto d1 = std::abs(z) * __expm1i_over__<T>(Kzmn * std::abs(z));
+		auto d2 = std::exp(-I * Kzmn * z) * w0 * Lz * phi_L / ((T(1) - w) * (T(1) - w0)) + w0 / (T(1) - w0) * z * __expm1i_over__<T>(Kzmn * z);
+		auto d3 = std::exp(I * Kzmn * z) * w0c * Lz * phi_L / ((T(1) - wc) * (T(1) - w0c)) - w0c / (T(1) - w0c) * z * __expm1i_over__<T>(-Kzmn * z);
+		return d1 + d2 + d3;
+	}
+
+	// Real K0 in [K0_min, K0_max] where a Floquet mode grazes the lattice plane (Kzmn = 0), the Wood's anomalies
+	// The Bloch wavenumbers may follow the frequency for a fixed incidence direction: Kx + sx * K0, Ky + sy * K0
+	template<typename T>
+	std::vector<T> __Floquet_Wood_anomalies__(T Lx, T Ly, T Kx, T Ky, T K0_min, T K0_max, T sx = 0, T sy = 0)
+	{
+		std::vector<T> anomalies;
+		int M = (int)std::ceil((std::abs(Kx) + (1 + std::abs(sx)) * K0_max) * Lx / (2 * M_PI_));
+		int N = (int)std::ceil((std::abs(Ky) + (1 + std::abs(sy)) * K0_max) * Ly / (2 * M_PI_));
+		for(int m = -M; m <= M; m++)
+		{
+			T ax = Kx + 2 * M_PI_ * m / Lx;
+			for(int n = -N; n <= N; n++)
+			{
+				T ay = Ky + 2 * M_PI_ * n / Ly;
+				// (ax + sx K0)^2 + (ay + sy K0)^2 = K0^2
+				T a = sx * sx + sy * sy - 1, b = 2 * (sx * ax + sy * ay), c = ax * ax + ay * ay;
+				T roots[2];
+				int count = 0;
+				if(std::abs(a) < 1e-14)
+				{
+					if(std::abs(b) > 0) roots[count++] = -c / b;
+				}
+				else
+				{
+					T disc = b * b - 4 * a * c;
+					if(disc >= 0)
+					{
+						// Cancellation-free pair of roots
+						T q = -(b + std::copysign(std::sqrt(disc), b)) / 2;
+						if(q != 0) roots[count++] = c / q;
+						roots[count++] = q / a;
+					}
+				}
+				for(int r = 0; r < count; r++)
+					if(roots[r] >= K0_min && roots[r] <= K0_max) anomalies.push_back(roots[r]);
+			}
+		}
+		std::sort(anomalies.begin(), anomalies.end());
+		anomalies.erase(std::unique(anomalies.begin(), anomalies.end(), [&](T u, T v) { return std::abs(u - v) <= 1e-12 * std::max(T(1), std::abs(u)); }), anomalies.end());
+		return anomalies;
+	}
+
 	template<typename T>
 	T __1D_LGF__(T x, T y, T z, T Lx, double epi = 1e-10)
 	{
@@ -170,8 +317,11 @@ namespace puff
 		return sum * const_part;
 	}
 
+	// __2D_PGF__ with the poles of the grazing modes split off: singular receives exp(-i(Kxm x + Kyn y)) / (2i Kzmn Lx Ly)
+	// of every grazing mode, the returned remainder uses exp(-i Kzmn |z|) - 1 = Kzmn |z| (exp(-i a) - 1) / a for
+	// those modes and stays bounded across the Wood's anomaly. The sum of both is __2D_PGF__.
 	template<typename T>
-	std::complex<T> __2D_PGF__(T x, T y, T z, T Lx, T Ly, T Lz, std::complex<T> Kx, std::complex<T> Ky, std::complex<T> Kz, std::complex<T> K0, double epi = 1e-10)
+	std::complex<T> __2D_PGF_split__(T x, T y, T z, T Lx, T Ly, T Lz, std::complex<T> Kx, std::complex<T> Ky, std::complex<T> Kz, std::complex<T> K0, std::complex<T>& singular, double epi = 1e-10)
 	{	
 		// Assume Lx, Ly are periodic directions
 		// if not, swap
@@ -188,28 +338,48 @@ namespace puff
 			std::swap(Ky, Kz);
 		}
 		double epsilon = epi / std::min(Lx, Ly);
-		int M = (int)std::sqrt(Lx * Ly * std::log(1 / epsilon) * std::log(1 / epsilon) / (4 * M_PI_ * M_PI_ * z * z));
+		int M = __Floquet_truncation__<T>(Lx, Ly, z, epsilon);
 		int N = M;
 		std::complex<T> sum = std::complex<T>(0, 0);
-		for(int m = -M; m <= M; m++)
+		singular = std::complex<T>(0, 0);
+		auto add_mode = [&](int m, int n)
 		{
 			auto Kxm = Kx + 2 * M_PI_ * m / Lx;
+			auto Kyn = Ky + 2 * M_PI_ * n / Ly;
+			auto Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+			if(__Floquet_grazing__<T>(Kzmn, Lx, Ly))
+			{
+				auto lattice_part = std::exp(std::complex<T>(0, -1) * (Kxm * x + Kyn * y)) / (2.0 * std::complex<T>(0, 1) * Lx * Ly);
+				singular += lattice_part / Kzmn;
+				sum += lattice_part * std::abs(z) * __expm1i_over__<T>(Kzmn * std::abs(z));
+				return;
+			}
+			auto denominator = 2.0 * std::complex<T>(0, 1) * Kzmn * Lx * Ly;
+			auto exp_part = std::exp(std::complex<T>(0, -1) * (Kxm * x + Kyn * y + Kzmn * std::abs(z)));
+			sum += exp_part / denominator;
+		};
+		for(int m = -M; m <= M; m++)
+		{
 			for(int n = -N; n <= N; n++)
 			{
-				auto Kyn = Ky + 2 * M_PI_ * n / Ly;
-				auto Kzmn = std::sqrt(K0 * K0 - Kxm * Kxm - Kyn * Kyn);
-				if(Kzmn.imag() > 0)
-				{
-					Kzmn = -Kzmn;
-				}
-				auto denominator = 2.0 * std::complex<T>(0, 1) * Kzmn * Lx * Ly;
-				auto exp_part = std::exp(std::complex<T>(0, -1) * (Kxm * x + Kyn * y + Kzmn * std::abs(z)));
-				sum += exp_part / denominator;
+				add_mode(m, n);
 			}
 		}
+		for(auto [m, n] : __Floquet_grazing_modes__<T>(Lx, Ly, Kx, Ky, K0, M))
+		{
+			add_mode(m, n);
+		}
 		return sum;
 	}
 
+	template<typename T>
+	std::complex<T> __2D_PGF__(T x, T y, T z, T Lx, T Ly, T Lz, std::complex<T> Kx, std::complex<T> Ky, std::complex<T> Kz, std::complex<T> K0, double epi = 1e-10)
+	{
+		std::complex<T> singular;
+		auto regular = __2D_PGF_split__<T>(x, y, z, Lx, Ly, Lz, Kx, Ky, Kz, K0, singular, epi);
+		return regular + singular;
+	}
+
 	template<typename T>
 	std::complex<T> __3D_PGF__(T x, T y, T z, T Lx, T Ly, T Lz, std::complex<T> Kx, std::complex<T> Ky, std::complex<T> Kz, std::complex<T> K0, double epi = 1e-10)
 	{
@@ -228,33 +398,29 @@ namespace puff
 			std::swap(Ly, Lz);
 		}
 		double epsilon = epi / std::min(Lx, std::min(Ly, Lz));
-		int M = (int)std::sqrt(Lx * Ly * std::log(1 / epsilon) * std::log(1 / epsilon) / (4 * M_PI_ * M_PI_ * z * z));
+		int M = __Floquet_truncation__<T>(Lx, Ly, z, epsilon);
 		int N = M;
 		std::complex<T> sum = std::complex<T>(0, 0);
-		for(int m = -M; m <= M; m++)
+		auto add_mode = [&](int m, int n)
 		{
 			auto Kxm = Kx + 2 * M_PI_ * m / Lx;
+			auto Kyn = Ky + 2 * M_PI_ * n / Ly;
+			auto Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+			// The 1 / Kzmn pole cancels against the bracket, see __3D_PGF_bracket__
+			auto exp_part1 = std::exp(std::complex<T>(0, -1) * (Kxm * x + Kyn * y));
+			sum += exp_part1 / (2.0 * std::complex<T>(0, 1) * Lx * Ly) * __3D_PGF_bracket__<T>(Kzmn, Kz, z, Lz);
+		};
+		for(int m = -M; m <= M; m++)
+		{
 			for(int n = -N; n <= N; n++)
 			{
-				auto Kyn = Ky + 2 * M_PI_ * n / Ly;
-				auto Kzmn = std::sqrt(K0 * K0 - Kxm * Kxm - Kyn * Kyn);
-				if(Kzmn.imag() > 0)
-				{
-					Kzmn = -Kzmn;
-				}
-				auto denominator1 = 2.0 * std::complex<T>(0, 1) * Kzmn * Lx * Ly;
-				auto exp_part1 = std::exp(std::complex<T>(0, -1) * (Kxm * x + Kyn * y));
-				auto outside_braket = exp_part1 / denominator1;
-				auto term1 = std::exp(std::complex<T>(0, -1) * Kzmn * std::abs(z));
-				auto term2_deniminator = 1. - std::exp(std::complex<T>(0, -1) * (Kzmn - Kz) * Lz);
-				auto term2_exp = std::exp(std::complex<T>(0, -1) * (Kzmn - Kz) * Lz) * std::exp(std::complex<T>(0, -1) * Kzmn * z);
-				auto term2 = term2_exp / term2_deniminator;
-				auto term3_deniminator = 1. - std::exp(std::complex<T>(0, -1) * (Kzmn + Kz) * Lz);
-				auto term3_exp = std::exp(std::complex<T>(0, -1) * (Kzmn + Kz) * Lz) * std::exp(std::complex<T>(0, 1) * Kzmn * z);
-				auto term3 = term3_exp / term3_deniminator;
-				sum += outside_braket * (term1 + term2 + term3);
+				add_mode(m, n);
 			}
 		}
+		for(auto [m, n] : __Floquet_grazing_modes__<T>(Lx, Ly, Kx, Ky, K0, M))
+		{
+			add_mode(m, n);
+		}
 		return sum;
 	}
 } // namespace puff
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "utils.h"
+#include "mkl.h"
+#include "mkl_pardiso.h"
+
+namespace puff {
+
+    // Structure handed to PARDISO. Symmetric means A = A^T (complex symmetric, mtype 6, or real symmetric
+    // indefinite, mtype -2) and only the upper triangle is factored, Unsymmetric is mtype 13 / 11
+    enum class PardisoMatrixType {
+        Unsymmetric,
+        Symmetric
+    };
+
+    // Statistics of the last analysis / factorization (iparm outputs)
+    struct PardisoReport {
+        size_t factor_entries = 0;   // nonzeros of the LU factors, iparm[17]
+        size_t peak_memory_kb = 0;   // max of the analysis and factorization peaks, iparm[14..16]
+        size_t perturbed_pivots = 0; // iparm[13], nonzero means the factorization was regularized
+        size_t refinement_steps = 0; // iterative refinement steps of the last solve, iparm[6]
+    };
+
+    // PARDISO direct solver over a sorted zero-based CSR pattern, double / float / dcomplex / fcomplex.
+    // The phases run separately: analyze (11, reordering and symbolic factorization) once per pattern,
+    // factor (22) once per value set and solve (33) for any number of right-hand sides.
+    // Pattern and values are copied, the caller arrays may change between the phases
+    template<typename ValueType, typename IndexType = INDEX_TYPE>
+    class PardisoSolver {
+        public:
+            static constexpr bool supported = std::is_same_v<ValueType, double> || std::is_same_v<ValueType, float> ||
+                                              std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>;
+
+            PardisoSolver() {}
+            ~PardisoSolver() { reset(); }
+            PardisoSolver(const PardisoSolver&) = delete;
+            PardisoSolver& operator=(const PardisoSolver&) = delete;
+
+            bool analyzed() const { return is_analyzed; }
+            bool factored() const { return is_factored; }
+            PardisoMatrixType get_type() const { return type; }
+            const PardisoReport& get_report() const { return report; }
+
+            // True when the pattern and type are those of the last analysis, i.e. phase 11 can be skipped
+            bool matches(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices, PardisoMatrixType type) const {
+                if(!is_analyzed || type != this->type || num_rows != n || (size_t)row_offsets[num_rows] != source_indices.size())
+                    return false;
+                return std::equal(row_offsets, row_offsets + num_rows + 1, source_offsets.begin()) &&
+                       std::equal(column_indices, column_indices + source_indices.size(), source_indices.begin());
+            }
+
+            // Phase 11 on a square matrix. Symmetric keeps the upper triangle and adds the missing diagonal
+            // entries PARDISO requires. The values are needed as well: the default scaling and weighted
+            // matching of the unsymmetric types (iparm[10], iparm[12]) are computed during the analysis
+            void analyze(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                         const ValueType* matrix_values, PardisoMatrixType type) {
+                static_assert(supported, "PARDISO supports double, float, dcomplex and fcomplex");
+                static_assert(sizeof(IndexType) == sizeof(MKL_INT), "CSR indices must match MKL_INT (LP64: 32-bit)");
+                reset();
+                this->type = type;
+                n = num_rows;
+                source_offsets.assign(row_offsets, row_offsets + num_rows + 1);
+                source_indices.assign(column_indices, column_indices + row_offsets[num_rows]);
+
+                offsets.clear();
+                indices.clear();
+                value_map.clear();
+                if(type == PardisoMatrixType::Symmetric)
+                {
+                    offsets.reserve(num_rows + 1);
+                    offsets.push_back(0);
+                    for(size_t i = 0; i < num_rows; i++)
+                    {
+                        const IndexType* begin = column_indices + row_offsets[i];
+                        const IndexType* end = column_indices + row_offsets[i + 1];
+                        const IndexType* c = std::lower_bound(begin, end, (IndexType)i);
+                        if(c == end || *c != (IndexType)i)
+                        {
+                            indices.push_back((MKL_INT)i);
+                            value_map.push_back(npos);
+                        }
+                        for(; c != end; c++)
+                        {
+                            indices.push_back((MKL_INT)*c);
+                            value_map.push_back(c - column_indices);
+                        }
+                        offsets.push_back((MKL_INT)indices.size());
+                    }
+                }
+                values.resize(type == PardisoMatrixType::Symmetric ? indices.size() : source_indices.size());
+                load_values(matrix_values);
+
+                mtype = matrix_type(type);
+                pardisoinit(pt, &mtype, iparm);
+                iparm[0] = 1;   // iparm set explicitly
+                iparm[34] = 1;  // zero-based indices
+                if constexpr(std::is_same_v<ValueType, float> || std::is_same_v<ValueType, fcomplex>)
+                    iparm[27] = 1; // single precision
+                run(11, 1, nullptr, nullptr);
+                is_analyzed = true;
+                report = PardisoReport();
+                report.peak_memory_kb = (size_t)iparm[14];
+            }
+
+            // Phase 22 on the values of the analyzed pattern (ordered like its column_indices)
+            void factor(const ValueType* matrix_values) {
+                assert(is_analyzed);
+                load_values(matrix_values);
+                run(22, 1, nullptr, nullptr);
+                is_factored = true;
+                report.factor_entries = (size_t)iparm[17];
+                report.peak_memory_kb = std::max<size_t>(report.peak_memory_kb, (size_t)iparm[15] + (size_t)iparm[16]);
+                report.perturbed_pivots = (size_t)iparm[13];
+            }
+
+            // Phase 33: X = A^{-1} B, nrhs column-major columns of length num_rows. b and x must not alias
+            void solve(const ValueType* b, ValueType* x, size_t nrhs = 1) {
+                assert(is_factored && b != x);
+                run(33, nrhs, const_cast<ValueType*>(b), x);
+                report.refinement_steps = (size_t)iparm[6];
+            }
+
+            // New values on the same pattern, the next solve refactors
+            void invalidate_values() {
+                is_factored = false;
+            }
+
+            // Phase -1, releases all PARDISO memory
+            void reset() {
+                if(is_analyzed)
+                    run(-1, 1, nullptr, nullptr);
+                is_analyzed = false;
+                is_factored = false;
+            }
+
+        private:
+            static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+            void* pt[64] = {};
+            MKL_INT iparm[64] = {};
+            MKL_INT mtype = 11;
+            PardisoMatrixType type = PardisoMatrixType::Unsymmetric;
+            size_t n = 0;
+            bool is_analyzed = false, is_factored = false;
+            PardisoReport report;
+
+            std::vector<IndexType> source_offsets, source_indices; // pattern of the analysis
+            std::vector<MKL_INT> offsets, indices;                 // upper triangle (Symmetric only)
+            std::vector<size_t> value_map;                         // source entry of each upper triangle entry, npos for an added diagonal
+            std::vector<ValueType> values;
+
+            static MKL_INT matrix_type(PardisoMatrixType type) {
+                constexpr bool complex = std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>;
+                if(type == PardisoMatrixType::Symmetric) return complex ? 6 : -2;
+                return complex ? 13 : 11;
+            }
+
+            // Values of the source pattern into the layout handed to PARDISO
+            void load_values(const ValueType* matrix_values) {
+                if(type == PardisoMatrixType::Symmetric)
+                {
+                    #pragma omp parallel for schedule(static)
+                    for(long long k = 0; k < (long long)values.size(); k++)
+                        values[k] = value_map[k] == npos ? ValueType(0) : matrix_values[value_map[k]];
+                }
+                else
+                    std::copy(matrix_values, matrix_values + values.size(), values.begin());
+            }
+
+            void run(MKL_INT phase, size_t nrhs, ValueType* b, ValueType* x) {
+                const bool symmetric = type == PardisoMatrixType::Symmetric;
+                const MKL_INT* ia = symmetric ? offsets.data() : reinterpret_cast<const MKL_INT*>(source_offsets.data());
+                const MKL_INT* ja = symmetric ? indices.data() : reinterpret_cast<const MKL_INT*>(source_indices.data());
+                const MKL_INT maxfct = 1, mnum = 1, msglvl = 0, size = (MKL_INT)n, rhs = (MKL_INT)nrhs;
+                MKL_INT error = 0;
+                pardiso(pt, &maxfct, &mnum, &mtype, &phase, &size, values.data(), ia, ja, nullptr, &rhs, iparm, &msglvl, b, x, &error);
+                CHECK_PARDISO(error)
+            }
+    };
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "utils.h"
+#include <atomic>
+#include <memory>
+
+namespace puff {
+
+    // Insertion buffer for a known sparsity pattern: each row owns a slab sized from the hint, so entries
+    // arrive bucketed by row (a counting sort done at insertion time) and make_matrix only sorts inside rows.
+    // A row is guarded by a one byte flag, threads filling different rows never wait on each other.
+    // assign() returns false for rows outside the hint or full slabs; slabs never shrink, so a key refused
+    // once is always refused and can live in another container without duplicates.
+    template<typename IndexType, typename ValueType>
+    class RowBuckets {
+        public:
+            // capacity[i] entries for row i, not thread safe
+            void reserve(const std::vector<size_t>& capacity) {
+                if(capacity.empty())
+                {
+                    clear();
+                    return;
+                }
+                offsets.assign(capacity.size() + 1, 0);
+                for(size_t i = 0; i < capacity.size(); i++) offsets[i + 1] = offsets[i] + capacity[i];
+                counts.assign(capacity.size(), 0);
+                locks.reset(capacity.empty() ? nullptr : new std::atomic<uint8_t>[capacity.size()]);
+                for(size_t i = 0; i < capacity.size(); i++) locks[i].store(0, std::memory_order_relaxed);
+                columns.resize(offsets.back());
+                values.resize(offsets.back());
+            }
+
+            // Empties the slabs but keeps their capacities, not thread safe
+            void reset() {
+                std::fill(counts.begin(), counts.end(), IndexType(0));
+            }
+
+            void clear() {
+                std::vector<size_t>().swap(offsets);
+                std::vector<IndexType>().swap(counts);
+                std::vector<IndexType>().swap(columns);
+                std::vector<ValueType>().swap(values);
+                locks.reset();
+            }
+
+            size_t num_rows() const { return counts.size(); }
+            size_t capacity() const { return columns.size(); }
+
+            size_t size() const {
+                size_t total = 0;
+                #pragma omp parallel for schedule(static) reduction(+:total)
+                for(long long i = 0; i < (long long)counts.size(); i++) total += counts[i];
+                return total;
+            }
+
+            // (row, col) -> value, overwriting an existing value
+            bool assign(IndexType row, IndexType col, const ValueType& value) { return set(row, col, value, true); }
+
+            // Overwrites the value of (row, col) if present
+            bool update(IndexType row, IndexType col, const ValueType& value) { return set(row, col, value, false); }
+
+            // f(row, col, value) for every stored entry, serial
+            template<typename F>
+            void for_each(F f) const {
+                for(size_t i = 0; i < counts.size(); i++)
+                    for(size_t k = offsets[i]; k < offsets[i] + counts[i]; k++) f((IndexType)i, columns[k], values[k]);
+            }
+
+            // Entries satisfying keep(value) as packed (row << 32) + col keys in ascending order,
+            // rows are independent so only each row is sorted. Returns the number of entries written
+            template<typename Keep>
+            size_t extract_sorted(uint64_t* out_keys, ValueType* out_values, Keep keep) const {
+                const size_t rows = counts.size();
+                std::vector<size_t> start(rows + 1, 0);
+                #pragma omp parallel for schedule(static)
+                for(long long i = 0; i < (long long)rows; i++)
+                {
+                    size_t kept = 0;
+                    for(size_t k = offsets[i]; k < offsets[i] + counts[i]; k++) kept += keep(values[k]);
+                    start[i + 1] = kept;
+                }
+                for(size_t i = 0; i < rows; i++) start[i + 1] += start[i];
+
+                #pragma omp parallel
+                {
+                    std::vector<std::pair<IndexType, ValueType>> row;
+                    #pragma omp for schedule(dynamic, 256)
+                    for(long long i = 0; i < (long long)rows; i++)
+                    {
+                        row.clear();
+                        for(size_t k = offsets[i]; k < offsets[i] + counts[i]; k++)
+                            if(keep(values[k])) row.emplace_back(columns[k], values[k]);
+                        std::sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                        size_t position = start[i];
+                        for(auto& [col, value] : row)
+                        {
+                            out_keys[position] = ((uint64_t)i << 32) + col;
+                            out_values[position] = value;
+                            position++;
+                        }
+                    }
+                }
+                return start[rows];
+            }
+
+        private:
+            std::vector<size_t> offsets;  // slab of row i is [offsets[i], offsets[i + 1])
+            std::vector<IndexType> counts; // entries stored in each slab
+            std::vector<IndexType> columns;
+            std::vector<ValueType> values;
+            std::unique_ptr<std::atomic<uint8_t>[]> locks;
+
+            bool set(IndexType row, IndexType col, const ValueType& value, bool insert) {
+                if((size_t)row >= counts.size()) return false;
+                uint8_t expected = 0;
+                while(!locks[row].compare_exchange_weak(expected, 1, std::memory_order_acquire)) expected = 0;
+                const size_t begin = offsets[row], end = begin + counts[row];
+                bool stored = false;
+                for(size_t k = begin; k < end && !stored; k++)
+                    if(columns[k] == col)
+                    {
+                        values[k] = value;
+                        stored = true;
+                    }
+                if(!stored && insert && end < offsets[row + 1])
+                {
+                    columns[end] = col;
+                    values[end] = value;
+                    counts[row]++;
+                    stored = true;
+                }
+                locks[row].store(0, std::memory_order_release);
+                return stored;
+            }
+    };
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "utils.h"
+#include "SpMVKernels.h"
+#include <stdexcept>
+
+namespace puff {
+
+    // Per-thread accumulator of the row-wise (Gustavson) products
+    enum class SpGEMMAccumulator {
+        Auto,  // picked by the symbolic phase from the number of columns and products
+        Dense, // array over all columns of C, reset through the row pattern
+        Hash   // open addressing table sized from the products of the row
+    };
+
+    // Symbolic phase of C = A B or C = P^T A P: the sorted CSR pattern of C. The numeric phase only
+    // fills values, so a plan is reused as long as the input patterns do not change (e.g. frequency sweeps).
+    // The plan records a fingerprint of each input pattern to tell when it is stale
+    template<typename IndexType>
+    struct SpGEMMPlan {
+        SpGEMMAccumulator accumulator = SpGEMMAccumulator::Auto;
+        size_t num_rows = 0, num_cols = 0;
+        std::vector<IndexType> row_offsets;
+        std::vector<IndexType> column_indices;
+        // Triple product only: CSR pattern of P^T and the entry of P behind each of its entries
+        std::vector<IndexType> transpose_offsets, transpose_indices, transpose_permutation;
+        std::pair<uint64_t, uint64_t> input_patterns{0, 0}; // CSR_pattern_fingerprint of the two inputs
+
+        size_t num_entries() const { return column_indices.size(); }
+        bool empty() const { return row_offsets.empty(); }
+    };
+
+    // Order-sensitive 64-bit hash of the rows and columns of a CSR pattern, one parallel pass over the entries
+    template<typename IndexType>
+    uint64_t CSR_pattern_fingerprint(size_t num_rows, const IndexType* offsets, const IndexType* indices);
+
+    // Pattern of C = A B, A is num_rows x num_inner and B is num_inner x num_cols (sorted CSR)
+    template<typename ValueType, typename IndexType>
+    SpGEMMPlan<IndexType> SpGEMM_symbolic(size_t num_rows,
+                                          size_t num_inner,
+                                          size_t num_cols,
+                                          const IndexType* a_offsets,
+                                          const IndexType* a_indices,
+                                          const IndexType* b_offsets,
+                                          const IndexType* b_indices,
+                                          SpGEMMAccumulator accumulator = SpGEMMAccumulator::Auto);
+
+    // Values of C = A B on the pattern of plan, rows in parallel. Cancelled entries stay as explicit zeros.
+    // A and B must have the patterns plan was built from (compare plan.input_patterns), otherwise products
+    // outside the pattern of C are lost
+    template<typename ValueType, typename IndexType>
+    void SpGEMM_numeric(const SpGEMMPlan<IndexType>& plan,
+                        const IndexType* a_offsets,
+                        const IndexType* a_indices,
+                        const ValueType* a_values,
+                        const IndexType* b_offsets,
+                        const IndexType* b_indices,
+                        const ValueType* b_values,
+                        ValueType* c_values);
+
+    // Pattern of C = P^T A P, P is num_rows x num_cols and A is num_rows x num_rows.
+    // Fused: row j of C walks P^T(j, :) -> A -> P without forming A P, so no intermediate matrix is stored
+    template<typename ValueType, typename IndexType>
+    SpGEMMPlan<IndexType> Triple_product_symbolic(size_t num_rows,
+                                                  size_t num_cols,
+                                                  const IndexType* p_offsets,
+                                                  const IndexType* p_indices,
+                                                  const IndexType* a_offsets,
+                                                  const IndexType* a_indices,
+                                                  SpGEMMAccumulator accumulator = SpGEMMAccumulator::Auto);
+
+    // Values of C = P^T A P (P^H A P when conjugate) on the pattern of plan, P and A as for SpGEMM_numeric
+    template<typename ValueType, typename IndexType>
+    void Triple_product_numeric(const SpGEMMPlan<IndexType>& plan,
+                                const IndexType* p_offsets,
+                                const IndexType* p_indices,
+                                const ValueType* p_values,
+                                const IndexType* a_offsets,
+                                const IndexType* a_indices,
+                                const ValueType* a_values,
+                                ValueType* c_values,
+                                bool conjugate = false);
+
+}
+
+#include "details/SpGEMM.inl"
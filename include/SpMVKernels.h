@@ -0,0 +1,112 @@
+#pragma once
+
+#include "utils.h"
+
+namespace puff {
+
+    // Product path of the host SparseMatrixWrapper::SpMV
+    enum class SpMVBackend {
+        Generic, // cusp::multiply on the COO matrix (thrust backend)
+        SIMD,    // hand-written CSR kernels, instruction set picked at runtime
+        MKL      // MKL inspector-executor handle built at make_matrix (double / float / dcomplex / fcomplex)
+    };
+
+    const char* SpMV_backend_name(SpMVBackend backend);
+
+    // Instruction set of the hand-written host kernels, ordered by capability
+    enum class SpMVIsa {
+        Scalar,
+        AVX2,   // AVX2 + FMA + F16C
+        AVX512  // AVX-512F
+    };
+
+    // Best instruction set supported by the running CPU (CPUID, evaluated once)
+    SpMVIsa SpMV_detect_isa();
+
+    const char* SpMV_isa_name(SpMVIsa isa);
+
+    // 16-bit floating point storage formats, handled as raw bits on the host
+    enum class HalfFormat {
+        FP16, // IEEE binary16 (half, hcomplex)
+        BF16  // bfloat16 (__nv_bfloat16, bcomplex)
+    };
+
+    // Widening / narrowing (round to nearest even) of n 16-bit values, F16C or AVX-512 when available
+    void Half_to_float(const uint16_t* in, float* out, size_t n, HalfFormat format);
+    void Float_to_half(const float* in, uint16_t* out, size_t n, HalfFormat format);
+
+    // y = A x (or conj(A) x) for an interleaved complex CSR matrix, rows in parallel
+    // isa is clamped to what the CPU supports
+    template<typename Real, typename IndexType>
+    void CSR_SpMV_complex(size_t num_rows,
+                          const IndexType* row_offsets,
+                          const IndexType* column_indices,
+                          const thrust::complex<Real>* values,
+                          const thrust::complex<Real>* x,
+                          thrust::complex<Real>* y,
+                          bool conjugate = false,
+                          SpMVIsa isa = SpMV_detect_isa());
+
+    // y = A x for a CSR matrix stored in 16-bit values, widened on load and accumulated in fp32
+    // x and y are fp32 (interleaved pairs when complex), conjugate applies to complex matrices
+    template<typename IndexType>
+    void CSR_SpMV_half(size_t num_rows,
+                       const IndexType* row_offsets,
+                       const IndexType* column_indices,
+                       const uint16_t* values,
+                       HalfFormat format,
+                       bool complex,
+                       const float* x,
+                       float* y,
+                       bool conjugate = false,
+                       SpMVIsa isa = SpMV_detect_isa());
+
+
+    // Race-free parallelization of y = A^T x over row-ordered CSR storage, every row scatters into y
+    enum class TransposeStrategy {
+        Auto,          // picked by make_transpose_plan from the matrix shape
+        Coloring,      // row blocks with disjoint column ranges run concurrently, one color after the other
+        ThreadBuffers, // per-thread partial y, summed in a parallel reduction
+        Atomics        // atomic updates of y, for float / double and their complex types
+    };
+
+    template<typename IndexType>
+    struct TransposePlan {
+        TransposeStrategy strategy = TransposeStrategy::Auto;
+        int threads = 0;
+        std::vector<IndexType> block_rows;  // row boundaries of nnz-balanced blocks
+        std::vector<int> color_offsets;     // blocks of color c are color_blocks[color_offsets[c] .. color_offsets[c + 1])
+        std::vector<int> color_blocks;
+
+        size_t num_colors() const { return color_offsets.empty() ? 0 : color_offsets.size() - 1; }
+    };
+
+    const char* Transpose_strategy_name(TransposeStrategy strategy);
+
+    // Blocks are colored greedily by their column ranges. Auto takes coloring when every color holds
+    // enough blocks for all threads (banded / locality ordered patterns), thread buffers when
+    // threads * num_cols values are cheap next to the matrix, atomics otherwise
+    template<typename ValueType, typename IndexType>
+    TransposePlan<IndexType> make_transpose_plan(size_t num_rows,
+                                                 size_t num_cols,
+                                                 const IndexType* row_offsets,
+                                                 const IndexType* column_indices,
+                                                 TransposeStrategy strategy = TransposeStrategy::Auto,
+                                                 int threads = omp_get_max_threads());
+
+    // y = A^T x (or A^H x) on the CSR arrays, y has num_cols entries, workspace holds the thread buffers
+    template<typename ValueType, typename IndexType>
+    void CSR_SpMV_transpose(const TransposePlan<IndexType>& plan,
+                            size_t num_rows,
+                            size_t num_cols,
+                            const IndexType* row_offsets,
+                            const IndexType* column_indices,
+                            const ValueType* values,
+                            const ValueType* x,
+                            ValueType* y,
+                            bool conjugate,
+                            std::vector<ValueType>& workspace);
+
+}
+
+#include "details/SpMVKernels.inl"
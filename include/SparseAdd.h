@@ -0,0 +1,41 @@
+#pragma once
+
+#include "utils.h"
+
+namespace puff {
+
+    // C = alpha A + beta B on the union of the patterns of two sorted CSR matrices, rows merged in parallel.
+    // Row i of A is empty for i >= a_rows (same for B), C has max(a_rows, b_rows) rows.
+    // Entries of the union are kept even when they cancel
+    template<typename ValueType, typename IndexType>
+    void CSR_add(size_t a_rows,
+                 const IndexType* a_offsets,
+                 const IndexType* a_indices,
+                 const ValueType* a_values,
+                 ValueType alpha,
+                 size_t b_rows,
+                 const IndexType* b_offsets,
+                 const IndexType* b_indices,
+                 const ValueType* b_values,
+                 ValueType beta,
+                 std::vector<IndexType>& c_offsets,
+                 std::vector<IndexType>& c_indices,
+                 std::vector<ValueType>& c_values);
+
+    // A = alpha A + beta B in place when the pattern of B is a subset of the pattern of A.
+    // Returns false and leaves A untouched when B has an entry outside A
+    template<typename ValueType, typename IndexType>
+    bool CSR_add_inplace(size_t a_rows,
+                         const IndexType* a_offsets,
+                         const IndexType* a_indices,
+                         ValueType* a_values,
+                         ValueType alpha,
+                         size_t b_rows,
+                         const IndexType* b_offsets,
+                         const IndexType* b_indices,
+                         const ValueType* b_values,
+                         ValueType beta);
+
+}
+
+#include "details/SparseAdd.inl"
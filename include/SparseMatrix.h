@@ -1,6 +1,18 @@
 #pragma once
 
 #include "utils.h"
+#include "SplitComplex.h"
+#include "SpMVKernels.h"
+#include "MKLSparse.h"
+#include "SpGEMM.h"
+#include "SparseAdd.h"
+#include "Sparsification.h"
+#include "Equilibration.h"
+#include "BlockJacobi.h"
+#include "Pardiso.h"
+#include "Krylov.h"
+#include "ConcurrentHashMap.h"
+#include "RowBuckets.h"
 
 #define INDEX_TYPE uint32_t
 #define KEY_TYPE uint64_t
@@ -30,8 +42,61 @@ namespace puff {
             }
 
 
+            // Preallocates a lock-free table for about expected_entries entries, so concurrent
+            // insert_entry calls no longer serialize on the mutex. Entries that do not fit stay in the map.
+            // The table is kept over make_matrix and reset(), set_capacity_hint(0) releases it
+            void set_capacity_hint(size_t expected_entries) {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto pending = drain_unbucketed();
+                table.reserve(expected_entries);
+                for(auto& [key, value] : pending) insert_key(key, value);
+            }
+
+            // Expected number of nonzeros, no rehash while inserting up to that many entries
+            void reserve(size_t expected_nnz) {
+                set_capacity_hint(expected_nnz);
+            }
+
+            // Sparsity pattern hint: estimated entries of each row. Entries are bucketed by row as they are
+            // inserted and make_matrix only sorts within rows, entries beyond a row's estimate (25% slack)
+            // fall back to the table / map and are merged in. The table of an earlier set_capacity_hint / reserve keeps its
+            // capacity and the slabs are kept over make_matrix and reset(), set_pattern_hint({}) releases them.
+            // Like set_capacity_hint, call it before inserting concurrently
+            void set_pattern_hint(const std::vector<size_t>& nnz_per_row) {
+                std::lock_guard<std::mutex> lock(mtx);
+                std::vector<std::pair<KEY_TYPE, ValueType>> pending;
+                buckets.for_each([&](IndexType row, IndexType col, const ValueType& value) { pending.emplace_back(row_col_to_key(row, col), value); });
+                for(auto& entry : drain_unbucketed()) pending.push_back(entry);
+                std::vector<size_t> capacity(nnz_per_row.size());
+                for(size_t i = 0; i < capacity.size(); i++) capacity[i] = nnz_per_row[i] + (nnz_per_row[i] + 3) / 4;
+                buckets.reserve(capacity);
+                for(auto& [key, value] : pending) insert_key(key, value);
+            }
+
+            void set_pattern_hint(size_t num_rows, size_t nnz_per_row) {
+                set_pattern_hint(std::vector<size_t>(num_rows, nnz_per_row));
+            }
+
+            // Slots of the lock-free table and entries of the row slabs currently allocated by the hints
+            size_t get_table_capacity() const { return table.capacity(); }
+            size_t get_bucket_capacity() const { return buckets.capacity(); }
+
+            // Entries dropped by the next make_matrix calls besides exact zeros, trading a controlled
+            // accuracy loss (see get_drop_report) for a smaller operator
+            void set_drop_policy(const DropPolicy& policy) {
+                drop_policy = policy;
+            }
+
+            const DropPolicy& get_drop_policy() const { return drop_policy; }
+
+            // Entries and Frobenius mass removed by the policy at the last make_matrix (norms are only
+            // computed when a policy is set)
+            const DropReport& get_drop_report() const { return drop_report; }
+
             void insert_entry(IndexType row, IndexType col, ValueType val) {
+                if(buckets.assign(row, col, val)) return;
                 auto row_col_string = row_col_to_key(row, col);
+                if(table.assign(row_col_string, val)) return;
                 {
                     std::lock_guard<std::mutex> lock(mtx);
                     entries[row_col_string] = val;
@@ -40,6 +105,8 @@ namespace puff {
 
             void remove_entry(IndexType row, IndexType col) {
                 auto row_col_string = row_col_to_key(row, col);
+                // 0 entries are dropped by make_matrix
+                if(buckets.update(row, col, ValueType(0)) || table.update(row_col_string, ValueType(0))) return;
                 {
                     std::lock_guard<std::mutex> lock(mtx);
                     entries.erase(row_col_string);
@@ -49,40 +116,94 @@ namespace puff {
             void make_matrix()
             {
                 std::lock_guard<std::mutex> lock(mtx);
-                Vector<IndexType, cusp::host_memory> h_I(entries.size());
-                Vector<IndexType, cusp::host_memory> h_J(entries.size());
-                Vector<ValueType, cusp::host_memory> h_V(entries.size());
+                auto nonzero = [](const ValueType& value) { return !(value == ValueType(0)); }; // No 0 element
 
-                int nnz = 0;
+                // Bucketed entries come out sorted, row by row
+                Vector<KEY_TYPE, cusp::host_memory> h_K(buckets.size());
+                Vector<ValueType, cusp::host_memory> h_V(h_K.size());
+                size_t nnz = buckets.extract_sorted(thrust::raw_pointer_cast(h_K.data()), thrust::raw_pointer_cast(h_V.data()), nonzero);
+                h_K.resize(nnz);
+                h_V.resize(nnz);
+
+                // Packed keys of the table (compacted in parallel) and of the map are sorted, then merged
+                Vector<KEY_TYPE, cusp::host_memory> f_K(table.size() + entries.size());
+                Vector<ValueType, cusp::host_memory> f_V(f_K.size());
+                size_t fallback = table.extract(thrust::raw_pointer_cast(f_K.data()), thrust::raw_pointer_cast(f_V.data()), nonzero);
                 for(auto& [row_col_key, value] : entries)
                 {
-                    auto [row, col] = key_to_row_col(row_col_key);
-                    if(value == ValueType(0)) continue; // No 0 element
-                    h_I[nnz] = row;
-                    h_J[nnz] = col;
-                    h_V[nnz] = value;
-                    nnz++;
-                }    
+                    if(!nonzero(value)) continue;
+                    f_K[fallback] = row_col_key;
+                    f_V[fallback] = value;
+                    fallback++;
+                }
 
                 {
-                    // Free memory
+                    // Free memory, the table and the slabs of the hints are emptied for the next assembly
                     std::unordered_map<KEY_TYPE, ValueType> temp_entries;
                     std::swap(entries, temp_entries); // force entries to free memory
+                    table.reset();
+                    buckets.reset();
                 }  
 
-                h_I.resize(nnz); h_I.shrink_to_fit();
-                h_J.resize(nnz); h_J.shrink_to_fit();
-                h_V.resize(nnz); h_V.shrink_to_fit();
-                
-                
-                // sort triplets by (i,j) index using two stable sorts (first by J, then by I)
-                thrust::stable_sort_by_key(h_J.begin(), h_J.end(), thrust::make_zip_iterator(thrust::make_tuple(h_I.begin(), h_V.begin())));
-                thrust::stable_sort_by_key(h_I.begin(), h_I.end(), thrust::make_zip_iterator(thrust::make_tuple(h_J.begin(), h_V.begin())));
+                f_K.resize(fallback);
+                f_V.resize(fallback);
+                // sort triplets by (i,j) index, the packed key orders by row then column
+                thrust::sort_by_key(f_K.begin(), f_K.end(), f_V.begin());
+                if(nnz == 0)
+                {
+                    h_K.swap(f_K);
+                    h_V.swap(f_V);
+                }
+                else if(fallback > 0)
+                {
+                    Vector<KEY_TYPE, cusp::host_memory> m_K(nnz + fallback);
+                    Vector<ValueType, cusp::host_memory> m_V(nnz + fallback);
+                    thrust::merge_by_key(h_K.begin(), h_K.end(), f_K.begin(), f_K.end(), h_V.begin(), f_V.begin(), m_K.begin(), m_V.begin());
+                    h_K.swap(m_K);
+                    h_V.swap(m_V);
+                }
+                {
+                    Vector<KEY_TYPE, cusp::host_memory> temp_keys;
+                    Vector<ValueType, cusp::host_memory> temp_values;
+                    f_K.swap(temp_keys);
+                    f_V.swap(temp_values);
+                }
+                nnz = h_K.size();
+
+                Vector<IndexType, cusp::host_memory> h_I(nnz);
+                Vector<IndexType, cusp::host_memory> h_J(nnz);
+                thrust::transform(h_K.begin(), h_K.end(), h_I.begin(), [](KEY_TYPE key) { return static_cast<IndexType>(key >> 32); });
+                thrust::transform(h_K.begin(), h_K.end(), h_J.begin(), [](KEY_TYPE key) { return static_cast<IndexType>(key); });
+                {
+                    Vector<KEY_TYPE, cusp::host_memory> temp_keys;
+                    h_K.swap(temp_keys);
+                }
 
 
                 // Calculate num_Rows
                 IndexType numRows = *thrust::max_element(h_I.begin(), h_I.end()) + 1; // Assume row indices are 0-based
                 IndexType numCols = *thrust::max_element(h_J.begin(), h_J.end()) + 1; // Assume column indices are 0-based
+
+                // Drop policy on the sorted triplets, the shape stays the one of the inserted entries
+                drop_report = DropReport();
+                drop_report.kept_entries = h_V.size();
+                if(drop_policy.rule != DropRule::None)
+                {
+                    Vector<IndexType, cusp::host_memory> h_offsets(numRows + 1);
+                    cusp::indices_to_offsets(h_I, h_offsets);
+                    Vector<uint8_t, cusp::host_memory> keep(h_V.size());
+                    drop_report = Drop_entries(drop_policy, numRows,
+                                               thrust::raw_pointer_cast(h_offsets.data()),
+                                               thrust::raw_pointer_cast(h_J.data()),
+                                               thrust::raw_pointer_cast(h_V.data()),
+                                               thrust::raw_pointer_cast(keep.data()));
+                    auto first = thrust::make_zip_iterator(thrust::make_tuple(h_I.begin(), h_J.begin(), h_V.begin()));
+                    auto last = thrust::remove_if(first, first + h_V.size(), keep.begin(), thrust::logical_not<uint8_t>());
+                    const size_t kept = last - first;
+                    h_I.resize(kept);
+                    h_J.resize(kept);
+                    h_V.resize(kept);
+                }
                 /*****************CSR Matrix********************/
                 /*
                 Vector<IndexType, cusp::host_memory> h_row_ptrs(numRows + 1, 0); // Initialize row pointers with zeros
@@ -110,29 +231,32 @@ namespace puff {
                 */
 
                 /*****************COO Matrix********************/
-                // resize matrix
-                matrix.resize(numRows, numCols, h_V.size());
-                // Move to prescribed memory space
-                // Insert I to matrix.row_offsets
-                thrust::copy(h_I.begin(), h_I.end(), matrix.row_indices.begin());
-                // Insert J to matrix.column_indices
-                thrust::copy(h_J.begin(), h_J.end(), matrix.column_indices.begin());
-                // Insert V to matrix.values
-                thrust::copy(h_V.begin(), h_V.end(), matrix.values.begin());
+                if constexpr(std::is_same_v<MemorySpace, cusp::host_memory>)
+                {
+                    // Already in place, hand the triplet arrays over
+                    matrix.resize(numRows, numCols, 0);
+                    matrix.num_entries = h_V.size();
+                    matrix.row_indices.swap(h_I);
+                    matrix.column_indices.swap(h_J);
+                    matrix.values.swap(h_V);
+                }
+                else
+                {
+                    // resize matrix
+                    matrix.resize(numRows, numCols, h_V.size());
+                    // Move to prescribed memory space
+                    // Insert I to matrix.row_offsets
+                    thrust::copy(h_I.begin(), h_I.end(), matrix.row_indices.begin());
+                    // Insert J to matrix.column_indices
+                    thrust::copy(h_J.begin(), h_J.end(), matrix.column_indices.begin());
+                    // Insert V to matrix.values
+                    thrust::copy(h_V.begin(), h_V.end(), matrix.values.begin());
+                }
 
-                // Make the transpose coo_matrix view
-                permutation = Vector<IndexType, MemorySpace>(cusp::counting_array<IndexType>(matrix.num_entries));
-                Vector<IndexType, MemorySpace> matrix_column_indices(matrix.column_indices);
-                cusp::counting_sort_by_key(matrix_column_indices, permutation, IndexType(0), IndexType(matrix.num_cols));
-                matrix_t = cusp::make_coo_matrix_view(matrix.num_rows, matrix.num_cols, matrix.num_entries,
-                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.column_indices.begin(), permutation.begin()),
-                                                                    thrust::make_permutation_iterator(matrix.column_indices.begin(), permutation.end())),
-                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.row_indices.begin(),    permutation.begin()),
-                                                                    thrust::make_permutation_iterator(matrix.row_indices.begin(),    permutation.end())),
-                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.values.begin(),         permutation.begin()),
-                                                                      thrust::make_permutation_iterator(matrix.values.begin(),         permutation.end())));
+                finalize_matrix();
             }
 
+            // Frees the matrix and the pending entries, the hints keep their capacity
             void reset()
             {
                 std::lock_guard<std::mutex> lock(mtx);
@@ -141,6 +265,18 @@ namespace puff {
                 
                 std::unordered_map<KEY_TYPE, ValueType> temp_entries;
                 swap(entries, temp_entries); // force entries to free memory
+                table.reset();
+                buckets.reset();
+
+                Vector<IndexType, MemorySpace> temp_offsets;
+                row_offsets.swap(temp_offsets);
+                split_values = {};
+                transpose_plan = {};
+                if constexpr(mkl_capable)
+                {
+                    mkl_handle.reset();
+                    pardiso.reset();
+                }
             }
 
             void print_matrix() {
@@ -153,6 +289,78 @@ namespace puff {
                       bool transpose = false, 
                       bool conjugate = false) {     
                 
+                if constexpr(mkl_capable)
+                {
+                    if(spmv_backend == SpMVBackend::MKL)
+                    {
+                        if(&x == &y)
+                        {
+                            Vector<ValueType, MemorySpace> temp(transpose ? matrix.num_cols : matrix.num_rows);
+                            SpMV(x, temp, transpose, conjugate);
+                            y.swap(temp);
+                            return;
+                        }
+                        y.resize(transpose ? matrix.num_cols : matrix.num_rows);
+                        mkl_mv(ValueType(1), thrust::raw_pointer_cast(x.data()), ValueType(0), thrust::raw_pointer_cast(y.data()), transpose, conjugate);
+                        return;
+                    }
+                }
+
+                if constexpr(std::is_same_v<MemorySpace, cusp::host_memory>)
+                {
+                    if(transpose)
+                    {
+                        if(&x == &y)
+                        {
+                            Vector<ValueType, MemorySpace> temp(matrix.num_cols);
+                            SpMV(x, temp, true, conjugate);
+                            y.swap(temp);
+                            return;
+                        }
+                        const TransposePlan<IndexType>& plan = get_transpose_plan();
+                        y.resize(matrix.num_cols);
+                        CSR_SpMV_transpose(plan, matrix.num_rows, matrix.num_cols,
+                                           thrust::raw_pointer_cast(row_offsets.data()),
+                                           thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                           thrust::raw_pointer_cast(matrix.values.data()),
+                                           thrust::raw_pointer_cast(x.data()),
+                                           thrust::raw_pointer_cast(y.data()),
+                                           conjugate, transpose_workspace);
+                        return;
+                    }
+                }
+
+                if constexpr(split_capable)
+                {
+                    if(spmv_backend == SpMVBackend::SIMD && !transpose)
+                    {
+                        if(&x == &y)
+                        {
+                            Vector<ValueType, MemorySpace> temp(matrix.num_rows);
+                            SpMV(x, temp, false, conjugate);
+                            y.swap(temp);
+                            return;
+                        }
+                        y.resize(matrix.num_rows);
+                        CSR_SpMV_complex(matrix.num_rows,
+                                         thrust::raw_pointer_cast(row_offsets.data()),
+                                         thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                         thrust::raw_pointer_cast(matrix.values.data()),
+                                         thrust::raw_pointer_cast(x.data()),
+                                         thrust::raw_pointer_cast(y.data()),
+                                         conjugate, spmv_isa);
+                        return;
+                    }
+                }
+                if constexpr(half_capable)
+                {
+                    if(spmv_backend == SpMVBackend::SIMD && !transpose)
+                    {
+                        SpMV_mixed(x, y, conjugate);
+                        return;
+                    }
+                }
+
                 if constexpr(std::is_same_v<ValueType, dcomplex> ||
                              std::is_same_v<ValueType, fcomplex> ||
                              std::is_same_v<ValueType, hcomplex> ||
@@ -191,6 +399,74 @@ namespace puff {
             }
 
 
+            // Split-complex SpMV (host dcomplex / fcomplex), the matrix values are split into planes once and cached
+            // Transposes go through the interleaved path
+            typedef typename cusp::norm_type<ValueType>::type Real; // Real is the type of the residual norm
+            void SpMV(const SplitVector<Real>& x,
+                      SplitVector<Real>& y,
+                      bool transpose = false,
+                      bool conjugate = false) {
+                static_assert(split_capable, "Split-complex SpMV needs a host dcomplex / fcomplex matrix");
+                if(transpose)
+                {
+                    Vector<ValueType, MemorySpace> xi, yi(matrix.num_cols);
+                    x.to_interleaved(xi);
+                    SpMV(xi, yi, true, conjugate);
+                    y.from_interleaved(yi);
+                    return;
+                }
+                if(&x == &y)
+                {
+                    SplitVector<Real> temp;
+                    SpMV(x, temp, false, conjugate);
+                    y.swap(temp);
+                    return;
+                }
+                if(split_values.size() != matrix.num_entries)
+                    split_values.from_interleaved(matrix.values);
+                y.resize(matrix.num_rows);
+                Split_SpMV(matrix.num_rows,
+                           thrust::raw_pointer_cast(row_offsets.data()),
+                           thrust::raw_pointer_cast(matrix.column_indices.data()),
+                           split_values.real_data(), split_values.imag_data(),
+                           x.real_data(), x.imag_data(),
+                           y.real_data(), y.imag_data(),
+                           conjugate);
+            }
+
+            // Half / bfloat16 storage (real or complex) on the host: the values are widened on load and accumulated in fp32
+            // y is either ValueType or its fp32 counterpart (float / fcomplex), which skips the final rounding
+            template<typename OutputType>
+            void SpMV_mixed(const Vector<ValueType, MemorySpace>& x,
+                            Vector<OutputType, MemorySpace>& y,
+                            bool conjugate = false) {
+                static_assert(half_capable, "Mixed precision SpMV needs a host half / bfloat16 matrix");
+                constexpr bool complex = std::is_same_v<ValueType, hcomplex> || std::is_same_v<ValueType, bcomplex>;
+                constexpr HalfFormat format = std::is_same_v<ValueType, half> || std::is_same_v<ValueType, hcomplex> ? HalfFormat::FP16 : HalfFormat::BF16;
+                constexpr size_t width = complex ? 2 : 1;
+                static_assert(sizeof(ValueType) == 2 * width, "16-bit components are expected");
+                static_assert(std::is_same_v<OutputType, ValueType> || sizeof(OutputType) == 4 * width, "y is ValueType or float / fcomplex");
+
+                // x is widened once, so the gathers read fp32 and x may alias y
+                mixed_x.resize(x.size() * width);
+                Half_to_float(reinterpret_cast<const uint16_t*>(thrust::raw_pointer_cast(x.data())), mixed_x.data(), mixed_x.size(), format);
+                y.resize(matrix.num_rows);
+                float* out;
+                if constexpr(std::is_same_v<OutputType, ValueType>)
+                {
+                    mixed_y.resize(matrix.num_rows * width);
+                    out = mixed_y.data();
+                }
+                else out = reinterpret_cast<float*>(thrust::raw_pointer_cast(y.data()));
+                CSR_SpMV_half(matrix.num_rows,
+                              thrust::raw_pointer_cast(row_offsets.data()),
+                              thrust::raw_pointer_cast(matrix.column_indices.data()),
+                              reinterpret_cast<const uint16_t*>(thrust::raw_pointer_cast(matrix.values.data())),
+                              format, complex, mixed_x.data(), out, conjugate, spmv_isa);
+                if constexpr(std::is_same_v<OutputType, ValueType>)
+                    Float_to_half(out, reinterpret_cast<uint16_t*>(thrust::raw_pointer_cast(y.data())), mixed_y.size(), format);
+            }
+
             void SpMVP(ValueType alpha, 
                        Vector<ValueType, MemorySpace>& x, 
                        ValueType beta, 
@@ -198,6 +474,17 @@ namespace puff {
                        bool transpose = false, 
                        bool conjugate = false) {
                 // y = alpha * A * x + beta * y
+                if constexpr(mkl_capable)
+                {
+                    // Scaling and accumulation happen inside mkl_sparse_?_mv
+                    if(spmv_backend == SpMVBackend::MKL)
+                    {
+                        if(beta == ValueType(0))
+                            y.resize(transpose ? matrix.num_cols : matrix.num_rows);
+                        mkl_mv(alpha, thrust::raw_pointer_cast(x.data()), beta, thrust::raw_pointer_cast(y.data()), transpose, conjugate);
+                        return;
+                    }
+                }
                 if (beta == 0)
                 {
                     // y = A * x
@@ -230,29 +517,802 @@ namespace puff {
                 return cusp::eigen::ritz_spectral_radius(matrix, k, symmetric);
             }
 
+            // Product path of SpMV and gmres, SIMD applies to non-transposed host products of
+            // dcomplex / fcomplex and of half / bfloat16 storage (real or complex, see SpMV_mixed)
+            // MKL applies to all host products (and SpMVP) of double / float / dcomplex / fcomplex
+            // isa caps the instruction set of the SIMD kernels, the default is the best one of the running CPU
+            void set_spmv_backend(SpMVBackend backend, SpMVIsa isa = SpMV_detect_isa()) {
+                spmv_backend = backend;
+                spmv_isa = isa;
+            }
+
+            SpMVBackend get_spmv_backend() const { return spmv_backend; }
+
+            // Expected number of products and the operations they use, passed to mkl_sparse_set_mv_hint
+            // before the single mkl_sparse_optimize of the MKL backend. Conjugated non-transposed products
+            // run as NonTranspose. Takes effect at the next make_matrix or product
+            void set_mv_hint(size_t expected_calls,
+                             std::vector<SpMVOperation> operations = {SpMVOperation::NonTranspose}) {
+                mkl_hint.expected_calls = expected_calls;
+                mkl_hint.operations = std::move(operations);
+                if constexpr(mkl_capable)
+                    mkl_handle.reset();
+            }
+
+            // Parallelization of host transposed products, Auto decides from the pattern at the first transpose
+            void set_transpose_strategy(TransposeStrategy strategy) {
+                transpose_strategy = strategy;
+                transpose_plan = {};
+            }
+
+            // Strategy in use, planned on demand
+            TransposeStrategy get_transpose_strategy() {
+                return get_transpose_plan().strategy;
+            }
+
+            // Replaces the assembled matrix by a sorted CSR matrix given by host arrays
+            void assign_csr(size_t num_rows,
+                            size_t num_cols,
+                            const IndexType* csr_offsets,
+                            const IndexType* csr_indices,
+                            const ValueType* csr_values)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                const size_t nnz = num_rows > 0 ? (size_t)csr_offsets[num_rows] : 0;
+                Vector<IndexType, cusp::host_memory> h_I(nnz);
+                IndexType* rows = thrust::raw_pointer_cast(h_I.data());
+                #pragma omp parallel for schedule(dynamic, 256)
+                for(long long i = 0; i < (long long)num_rows; i++)
+                    std::fill(rows + csr_offsets[i], rows + csr_offsets[i + 1], (IndexType)i);
+                matrix.resize(num_rows, num_cols, nnz);
+                thrust::copy(h_I.begin(), h_I.end(), matrix.row_indices.begin());
+                thrust::copy(csr_indices, csr_indices + nnz, matrix.column_indices.begin());
+                thrust::copy(csr_values, csr_values + nnz, matrix.values.begin());
+                finalize_matrix();
+            }
+
+            // this = A * B on the host (Gustavson, rows in parallel). The symbolic phase is kept in plan and
+            // rerun only when the shapes or the patterns of A and B change (checked against the fingerprints
+            // in plan), so a plan kept across frequency steps costs the numeric phase and one pass over the patterns.
+            // Shapes come from the largest indices, rows of B past its last entry are empty (like in add)
+            void multiply(SparseMatrixWrapper& A,
+                          SparseMatrixWrapper& B,
+                          SpGEMMPlan<IndexType>& plan,
+                          SpGEMMAccumulator accumulator = SpGEMMAccumulator::Auto)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "SpGEMM runs on host matrices");
+                const size_t num_inner = std::max<size_t>(A.matrix.num_cols, B.matrix.num_rows);
+                std::vector<IndexType> b_padded;
+                const IndexType* a_offsets = thrust::raw_pointer_cast(A.row_offsets.data());
+                const IndexType* a_indices = thrust::raw_pointer_cast(A.matrix.column_indices.data());
+                const IndexType* b_offsets = padded_offsets(B, num_inner, b_padded);
+                const IndexType* b_indices = thrust::raw_pointer_cast(B.matrix.column_indices.data());
+                if(plan.empty() || plan.num_rows != A.matrix.num_rows || plan.num_cols != B.matrix.num_cols ||
+                   plan.input_patterns != std::make_pair(CSR_pattern_fingerprint(A.matrix.num_rows, a_offsets, a_indices),
+                                                         CSR_pattern_fingerprint(num_inner, b_offsets, b_indices)))
+                    plan = SpGEMM_symbolic<ValueType>(A.matrix.num_rows, num_inner, B.matrix.num_cols,
+                                                      a_offsets, a_indices, b_offsets, b_indices, accumulator);
+                std::vector<ValueType> values(plan.num_entries());
+                SpGEMM_numeric(plan, a_offsets, a_indices, thrust::raw_pointer_cast(A.matrix.values.data()),
+                               b_offsets, b_indices, thrust::raw_pointer_cast(B.matrix.values.data()), values.data());
+                assign_csr(plan.num_rows, plan.num_cols, plan.row_offsets.data(), plan.column_indices.data(), values.data());
+            }
+
+            void multiply(SparseMatrixWrapper& A, SparseMatrixWrapper& B)
+            {
+                SpGEMMPlan<IndexType> plan;
+                multiply(A, B, plan);
+            }
+
+            // this = P^T A P (P^H A P when conjugate) on the host, fused without forming A P.
+            // plan is reused like in multiply, trailing empty rows of P and A are padded the same way
+            void triple_product(SparseMatrixWrapper& P,
+                                SparseMatrixWrapper& A,
+                                SpGEMMPlan<IndexType>& plan,
+                                bool conjugate = false,
+                                SpGEMMAccumulator accumulator = SpGEMMAccumulator::Auto)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "SpGEMM runs on host matrices");
+                const size_t n = std::max<size_t>({P.matrix.num_rows, A.matrix.num_rows, A.matrix.num_cols});
+                std::vector<IndexType> p_padded, a_padded;
+                const IndexType* p_offsets = padded_offsets(P, n, p_padded);
+                const IndexType* p_indices = thrust::raw_pointer_cast(P.matrix.column_indices.data());
+                const IndexType* a_offsets = padded_offsets(A, n, a_padded);
+                const IndexType* a_indices = thrust::raw_pointer_cast(A.matrix.column_indices.data());
+                if(plan.empty() || plan.num_rows != P.matrix.num_cols || plan.transpose_offsets.empty() ||
+                   plan.input_patterns != std::make_pair(CSR_pattern_fingerprint(n, p_offsets, p_indices),
+                                                         CSR_pattern_fingerprint(n, a_offsets, a_indices)))
+                    plan = Triple_product_symbolic<ValueType>(n, P.matrix.num_cols,
+                                                              p_offsets, p_indices, a_offsets, a_indices, accumulator);
+                std::vector<ValueType> values(plan.num_entries());
+                Triple_product_numeric(plan, p_offsets, p_indices, thrust::raw_pointer_cast(P.matrix.values.data()),
+                                       a_offsets, a_indices, thrust::raw_pointer_cast(A.matrix.values.data()),
+                                       values.data(), conjugate);
+                assign_csr(plan.num_rows, plan.num_cols, plan.row_offsets.data(), plan.column_indices.data(), values.data());
+            }
+
+            void triple_product(SparseMatrixWrapper& P, SparseMatrixWrapper& A, bool conjugate = false)
+            {
+                SpGEMMPlan<IndexType> plan;
+                triple_product(P, A, plan, conjugate);
+            }
+
+            // this = alpha * A + beta * B on the union of the patterns (host), one parallel row merge
+            // instead of re-inserting both matrices. this may be A or B
+            void add(ValueType alpha, SparseMatrixWrapper& A, ValueType beta, SparseMatrixWrapper& B)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "Sparse add runs on host matrices");
+                std::vector<IndexType> offsets, indices;
+                std::vector<ValueType> values;
+                CSR_add(A.matrix.num_rows,
+                        thrust::raw_pointer_cast(A.row_offsets.data()),
+                        thrust::raw_pointer_cast(A.matrix.column_indices.data()),
+                        thrust::raw_pointer_cast(A.matrix.values.data()),
+                        alpha,
+                        B.matrix.num_rows,
+                        thrust::raw_pointer_cast(B.row_offsets.data()),
+                        thrust::raw_pointer_cast(B.matrix.column_indices.data()),
+                        thrust::raw_pointer_cast(B.matrix.values.data()),
+                        beta, offsets, indices, values);
+                assign_csr(offsets.size() - 1, std::max(A.matrix.num_cols, B.matrix.num_cols),
+                           offsets.data(), indices.data(), values.data());
+            }
+
+            // this = alpha * this + beta * B without touching the pattern, when every entry of B is
+            // already in this (e.g. precorrection on the near-field pattern). False, nothing changed, otherwise
+            bool add_inplace(ValueType alpha, ValueType beta, SparseMatrixWrapper& B)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "Sparse add runs on host matrices");
+                std::lock_guard<std::mutex> lock(mtx);
+                bool subset = CSR_add_inplace(matrix.num_rows,
+                                              thrust::raw_pointer_cast(row_offsets.data()),
+                                              thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                              thrust::raw_pointer_cast(matrix.values.data()),
+                                              alpha,
+                                              B.matrix.num_rows,
+                                              thrust::raw_pointer_cast(B.row_offsets.data()),
+                                              thrust::raw_pointer_cast(B.matrix.column_indices.data()),
+                                              thrust::raw_pointer_cast(B.matrix.values.data()),
+                                              beta);
+                if(subset)
+                    values_changed();
+                return subset;
+            }
+
+            // Diagonal scaling computed at make_matrix (host) and applied implicitly by gmres, which solves
+            // (D_r A D_c) x_s = D_r b and returns x = D_c x_s. The stored values and SpMV stay those of A.
+            // Takes effect immediately on an assembled matrix
+            void set_equilibration(EquilibrationMethod method, size_t max_sweeps = 20, double tolerance = 1e-2) {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "Equilibration runs on host matrices");
+                std::lock_guard<std::mutex> lock(mtx);
+                equilibration_method = method;
+                equilibration_sweeps = max_sweeps;
+                equilibration_tolerance = tolerance;
+                if(row_offsets.size() == matrix.num_rows + 1)
+                    equilibrate();
+            }
+
+            const EquilibrationReport& get_equilibration_report() const { return equilibration_report; }
+            const std::vector<Real>& get_row_scale() const { return row_scale; }
+            const std::vector<Real>& get_col_scale() const { return col_scale; }
+
+            // Iterations of the last iterative solve (gmres, cocg, cocr, idrs, bicgstabl)
+            size_t get_gmres_iterations() const { return gmres_iterations; }
+
+            // Iterations of the last gmres on the current values without equilibration (0 if none), a verbose
+            // equilibrated solve reports them next to its own count
+            size_t get_unequilibrated_iterations() const { return unequilibrated_iterations; }
+
             // Solving Ax = b using GMRES
-            typedef typename cusp::norm_type<ValueType>::type Real; // Real is the type of the residual norm
+            // ComplexStorage::Split keeps x, the residual and the Krylov basis split for the whole solve (host dcomplex / fcomplex),
+            // also on an equilibrated system. With an equilibration the residual is the one of the scaled system,
+            // ||D_r (b - A x)|| / ||D_r b||
             ValueType gmres(Vector<ValueType, MemorySpace>& x, 
                             Vector<ValueType, MemorySpace>& b, 
                             size_t restart = 50, 
                             size_t maxiter = 1000, 
                             Real tol = Real(1e-6), 
-                            bool verbose = false) 
+                            bool verbose = false,
+                            ComplexStorage storage = ComplexStorage::Interleaved) 
+            {
+                cusp::identity_operator<ValueType, MemorySpace, IndexType> M(matrix.num_rows, matrix.num_rows);
+                return preconditioned_gmres(x, b, M, restart, maxiter, tol, verbose, storage);
+            }
+
+            // Preconditioned GMRES, M is a cusp linear operator approximating A^{-1} (e.g. block_jacobi).
+            // With an equilibration M keeps approximating the unscaled A^{-1} and is scaled along
+            template<typename Preconditioner, typename = std::enable_if_t<!std::is_arithmetic_v<Preconditioner>>>
+            ValueType gmres(Vector<ValueType, MemorySpace>& x,
+                            Vector<ValueType, MemorySpace>& b,
+                            Preconditioner& M,
+                            size_t restart = 50,
+                            size_t maxiter = 1000,
+                            Real tol = Real(1e-6),
+                            bool verbose = false,
+                            ComplexStorage storage = ComplexStorage::Interleaved)
+            {
+                return preconditioned_gmres(x, b, M, restart, maxiter, tol, verbose, storage);
+            }
+
+            // COCG / COCR for complex symmetric A (A = A^T, e.g. PGF operators at zero Bloch phase): short recurrences
+            // keep a handful of vectors instead of the restart basis of gmres, one product per iteration.
+            // M must be complex symmetric as well. Runs on the unscaled system, an equilibration is not applied
+            ValueType cocg(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
             {
+                cusp::identity_operator<ValueType, MemorySpace, IndexType> M(matrix.num_rows, matrix.num_rows);
+                return cocg(x, b, M, maxiter, tol, verbose);
+            }
+
+            template<typename Preconditioner, typename = std::enable_if_t<!std::is_arithmetic_v<Preconditioner>>>
+            ValueType cocg(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           Preconditioner& M,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
+            {
+                return short_recurrence_solve(x, b, M, maxiter, tol, verbose,
+                                              [](auto& A, auto& x, auto& b, auto& monitor, auto& M) { puff::cocg(A, x, b, monitor, M); });
+            }
+
+            ValueType cocr(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
+            {
+                cusp::identity_operator<ValueType, MemorySpace, IndexType> M(matrix.num_rows, matrix.num_rows);
+                return cocr(x, b, M, maxiter, tol, verbose);
+            }
+
+            template<typename Preconditioner, typename = std::enable_if_t<!std::is_arithmetic_v<Preconditioner>>>
+            ValueType cocr(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           Preconditioner& M,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
+            {
+                return short_recurrence_solve(x, b, M, maxiter, tol, verbose,
+                                              [](auto& A, auto& x, auto& b, auto& monitor, auto& M) { puff::cocr(A, x, b, monitor, M); });
+            }
+
+            // IDR(s) and BiCGStab(l) for general A with a memory footprint independent of the iteration count
+            // (3s + 4 and 2l + 5 vectors against the restart + 2 of gmres). Right preconditioned by M, no
+            // equilibration applied. An IDR(s) iteration is one product, a BiCGStab(l) iteration a BiCG step (two)
+            ValueType idrs(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           size_t s = 4,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
+            {
+                cusp::identity_operator<ValueType, MemorySpace, IndexType> M(matrix.num_rows, matrix.num_rows);
+                return idrs(x, b, M, s, maxiter, tol, verbose);
+            }
+
+            template<typename Preconditioner, typename = std::enable_if_t<!std::is_arithmetic_v<Preconditioner>>>
+            ValueType idrs(Vector<ValueType, MemorySpace>& x,
+                           Vector<ValueType, MemorySpace>& b,
+                           Preconditioner& M,
+                           size_t s = 4,
+                           size_t maxiter = 1000,
+                           Real tol = Real(1e-6),
+                           bool verbose = false)
+            {
+                return short_recurrence_solve(x, b, M, maxiter, tol, verbose,
+                                              [s](auto& A, auto& x, auto& b, auto& monitor, auto& M) { puff::idrs(A, x, b, s, monitor, M); });
+            }
+
+            ValueType bicgstabl(Vector<ValueType, MemorySpace>& x,
+                                Vector<ValueType, MemorySpace>& b,
+                                size_t l = 2,
+                                size_t maxiter = 1000,
+                                Real tol = Real(1e-6),
+                                bool verbose = false)
+            {
+                cusp::identity_operator<ValueType, MemorySpace, IndexType> M(matrix.num_rows, matrix.num_rows);
+                return bicgstabl(x, b, M, l, maxiter, tol, verbose);
+            }
+
+            template<typename Preconditioner, typename = std::enable_if_t<!std::is_arithmetic_v<Preconditioner>>>
+            ValueType bicgstabl(Vector<ValueType, MemorySpace>& x,
+                                Vector<ValueType, MemorySpace>& b,
+                                Preconditioner& M,
+                                size_t l = 2,
+                                size_t maxiter = 1000,
+                                Real tol = Real(1e-6),
+                                bool verbose = false)
+            {
+                return short_recurrence_solve(x, b, M, maxiter, tol, verbose,
+                                              [l](auto& A, auto& x, auto& b, auto& monitor, auto& M) { puff::bicgstabl(A, x, b, l, monitor, M); });
+            }
+
+            // Block-Jacobi preconditioner on the diagonal blocks of the partition block_offsets (block b owns
+            // rows and columns block_offsets[b] .. block_offsets[b + 1]), extracted and LU-factored.
+            // Throws std::invalid_argument if the partition does not cover the rows of a square matrix
+            BlockJacobi<ValueType, IndexType> block_jacobi(std::vector<IndexType> block_offsets)
+            {
+                if(block_offsets.empty() || (size_t)block_offsets.back() != matrix.num_rows)
+                    throw std::invalid_argument("block_jacobi: block offsets must end at the number of rows");
+                BlockJacobi<ValueType, IndexType> M(std::move(block_offsets));
+                update_block_jacobi(M);
+                return M;
+            }
+
+            // Refactors M from the current values (same partition), e.g. after add_inplace. Returns the number of singular blocks
+            size_t update_block_jacobi(BlockJacobi<ValueType, IndexType>& M)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "Block-Jacobi runs on host matrices");
+                std::lock_guard<std::mutex> lock(mtx);
+                if(matrix.num_rows != matrix.num_cols)
+                    throw std::invalid_argument("block_jacobi: the matrix must be square");
+                if(M.num_rows != matrix.num_rows)
+                    throw std::invalid_argument("block_jacobi: the partition does not match the number of rows");
+                M.extract(thrust::raw_pointer_cast(row_offsets.data()),
+                          thrust::raw_pointer_cast(matrix.column_indices.data()),
+                          thrust::raw_pointer_cast(matrix.values.data()));
+                return M.factor();
+            }
+
+            // Direct solve of A X = B with PARDISO, b holds nrhs column-major right-hand sides of num_rows entries.
+            // Reordering and symbolic factorization are reused while pattern and type stay the same (e.g. a
+            // frequency sweep re-assembling the same near field), the numeric factorization while the values do.
+            // Symmetric assumes A = A^T and reads the upper triangle only
+            void direct_solve(Vector<ValueType, MemorySpace>& x,
+                              Vector<ValueType, MemorySpace>& b,
+                              size_t nrhs = 1,
+                              PardisoMatrixType type = PardisoMatrixType::Unsymmetric)
+            {
+                static_assert(mkl_capable, "PARDISO runs on host double, float, dcomplex and fcomplex matrices");
+                if(&x == &b)
+                {
+                    Vector<ValueType, MemorySpace> temp(b);
+                    direct_solve(x, temp, nrhs, type);
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                assert(matrix.num_rows == matrix.num_cols && b.size() == matrix.num_rows * nrhs);
+                prepare_direct_solver(type);
+                x.resize(b.size());
+                pardiso.solve(thrust::raw_pointer_cast(b.data()), thrust::raw_pointer_cast(x.data()), nrhs);
+            }
+
+            // Analysis and factorization ahead of the first direct_solve
+            void direct_factorize(PardisoMatrixType type = PardisoMatrixType::Unsymmetric)
+            {
+                static_assert(mkl_capable, "PARDISO runs on host double, float, dcomplex and fcomplex matrices");
+                std::lock_guard<std::mutex> lock(mtx);
+                assert(matrix.num_rows == matrix.num_cols);
+                prepare_direct_solver(type);
+            }
+
+            const PardisoReport& get_direct_solver_report() const { return pardiso.get_report(); }
+
+            // Frees the factors, the next direct_solve starts from the analysis
+            void release_direct_solver()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if constexpr(mkl_capable)
+                    pardiso.reset();
+            }
+
+            const SparseMatrix<IndexType, ValueType, MemorySpace>& get_matrix() const { return matrix; }
+            const Vector<IndexType, MemorySpace>& get_row_offsets() const { return row_offsets; }
+
+
+        private:
+            static constexpr bool split_capable = std::is_same_v<MemorySpace, cusp::host_memory> &&
+                                                  (std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>);
+            static constexpr bool mkl_capable = std::is_same_v<MemorySpace, cusp::host_memory> && MKLSparseMatrix<ValueType>::supported;
+            static constexpr bool half_capable = std::is_same_v<MemorySpace, cusp::host_memory> &&
+                                                 (std::is_same_v<ValueType, half> || std::is_same_v<ValueType, __nv_bfloat16> ||
+                                                  std::is_same_v<ValueType, hcomplex> || std::is_same_v<ValueType, bcomplex>);
+
+            // Operator handed to cusp Krylov solvers so their products go through the selected SpMV path
+            struct HostOperator : public cusp::linear_operator<ValueType, MemorySpace, IndexType> {
+                SparseMatrixWrapper* A;
+
+                explicit HostOperator(SparseMatrixWrapper& A)
+                    : cusp::linear_operator<ValueType, MemorySpace, IndexType>(A.matrix.num_rows, A.matrix.num_cols), A(&A) {}
+
+                template<typename Array1, typename Array2>
+                void operator()(const Array1& x, Array2& y) const {
+                    if(A->spmv_backend == SpMVBackend::MKL)
+                    {
+                        A->mkl_mv(ValueType(1), &x[0], ValueType(0), &y[0], false, false);
+                        return;
+                    }
+                    if constexpr(split_capable)
+                        CSR_SpMV_complex(A->matrix.num_rows,
+                                         thrust::raw_pointer_cast(A->row_offsets.data()),
+                                         thrust::raw_pointer_cast(A->matrix.column_indices.data()),
+                                         thrust::raw_pointer_cast(A->matrix.values.data()),
+                                         &x[0], &y[0], false, A->spmv_isa);
+                }
+            };
+
+            // Row offsets, cached plans and handles of a freshly assembled matrix. Caller holds mtx
+            void finalize_matrix()
+            {
+                // CSR row offsets of the sorted triplets for the row-wise host kernels
+                row_offsets.resize(matrix.num_rows + 1);
+                cusp::indices_to_offsets(matrix.row_indices, row_offsets);
+                split_values = {};
+
+                transpose_plan = {};
+                unequilibrated_iterations = 0;
+                equilibrate();
+
+                // Inspection and optimization are paid here, not at the first product.
+                // The PARDISO analysis is kept for a pattern that comes back unchanged
+                if constexpr(mkl_capable)
+                {
+                    mkl_handle.reset();
+                    if(spmv_backend == SpMVBackend::MKL)
+                        get_mkl_handle();
+                    pardiso.invalidate_values();
+                }
+
+                // Host transposes run on the row-ordered storage, only the device keeps a transpose view
+                if constexpr(std::is_same_v<MemorySpace, cusp::host_memory>)
+                    return;
+
+                // Make the transpose coo_matrix view
+                permutation = Vector<IndexType, MemorySpace>(cusp::counting_array<IndexType>(matrix.num_entries));
+                Vector<IndexType, MemorySpace> matrix_column_indices(matrix.column_indices);
+                cusp::counting_sort_by_key(matrix_column_indices, permutation, IndexType(0), IndexType(matrix.num_cols));
+                matrix_t = cusp::make_coo_matrix_view(matrix.num_rows, matrix.num_cols, matrix.num_entries,
+                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.column_indices.begin(), permutation.begin()),
+                                                                    thrust::make_permutation_iterator(matrix.column_indices.begin(), permutation.end())),
+                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.row_indices.begin(),    permutation.begin()),
+                                                                    thrust::make_permutation_iterator(matrix.row_indices.begin(),    permutation.end())),
+                                                cusp::make_array1d_view(thrust::make_permutation_iterator(matrix.values.begin(),         permutation.begin()),
+                                                                      thrust::make_permutation_iterator(matrix.values.begin(),         permutation.end())));
+            }
+
+            // Drops the caches derived from matrix.values after an update that keeps the pattern
+            void values_changed()
+            {
+                split_values = {};
+                unequilibrated_iterations = 0;
+                equilibrate();
+                if constexpr(mkl_capable)
+                {
+                    mkl_handle.reset();
+                    if(spmv_backend == SpMVBackend::MKL)
+                        get_mkl_handle();
+                    pardiso.invalidate_values();
+                }
+            }
+
+            // CSR offsets of M extended by empty rows up to num_rows, M's own offsets when it has enough rows
+            static const IndexType* padded_offsets(const SparseMatrixWrapper& M, size_t num_rows, std::vector<IndexType>& storage)
+            {
+                const IndexType* offsets = thrust::raw_pointer_cast(M.row_offsets.data());
+                if(num_rows <= M.matrix.num_rows)
+                    return offsets;
+                const IndexType entries = M.matrix.num_rows > 0 ? offsets[M.matrix.num_rows] : 0;
+                storage.assign(offsets, offsets + M.matrix.num_rows);
+                storage.resize(num_rows + 1, entries);
+                return storage.data();
+            }
+
+            // PARDISO analysis when the pattern or type changed, factorization when the values did. Caller holds mtx
+            void prepare_direct_solver(PardisoMatrixType type)
+            {
+                const IndexType* offsets = thrust::raw_pointer_cast(row_offsets.data());
+                const IndexType* indices = thrust::raw_pointer_cast(matrix.column_indices.data());
+                const ValueType* values = thrust::raw_pointer_cast(matrix.values.data());
+                if(!pardiso.matches(matrix.num_rows, offsets, indices, type))
+                    pardiso.analyze(matrix.num_rows, offsets, indices, values, type);
+                if(!pardiso.factored())
+                    pardiso.factor(values);
+            }
+
+            // Inspector-executor handle over row_offsets / column_indices / values, built on demand
+            const auto& get_mkl_handle() {
+                if(!mkl_handle.valid())
+                    mkl_handle.create(matrix.num_rows, matrix.num_cols,
+                                      thrust::raw_pointer_cast(row_offsets.data()),
+                                      thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                      thrust::raw_pointer_cast(matrix.values.data()),
+                                      mkl_hint);
+                return mkl_handle;
+            }
+
+            // y = alpha * op(A) * x + beta * y through MKL, y already sized. x may alias y
+            // conj(A) x is evaluated as conj(conj(alpha) A conj(x) + conj(beta) conj(y)), MKL has no such operation
+            void mkl_mv(ValueType alpha, const ValueType* x, ValueType beta, ValueType* y, bool transpose, bool conjugate) {
+                const size_t num_x = transpose ? matrix.num_rows : matrix.num_cols;
+                const size_t num_y = transpose ? matrix.num_cols : matrix.num_rows;
+                if(matrix.num_rows == 0) return;
+                constexpr bool complex = std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>;
+                const bool conjugate_values = complex && conjugate && !transpose;
+                if(x == y || conjugate_values)
+                {
+                    mkl_x.assign(x, x + num_x);
+                    x = mkl_x.data();
+                }
+                SpMVOperation operation = !transpose ? SpMVOperation::NonTranspose :
+                                          (conjugate ? SpMVOperation::ConjugateTranspose : SpMVOperation::Transpose);
+                const auto& handle = get_mkl_handle();
+                if constexpr(complex)
+                {
+                    if(conjugate_values)
+                    {
+                        auto conj = conjugate_functor<ValueType>();
+                        std::transform(mkl_x.begin(), mkl_x.end(), mkl_x.begin(), conj);
+                        if(beta != ValueType(0)) std::transform(y, y + num_y, y, conj);
+                        handle.mv(operation, conj(alpha), x, conj(beta), y);
+                        std::transform(y, y + num_y, y, conj);
+                        return;
+                    }
+                }
+                handle.mv(operation, alpha, x, beta, y);
+            }
+
+            // Body of both gmres overloads
+            template<typename Preconditioner>
+            ValueType preconditioned_gmres(Vector<ValueType, MemorySpace>& x,
+                                           Vector<ValueType, MemorySpace>& b,
+                                           Preconditioner& M,
+                                           size_t restart,
+                                           size_t maxiter,
+                                           Real tol,
+                                           bool verbose,
+                                           ComplexStorage storage)
+            {
+                if constexpr(std::is_same_v<MemorySpace, cusp::host_memory>)
+                {
+                    if(!row_scale.empty())
+                    {
+                        const size_t rows = matrix.num_rows, cols = matrix.num_cols;
+                        Vector<ValueType, MemorySpace> xs(cols), bs(rows);
+                        #pragma omp parallel for schedule(static)
+                        for(long long j = 0; j < (long long)cols; j++) xs[j] = x[j] / col_scale[j];
+                        #pragma omp parallel for schedule(static)
+                        for(long long i = 0; i < (long long)rows; i++) bs[i] = b[i] * row_scale[i];
+                        if(verbose)
+                            printf("Equilibration (%zu sweeps): row norm spread %e -> %e, column norm spread %e -> %e\n",
+                                   equilibration_report.sweeps, equilibration_report.row_spread_before, equilibration_report.row_spread_after,
+                                   equilibration_report.col_spread_before, equilibration_report.col_spread_after);
+                        cusp::monitor<Real> monitor(bs, maxiter, tol, 0, verbose);
+                        ScaledOperator A(*this);
+                        if constexpr(std::is_same_v<Preconditioner, cusp::identity_operator<ValueType, MemorySpace, IndexType>>)
+                        {
+                            if constexpr(split_capable)
+                            {
+                                if(storage == ComplexStorage::Split) split_gmres(xs, bs, restart, monitor, true);
+                                else cusp::krylov::gmres(A, xs, bs, restart, monitor, M);
+                            }
+                            else
+                                cusp::krylov::gmres(A, xs, bs, restart, monitor, M);
+                        }
+                        else
+                        {
+                            ScaledPreconditioner<Preconditioner> P(*this, M);
+                            cusp::krylov::gmres(A, xs, bs, restart, monitor, P);
+                        }
+                        #pragma omp parallel for schedule(static)
+                        for(long long j = 0; j < (long long)cols; j++) x[j] = xs[j] * col_scale[j];
+                        gmres_iterations = monitor.iteration_count();
+                        if(verbose && unequilibrated_iterations > 0)
+                            printf("GMRES on the equilibrated system: %zu iterations, %zu without equilibration\n",
+                                   gmres_iterations, unequilibrated_iterations);
+                        else if(verbose)
+                            printf("GMRES on the equilibrated system: %zu iterations\n", gmres_iterations);
+                        return monitor.residual_norm();
+                    }
+                }
                 cusp::monitor<Real> monitor(b, maxiter, tol, 0, verbose);
-                cusp::krylov::gmres(matrix, x, b, restart, monitor);
+                if constexpr(split_capable && std::is_same_v<Preconditioner, cusp::identity_operator<ValueType, MemorySpace, IndexType>>)
+                {
+                    // x and b are converted once, a preconditioner works on interleaved vectors and keeps the path below
+                    if(storage == ComplexStorage::Split)
+                    {
+                        split_gmres(x, b, restart, monitor, false);
+                        gmres_iterations = unequilibrated_iterations = monitor.iteration_count();
+                        return monitor.residual_norm();
+                    }
+                }
+                if constexpr(mkl_capable)
+                {
+                    if(spmv_backend == SpMVBackend::MKL || (split_capable && spmv_backend == SpMVBackend::SIMD))
+                    {
+                        HostOperator A(*this);
+                        cusp::krylov::gmres(A, x, b, restart, monitor, M);
+                        gmres_iterations = unequilibrated_iterations = monitor.iteration_count();
+                        return monitor.residual_norm();
+                    }
+                }
+                cusp::krylov::gmres(matrix, x, b, restart, monitor, M);
+                gmres_iterations = unequilibrated_iterations = monitor.iteration_count();
                 return monitor.residual_norm();
             }
 
+            // Split_gmres on the matrix, on D_r A D_c when scaled. x and b are converted once
+            void split_gmres(Vector<ValueType, MemorySpace>& x,
+                             Vector<ValueType, MemorySpace>& b,
+                             size_t restart,
+                             cusp::monitor<Real>& monitor,
+                             bool scaled)
+            {
+                SplitVector<Real> xs(x), bs(b), us;
+                // out = diag(d) in, out may be in
+                auto scale = [](const SplitVector<Real>& in, SplitVector<Real>& out, const std::vector<Real>& d) {
+                    out.resize(in.size());
+                    const Real* in_re = in.real_data(); const Real* in_im = in.imag_data();
+                    Real* re = out.real_data(); Real* im = out.imag_data();
+                    #pragma omp parallel for simd
+                    for(long long i = 0; i < (long long)in.size(); i++)
+                    {
+                        re[i] = in_re[i] * d[i];
+                        im[i] = in_im[i] * d[i];
+                    }
+                };
+                auto A = [&](const SplitVector<Real>& u, SplitVector<Real>& v) {
+                    if(!scaled)
+                    {
+                        SpMV(u, v);
+                        return;
+                    }
+                    scale(u, us, col_scale);
+                    SpMV(us, v);
+                    scale(v, v, row_scale);
+                };
+                Split_gmres(A, xs, bs, restart, monitor);
+                xs.to_interleaved(x);
+            }
+
+            // Runs solver(A, x, b, monitor, M) of Krylov.h on the selected SpMV path
+            template<typename Preconditioner, typename Solver>
+            ValueType short_recurrence_solve(Vector<ValueType, MemorySpace>& x,
+                                             Vector<ValueType, MemorySpace>& b,
+                                             Preconditioner& M,
+                                             size_t maxiter,
+                                             Real tol,
+                                             bool verbose,
+                                             Solver solver)
+            {
+                static_assert(std::is_same_v<MemorySpace, cusp::host_memory>, "Short-recurrence solvers run on host matrices");
+                cusp::monitor<Real> monitor(b, maxiter, tol, 0, verbose);
+                if constexpr(mkl_capable)
+                {
+                    if(spmv_backend == SpMVBackend::MKL || (split_capable && spmv_backend == SpMVBackend::SIMD))
+                    {
+                        HostOperator A(*this);
+                        solver(A, x, b, monitor, M);
+                        gmres_iterations = monitor.iteration_count();
+                        return monitor.residual_norm();
+                    }
+                }
+                solver(matrix, x, b, monitor, M);
+                gmres_iterations = monitor.iteration_count();
+                return monitor.residual_norm();
+            }
+
+            // D_c^{-1} M D_r^{-1}, the preconditioner of the scaled system from one of A
+            template<typename Preconditioner>
+            struct ScaledPreconditioner : public cusp::linear_operator<ValueType, MemorySpace, IndexType> {
+                SparseMatrixWrapper* A;
+                Preconditioner* M;
+                mutable Vector<ValueType, MemorySpace> xs, ys;
+
+                ScaledPreconditioner(SparseMatrixWrapper& A, Preconditioner& M)
+                    : cusp::linear_operator<ValueType, MemorySpace, IndexType>(A.matrix.num_rows, A.matrix.num_rows), A(&A), M(&M),
+                      xs(A.matrix.num_rows), ys(A.matrix.num_rows) {}
+
+                template<typename Array1, typename Array2>
+                void operator()(const Array1& x, Array2& y) const {
+                    #pragma omp parallel for schedule(static)
+                    for(long long i = 0; i < (long long)xs.size(); i++) xs[i] = x[i] / A->row_scale[i];
+                    (*M)(xs, ys);
+                    #pragma omp parallel for schedule(static)
+                    for(long long j = 0; j < (long long)ys.size(); j++) y[j] = ys[j] / A->col_scale[j];
+                }
+            };
+
+            // D_r A D_c through the selected SpMV path
+            struct ScaledOperator : public cusp::linear_operator<ValueType, MemorySpace, IndexType> {
+                SparseMatrixWrapper* A;
+
+                ScaledOperator(SparseMatrixWrapper& A)
+                    : cusp::linear_operator<ValueType, MemorySpace, IndexType>(A.matrix.num_rows, A.matrix.num_cols), A(&A) {}
+
+                template<typename Array1, typename Array2>
+                void operator()(const Array1& x, Array2& y) const {
+                    auto& xs = A->scaled_x;
+                    auto& ys = A->scaled_y;
+                    xs.resize(A->matrix.num_cols);
+                    #pragma omp parallel for schedule(static)
+                    for(long long j = 0; j < (long long)xs.size(); j++) xs[j] = x[j] * A->col_scale[j];
+                    A->SpMV(xs, ys);
+                    #pragma omp parallel for schedule(static)
+                    for(long long i = 0; i < (long long)ys.size(); i++) y[i] = ys[i] * A->row_scale[i];
+                }
+            };
+
+            // Scaling factors of the current values, nothing when no equilibration is set. Caller holds mtx
+            void equilibrate() {
+                if constexpr(std::is_same_v<MemorySpace, cusp::host_memory>)
+                {
+                    row_scale.clear();
+                    col_scale.clear();
+                    equilibration_report = EquilibrationReport();
+                    if(equilibration_method == EquilibrationMethod::None) return;
+                    equilibration_report = Equilibrate(equilibration_method, matrix.num_rows, matrix.num_cols,
+                                                       thrust::raw_pointer_cast(row_offsets.data()),
+                                                       thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                                       thrust::raw_pointer_cast(matrix.values.data()),
+                                                       row_scale, col_scale, equilibration_sweeps, equilibration_tolerance);
+                }
+            }
+
+            // Plan of the host transpose kernel, rebuilt after make_matrix or when the thread count changes
+            const TransposePlan<IndexType>& get_transpose_plan() {
+                if(transpose_plan.threads != omp_get_max_threads())
+                    transpose_plan = make_transpose_plan<ValueType>(matrix.num_rows, matrix.num_cols,
+                                                                    thrust::raw_pointer_cast(row_offsets.data()),
+                                                                    thrust::raw_pointer_cast(matrix.column_indices.data()),
+                                                                    transpose_strategy);
+                return transpose_plan;
+            }
 
-        private:
             SparseMatrix<IndexType, ValueType, MemorySpace> matrix;
-            // Transpose matrix view
+            Vector<IndexType, MemorySpace> row_offsets; // CSR offsets of the sorted COO rows
+            std::conditional_t<split_capable, SplitVector<Real>, char> split_values; // cached split copy of matrix.values
+            SpMVBackend spmv_backend = SpMVBackend::Generic;
+            SpMVIsa spmv_isa = SpMV_detect_isa();
+            std::vector<float> mixed_x, mixed_y; // fp32 workspaces of SpMV_mixed
+            MKLSparseHint mkl_hint;
+            std::conditional_t<mkl_capable, MKLSparseMatrix<ValueType>, char> mkl_handle;
+            std::vector<ValueType> mkl_x; // copy of x for aliased or conjugated MKL products
+            std::conditional_t<mkl_capable, PardisoSolver<ValueType, IndexType>, char> pardiso; // pattern analysis and factors of direct_solve
+            TransposeStrategy transpose_strategy = TransposeStrategy::Auto;
+            TransposePlan<IndexType> transpose_plan;
+            std::vector<ValueType> transpose_workspace; // per-thread partial results of the transpose
+            // Transpose matrix view (device only)
             // Use decltype to infer the type
             SparseMatrixView<IndexType, ValueType, MemorySpace> matrix_t;
             Vector<IndexType, MemorySpace> permutation; // permutation for transpose
 
-            std::unordered_map<KEY_TYPE, ValueType> entries;
+            std::unordered_map<KEY_TYPE, ValueType> entries; // entries outside the lock-free table (no hint or full probe window)
+            ConcurrentHashMap<ValueType> table;
+            RowBuckets<IndexType, ValueType> buckets; // per-row slabs from the pattern hint, checked first
+            DropPolicy drop_policy;
+            DropReport drop_report;
+            EquilibrationMethod equilibration_method = EquilibrationMethod::None;
+            size_t equilibration_sweeps = 20;
+            double equilibration_tolerance = 1e-2;
+            EquilibrationReport equilibration_report;
+            std::vector<Real> row_scale, col_scale; // D_r and D_c, empty without equilibration
+            Vector<ValueType, MemorySpace> scaled_x, scaled_y; // workspaces of ScaledOperator
+            size_t gmres_iterations = 0;
+            size_t unequilibrated_iterations = 0; // of the last gmres without equilibration on the current values
+
+            // Insertion order of the containers: row buckets, lock-free table, map. Caller holds mtx
+            void insert_key(KEY_TYPE key, const ValueType& value) {
+                auto [row, col] = key_to_row_col(key);
+                if(buckets.assign(row, col, value) || table.assign(key, value)) return;
+                entries[key] = value;
+            }
+
+            // Removes and returns the entries of the table and the map. Caller holds mtx
+            std::vector<std::pair<KEY_TYPE, ValueType>> drain_unbucketed() {
+                std::vector<std::pair<KEY_TYPE, ValueType>> pending(entries.begin(), entries.end());
+                std::vector<KEY_TYPE> keys(table.size());
+                std::vector<ValueType> values(keys.size());
+                size_t count = table.extract(keys.data(), values.data(), [](const ValueType&) { return true; });
+                for(size_t k = 0; k < count; k++) pending.emplace_back(keys[k], values[k]);
+                entries.clear();
+                table.reset();
+                return pending;
+            }
             // mutex lock
             std::mutex mtx;
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "utils.h"
+
+namespace puff {
+
+    // Which entries make_matrix drops on top of exact zeros
+    enum class DropRule {
+        None,
+        Absolute,         // |a_ij| < tolerance
+        RowRelative,      // |a_ij| < tolerance * ||a_i||_2
+        DiagonalRelative, // |a_ij| < tolerance * |a_ii|, rows without a diagonal keep everything
+        TopK              // all but the top_k largest |a_ij| of each row
+    };
+
+    struct DropPolicy {
+        DropRule rule = DropRule::None;
+        double tolerance = 0.0;
+        size_t top_k = 0;
+        bool keep_diagonal = true; // the diagonal is never dropped and does not count towards top_k
+    };
+
+    // What a drop policy removed: nnz reduction and Frobenius norm of the dropped part
+    struct DropReport {
+        size_t kept_entries = 0, dropped_entries = 0;
+        double kept_norm = 0.0, dropped_norm = 0.0; // Frobenius norms of the kept and dropped parts
+
+        // ||dropped||_F / ||A||_F
+        double relative_dropped_norm() const {
+            const double total = std::sqrt(kept_norm * kept_norm + dropped_norm * dropped_norm);
+            return total > 0 ? dropped_norm / total : 0.0;
+        }
+    };
+
+    // Marks the entries of a sorted CSR matrix that policy keeps (keep[k] = 1), rows in parallel
+    template<typename ValueType, typename IndexType>
+    DropReport Drop_entries(const DropPolicy& policy,
+                            size_t num_rows,
+                            const IndexType* row_offsets,
+                            const IndexType* column_indices,
+                            const ValueType* values,
+                            uint8_t* keep);
+
+}
+
+#include "details/Sparsification.inl"
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "utils.h"
+#include <cstdlib>
+#include <new>
+
+namespace puff {
+
+    // Storage layout of complex vectors inside a solve
+    enum class ComplexStorage {
+        Interleaved, // (re, im, re, im, ...) as in Vector<thrust::complex<Real>>
+        Split        // separate aligned real and imaginary planes, SplitVector<Real>
+    };
+
+    // Allocator returning Alignment-byte aligned blocks so planes start on a cache line / SIMD boundary
+    template<typename T, size_t Alignment = 64>
+    struct AlignedAllocator {
+        using value_type = T;
+        template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() = default;
+        template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(size_t n) {
+            size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+            void* ptr = std::aligned_alloc(Alignment, std::max(bytes, Alignment));
+            if(ptr == nullptr) throw std::bad_alloc();
+            return static_cast<T*>(ptr);
+        }
+        void deallocate(T* ptr, size_t) { std::free(ptr); }
+
+        template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+        template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+    };
+
+    // Non-owning view of a split complex array, e.g. over the planes of a SplitVector or external buffers
+    template<typename Real>
+    struct SplitSpan {
+        Real* re = nullptr;
+        Real* im = nullptr;
+        size_t n = 0;
+
+        size_t size() const { return n; }
+        thrust::complex<Real> get(size_t i) const { return thrust::complex<Real>(re[i], im[i]); }
+        void set(size_t i, const thrust::complex<Real>& v) const { re[i] = v.real(); im[i] = v.imag(); }
+    };
+
+    // Split-complex (structure of arrays) host vector, the SIMD friendly counterpart of Vector_h<thrust::complex<Real>>
+    template<typename Real>
+    class SplitVector {
+        public:
+            using value_type = thrust::complex<Real>;
+
+            SplitVector() {}
+            explicit SplitVector(size_t n, value_type value = value_type(0, 0)) { assign(n, value); }
+
+            // Conversion from interleaved storage
+            explicit SplitVector(const Vector<value_type, cusp::host_memory>& v) { from_interleaved(v); }
+
+            size_t size() const { return re.size(); }
+
+            void resize(size_t n) {
+                re.resize(n);
+                im.resize(n);
+            }
+
+            void assign(size_t n, value_type value) {
+                re.assign(n, value.real());
+                im.assign(n, value.imag());
+            }
+
+            Real* real_data() { return re.data(); }
+            Real* imag_data() { return im.data(); }
+            const Real* real_data() const { return re.data(); }
+            const Real* imag_data() const { return im.data(); }
+
+            value_type get(size_t i) const { return value_type(re[i], im[i]); }
+            void set(size_t i, const value_type& v) { re[i] = v.real(); im[i] = v.imag(); }
+
+            SplitSpan<Real> view() { return {re.data(), im.data(), re.size()}; }
+            SplitSpan<const Real> view() const { return {re.data(), im.data(), re.size()}; }
+
+            void from_interleaved(const value_type* v, size_t n) {
+                resize(n);
+                #pragma omp parallel for simd
+                for(long long i = 0; i < (long long)n; i++)
+                {
+                    re[i] = v[i].real();
+                    im[i] = v[i].imag();
+                }
+            }
+
+            void from_interleaved(const Vector<value_type, cusp::host_memory>& v) {
+                from_interleaved(thrust::raw_pointer_cast(v.data()), v.size());
+            }
+
+            void to_interleaved(value_type* v) const {
+                #pragma omp parallel for simd
+                for(long long i = 0; i < (long long)size(); i++)
+                    v[i] = value_type(re[i], im[i]);
+            }
+
+            void to_interleaved(Vector<value_type, cusp::host_memory>& v) const {
+                v.resize(size());
+                to_interleaved(thrust::raw_pointer_cast(v.data()));
+            }
+
+            void swap(SplitVector& other) {
+                re.swap(other.re);
+                im.swap(other.im);
+            }
+
+        private:
+            std::vector<Real, AlignedAllocator<Real>> re, im;
+    };
+
+    // BLAS-1 on split vectors, the complex products become independent real FMAs per plane
+
+    // y = a * x + y
+    template<typename Real>
+    void Split_axpy(thrust::complex<Real> a, const SplitVector<Real>& x, SplitVector<Real>& y) {
+        const Real ar = a.real(), ai = a.imag();
+        const Real* xr = x.real_data(); const Real* xi = x.imag_data();
+        Real* yr = y.real_data(); Real* yi = y.imag_data();
+        #pragma omp parallel for simd
+        for(long long i = 0; i < (long long)x.size(); i++)
+        {
+            yr[i] += ar * xr[i] - ai * xi[i];
+            yi[i] += ar * xi[i] + ai * xr[i];
+        }
+    }
+
+    // x = a * x
+    template<typename Real>
+    void Split_scal(thrust::complex<Real> a, SplitVector<Real>& x) {
+        const Real ar = a.real(), ai = a.imag();
+        Real* xr = x.real_data(); Real* xi = x.imag_data();
+        #pragma omp parallel for simd
+        for(long long i = 0; i < (long long)x.size(); i++)
+        {
+            Real r = xr[i];
+            xr[i] = ar * r - ai * xi[i];
+            xi[i] = ar * xi[i] + ai * r;
+        }
+    }
+
+    // sum conj(x_i) y_i, or sum x_i y_i when conjugate is false
+    template<typename Real>
+    thrust::complex<Real> Split_dot(const SplitVector<Real>& x, const SplitVector<Real>& y, bool conjugate = true) {
+        const Real s = conjugate ? Real(-1) : Real(1);
+        const Real* xr = x.real_data(); const Real* xi = x.imag_data();
+        const Real* yr = y.real_data(); const Real* yi = y.imag_data();
+        Real sr = 0, si = 0;
+        #pragma omp parallel for simd reduction(+:sr, si)
+        for(long long i = 0; i < (long long)x.size(); i++)
+        {
+            sr += xr[i] * yr[i] - s * xi[i] * yi[i];
+            si += xr[i] * yi[i] + s * xi[i] * yr[i];
+        }
+        return thrust::complex<Real>(sr, si);
+    }
+
+    template<typename Real>
+    Real Split_nrm2(const SplitVector<Real>& x) {
+        const Real* xr = x.real_data(); const Real* xi = x.imag_data();
+        Real sum = 0;
+        #pragma omp parallel for simd reduction(+:sum)
+        for(long long i = 0; i < (long long)x.size(); i++)
+            sum += xr[i] * xr[i] + xi[i] * xi[i];
+        return std::sqrt(sum);
+    }
+
+    // Pointwise product c = a .* b, the spectral multiply of the FFT convolutions
+    template<typename Real>
+    void Vector_element_wise_multiply_Vector(const SplitVector<Real>& a, const SplitVector<Real>& b, SplitVector<Real>& c) {
+        c.resize(a.size());
+        const Real* ar = a.real_data(); const Real* ai = a.imag_data();
+        const Real* br = b.real_data(); const Real* bi = b.imag_data();
+        Real* cr = c.real_data(); Real* ci = c.imag_data();
+        #pragma omp parallel for simd
+        for(long long i = 0; i < (long long)a.size(); i++)
+        {
+            Real r = ar[i] * br[i] - ai[i] * bi[i];
+            ci[i] = ar[i] * bi[i] + ai[i] * br[i];
+            cr[i] = r;
+        }
+    }
+
+    // y = A x for a CSR matrix whose values are split into real / imaginary planes, conjugate uses conj(A)
+    template<typename IndexType, typename Real>
+    void Split_SpMV(size_t num_rows,
+                    const IndexType* row_offsets,
+                    const IndexType* column_indices,
+                    const Real* values_re, const Real* values_im,
+                    const Real* x_re, const Real* x_im,
+                    Real* y_re, Real* y_im,
+                    bool conjugate = false) {
+        const Real s = conjugate ? Real(-1) : Real(1);
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)num_rows; i++)
+        {
+            Real sr = 0, si = 0;
+            #pragma omp simd reduction(+:sr, si)
+            for(IndexType k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+            {
+                const IndexType j = column_indices[k];
+                const Real ar = values_re[k], ai = s * values_im[k];
+                sr += ar * x_re[j] - ai * x_im[j];
+                si += ar * x_im[j] + ai * x_re[j];
+            }
+            y_re[i] = sr;
+            y_im[i] = si;
+        }
+    }
+
+
+    // Restarted GMRES (modified Gram-Schmidt, Givens rotations) with the iterate, the residual and the Krylov basis
+    // kept split for the whole solve, the loop of cusp::krylov::gmres without preconditioner.
+    // A(u, v) computes v = A u on split vectors, monitor is a cusp::monitor on the right-hand side
+    template<typename Real, typename Operator, typename Monitor>
+    void Split_gmres(Operator& A, SplitVector<Real>& x, const SplitVector<Real>& b, size_t restart, Monitor& monitor) {
+        typedef thrust::complex<Real> Complex;
+        const size_t R = std::max(restart, (size_t)1);
+        std::vector<SplitVector<Real>> V(R + 1);
+        SplitVector<Real> w;
+        std::vector<Complex> H((R + 1) * R), s(R + 1), sn(R);
+        std::vector<Real> cs(R);
+        cusp::array1d<Real, cusp::host_memory> resid(1);
+        do
+        {
+            // r = b - A x
+            A(x, w);
+            Split_scal(Complex(-1), w);
+            Split_axpy(Complex(1), b, w);
+            const Real beta = Split_nrm2(w);
+            resid[0] = beta;
+            if(beta == Real(0))
+            {
+                monitor.finished(resid);
+                break;
+            }
+            V[0].swap(w);
+            Split_scal(Complex(Real(1) / beta), V[0]);
+            std::fill(s.begin(), s.end(), Complex(0));
+            s[0] = beta;
+            size_t i = 0;
+            for(; i < R; i++)
+            {
+                ++monitor;
+                A(V[i], w);
+                Complex* h = H.data() + i * (R + 1);
+                for(size_t k = 0; k <= i; k++)
+                {
+                    h[k] = Split_dot(V[k], w);
+                    Split_axpy(-h[k], V[k], w);
+                }
+                const Real norm = Split_nrm2(w);
+                h[i + 1] = norm;
+                V[i + 1].swap(w);
+                if(norm != Real(0)) Split_scal(Complex(Real(1) / norm), V[i + 1]);
+                // Previous rotations, then the one zeroing h[i + 1]
+                for(size_t k = 0; k < i; k++)
+                {
+                    const Complex t = cs[k] * h[k] + sn[k] * h[k + 1];
+                    h[k + 1] = -thrust::conj(sn[k]) * h[k] + cs[k] * h[k + 1];
+                    h[k] = t;
+                }
+                const Real a = thrust::abs(h[i]), t = std::hypot(a, norm);
+                if(t == Real(0)) { cs[i] = 1; sn[i] = 0; }
+                else if(a == Real(0)) { cs[i] = 0; sn[i] = 1; }
+                else { cs[i] = a / t; sn[i] = h[i] / a * (norm / t); }
+                h[i] = cs[i] * h[i] + sn[i] * h[i + 1];
+                h[i + 1] = 0;
+                s[i + 1] = -thrust::conj(sn[i]) * s[i];
+                s[i] = cs[i] * s[i];
+                resid[0] = thrust::abs(s[i + 1]);
+                if(monitor.finished(resid)) { i++; break; }
+            }
+            // x += V y with H y = s (upper triangular, i columns)
+            for(size_t k = i; k-- > 0;)
+            {
+                for(size_t j = k + 1; j < i; j++) s[k] -= H[j * (R + 1) + k] * s[j];
+                s[k] /= H[k * (R + 1) + k];
+                Split_axpy(s[k], V[k], x);
+            }
+        } while(!monitor.finished(resid));
+    }
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "utils.h"
+#include "MappedFile.h"
+#include "mkl_service.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace puff {
+
+    // One (K0, Kx, Ky) point of a frequency / Bloch sweep, index is its position in the caller's list
+    template<typename T>
+    struct SweepPoint {
+        T K0 = 0, Kx = 0, Ky = 0;
+        size_t index = 0;
+    };
+
+    // Passed to the task: which group runs it and the point this group finished just before,
+    // nullptr at the start of a block, so solutions can be warm started from neighbours
+    template<typename T>
+    struct SweepContext {
+        int group = 0;
+        int threads = 1;
+        const SweepPoint<T>* previous = nullptr;
+    };
+
+    // Serpentine order over (Ky, Kx, K0): sorted by Ky, Kx and K0 with the inner sweeps
+    // alternating direction, so consecutive points differ in a single coordinate step
+    template<typename T>
+    void Sweep_serpentine_order(std::vector<SweepPoint<T>>& points) {
+        std::sort(points.begin(), points.end(), [](const SweepPoint<T>& a, const SweepPoint<T>& b) {
+            if(a.Ky != b.Ky) return a.Ky < b.Ky;
+            if(a.Kx != b.Kx) return a.Kx < b.Kx;
+            return a.K0 < b.K0;
+        });
+
+        std::vector<SweepPoint<T>> ordered;
+        ordered.reserve(points.size());
+        size_t line = 0;
+        for(size_t ky_begin = 0, ky_index = 0; ky_begin < points.size(); ky_index++)
+        {
+            size_t ky_end = ky_begin;
+            while(ky_end < points.size() && points[ky_end].Ky == points[ky_begin].Ky) ky_end++;
+
+            // Runs of equal Kx inside this Ky slab
+            std::vector<std::pair<size_t, size_t>> runs;
+            for(size_t b = ky_begin; b < ky_end;)
+            {
+                size_t e = b;
+                while(e < ky_end && points[e].Kx == points[b].Kx) e++;
+                runs.emplace_back(b, e);
+                b = e;
+            }
+            if(ky_index % 2) std::reverse(runs.begin(), runs.end());
+
+            for(auto& run : runs)
+            {
+                if(line++ % 2) ordered.insert(ordered.end(), points.rbegin() + (points.size() - run.second), points.rbegin() + (points.size() - run.first));
+                else ordered.insert(ordered.end(), points.begin() + run.first, points.begin() + run.second);
+            }
+            ky_begin = ky_end;
+        }
+        points.swap(ordered);
+    }
+
+    // Runs independent sweep points on groups of threads. Each group is a std::thread whose nested
+    // OpenMP and MKL parallelism is limited to threads_per_group, so serial parts of one point overlap
+    // with other points instead of idling the machine. Points are handed out dynamically in contiguous
+    // blocks of the serpentine order, so a group walks neighbouring points and can reuse warm-start data.
+    // Read-only artifacts (geometry, interaction lists, mapped patterns) are shared by all groups.
+    template<typename T>
+    class SweepScheduler {
+        public:
+            // groups = 0 picks one group per 4 hardware threads, threads_per_group = 0 splits the remaining threads evenly
+            SweepScheduler(int groups = 0, int threads_per_group = 0, size_t block_size = 0)
+                : block_size(block_size) {
+                int hardware = std::max(1, omp_get_max_threads());
+                this->groups = groups > 0 ? groups : std::max(1, hardware / 4);
+                this->threads_per_group = threads_per_group > 0 ? threads_per_group : std::max(1, hardware / this->groups);
+            }
+
+            void set_points(const std::vector<SweepPoint<T>>& sweep, bool serpentine = true) {
+                points = sweep;
+                if(serpentine) Sweep_serpentine_order(points);
+            }
+
+            // Cartesian product of K0 x Kx x Ky, indices follow the nesting of the arguments (K0 fastest)
+            void set_grid(const std::vector<T>& K0s, const std::vector<T>& Kxs, const std::vector<T>& Kys) {
+                std::vector<SweepPoint<T>> sweep;
+                sweep.reserve(K0s.size() * Kxs.size() * Kys.size());
+                for(size_t j = 0; j < Kys.size(); j++)
+                    for(size_t i = 0; i < Kxs.size(); i++)
+                        for(size_t k = 0; k < K0s.size(); k++)
+                            sweep.push_back({K0s[k], Kxs[i], Kys[j], (j * Kxs.size() + i) * K0s.size() + k});
+                set_points(sweep);
+            }
+
+            const std::vector<SweepPoint<T>>& get_points() const { return points; }
+
+            // task(point, context, shared) is called once per point from the group's thread
+            template<typename Shared, typename Task>
+            void run(std::shared_ptr<Shared> shared, const Task& task) {
+                const size_t block = block_size > 0 ? block_size
+                                   : std::max<size_t>(1, points.size() / (4 * (size_t)groups));
+                const size_t num_blocks = (points.size() + block - 1) / block;
+                std::atomic<size_t> next_block(0);
+                std::exception_ptr error;
+                std::mutex error_mutex;
+                group_points.assign(groups, 0);
+
+                auto start = std::chrono::steady_clock::now();
+                std::vector<std::thread> workers;
+                for(int g = 0; g < groups; g++)
+                {
+                    workers.emplace_back([&, g]() {
+                        // Limits apply to parallel regions and MKL calls issued from this thread only
+                        omp_set_num_threads(threads_per_group);
+                        mkl_set_num_threads_local(threads_per_group);
+                        SweepContext<T> context;
+                        context.group = g;
+                        context.threads = threads_per_group;
+                        try
+                        {
+                            for(size_t b = next_block++; b < num_blocks; b = next_block++)
+                            {
+                                context.previous = nullptr;
+                                for(size_t p = b * block; p < std::min(points.size(), (b + 1) * block); p++)
+                                {
+                                    task(points[p], context, *shared);
+                                    context.previous = &points[p];
+                                    group_points[g]++;
+                                }
+                            }
+                        }
+                        catch(...)
+                        {
+                            std::lock_guard<std::mutex> lock(error_mutex);
+                            if(!error) error = std::current_exception();
+                            next_block = num_blocks;
+                        }
+                        mkl_set_num_threads_local(0);
+                    });
+                }
+                for(auto& worker : workers) worker.join();
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if(error) std::rethrow_exception(error);
+            }
+
+            // Overload without shared artifacts
+            void run(const std::function<void(const SweepPoint<T>&, const SweepContext<T>&)>& task) {
+                run(std::make_shared<const int>(0),
+                    [&task](const SweepPoint<T>& point, const SweepContext<T>& context, const int&) { task(point, context); });
+            }
+
+            int get_groups() const { return groups; }
+            int get_threads_per_group() const { return threads_per_group; }
+            double get_elapsed_seconds() const { return elapsed; }
+            const std::vector<size_t>& get_group_points() const { return group_points; }
+
+            double get_points_per_hour() const {
+                size_t done = 0;
+                for(auto count : group_points) done += count;
+                return elapsed > 0 ? 3600.0 * done / elapsed : 0;
+            }
+
+            void report(FILE* out = stdout) const {
+                fprintf(out, "Sweep: %zu points on %d groups x %d threads in %f s, %.1f points/hour\n",
+                        points.size(), groups, threads_per_group, elapsed, get_points_per_hour());
+            }
+
+        private:
+            int groups, threads_per_group;
+            size_t block_size;
+            std::vector<SweepPoint<T>> points;
+            std::vector<size_t> group_points;
+            double elapsed = 0;
+    };
+
+    // Read-only file mapping shared across sweep groups (e.g. a precomputed sparsity pattern)
+    inline std::shared_ptr<const MappedFile> Sweep_share_file(const std::string& path) {
+        return std::make_shared<const MappedFile>(path);
+    }
+
+}
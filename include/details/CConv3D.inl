@@ -1,8 +1,56 @@
 // Thrust-based host/device elementwise multiplication
 namespace puff{
 
+template<typename ValueType>
+void FFT3D<ValueType, cusp::host_memory>::plan(size_t nx_, size_t ny_, size_t nz_)
+{
+    static_assert(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>,
+                  "FFT3D_h supports dcomplex and fcomplex only");
+    destroy();
+    nx = nx_; ny = ny_; nz = nz_;
 
+    // Unit dimensions are dropped so 1D/2D transforms use a lower rank descriptor
+    MKL_LONG lengths[3];
+    MKL_LONG rank = 0;
+    for(size_t n : {nx, ny, nz})
+        if(n > 1) lengths[rank++] = (MKL_LONG)n;
+    if(rank == 0) return;
 
+    constexpr auto precision = std::is_same_v<ValueType, dcomplex> ? DFTI_DOUBLE : DFTI_SINGLE;
+    if(rank == 1) {
+        CHECK_DFTI(DftiCreateDescriptor(&handle, precision, DFTI_COMPLEX, 1, lengths[0]));
+    }
+    else {
+        CHECK_DFTI(DftiCreateDescriptor(&handle, precision, DFTI_COMPLEX, rank, lengths));
+    }
+    CHECK_DFTI(DftiSetValue(handle, DFTI_PLACEMENT, DFTI_INPLACE));
+    CHECK_DFTI(DftiCommitDescriptor(handle));
+}
 
+template<typename ValueType>
+void FFT3D<ValueType, cusp::host_memory>::forward(Vector<ValueType, cusp::host_memory>& data)
+{
+    assert(data.size() == size());
+    if(handle == nullptr) return;
+    CHECK_DFTI(DftiComputeForward(handle, thrust::raw_pointer_cast(data.data())));
+}
+
+template<typename ValueType>
+void FFT3D<ValueType, cusp::host_memory>::backward(Vector<ValueType, cusp::host_memory>& data)
+{
+    assert(data.size() == size());
+    if(handle == nullptr) return;
+    CHECK_DFTI(DftiComputeBackward(handle, thrust::raw_pointer_cast(data.data())));
+}
+
+template<typename ValueType>
+void FFT3D<ValueType, cusp::host_memory>::destroy()
+{
+    if(handle != nullptr)
+    {
+        DftiFreeDescriptor(&handle);
+        handle = nullptr;
+    }
+}
 
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+// Row / column equilibration of sparse matrices
+namespace puff{
+
+namespace detail{
+
+// Infinity norms of the rows and columns of D_r A D_c. Rows run by the blocks of the transpose plan: the blocks
+// of one color have disjoint column ranges and update the column maxima directly, other plans take an atomic
+// max per column in column_max (nonnegative doubles order like their bit patterns)
+template<typename ValueType, typename IndexType, typename Real>
+void scaled_norms(const TransposePlan<IndexType>& plan,
+                  size_t num_rows,
+                  size_t num_cols,
+                  const IndexType* row_offsets,
+                  const IndexType* column_indices,
+                  const ValueType* values,
+                  const std::vector<Real>& row_scale,
+                  const std::vector<Real>& col_scale,
+                  std::vector<double>& row_norm,
+                  std::vector<double>& col_norm,
+                  std::vector<std::atomic<uint64_t>>& column_max)
+{
+    row_norm.assign(num_rows, 0.0);
+    col_norm.assign(num_cols, 0.0);
+    auto rows = [&](IndexType first, IndexType last, auto update) {
+        for(IndexType i = first; i < last; i++)
+        {
+            double norm = 0.0;
+            for(IndexType k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+            {
+                const double m = (double)row_scale[i] * col_scale[column_indices[k]] * drop_magnitude(values[k]);
+                norm = std::max(norm, m);
+                update(column_indices[k], m);
+            }
+            row_norm[i] = norm;
+        }
+    };
+
+    if(plan.strategy == TransposeStrategy::Coloring)
+    {
+        for(size_t c = 0; c < plan.num_colors(); c++)
+        {
+            #pragma omp parallel for num_threads(plan.threads) schedule(dynamic)
+            for(int p = plan.color_offsets[c]; p < plan.color_offsets[c + 1]; p++)
+            {
+                const int b = plan.color_blocks[p];
+                rows(plan.block_rows[b], plan.block_rows[b + 1], [&](IndexType j, double m) { col_norm[j] = std::max(col_norm[j], m); });
+            }
+        }
+        return;
+    }
+
+    if(column_max.size() != num_cols) column_max = std::vector<std::atomic<uint64_t>>(num_cols);
+    #pragma omp parallel num_threads(plan.threads)
+    {
+        #pragma omp for schedule(static)
+        for(long long j = 0; j < (long long)num_cols; j++) column_max[j].store(0, std::memory_order_relaxed);
+        #pragma omp for schedule(dynamic)
+        for(long long b = 0; b < (long long)plan.block_rows.size() - 1; b++)
+            rows(plan.block_rows[b], plan.block_rows[b + 1], [&](IndexType j, double m) {
+                uint64_t bits, current = column_max[j].load(std::memory_order_relaxed);
+                std::memcpy(&bits, &m, sizeof(bits));
+                while(bits > current && !column_max[j].compare_exchange_weak(current, bits, std::memory_order_relaxed)) {}
+            });
+        #pragma omp for schedule(static)
+        for(long long j = 0; j < (long long)num_cols; j++)
+        {
+            const uint64_t bits = column_max[j].load(std::memory_order_relaxed);
+            std::memcpy(&col_norm[j], &bits, sizeof(bits));
+        }
+    }
+}
+
+// max / min of the nonzero norms
+inline double norm_spread(const std::vector<double>& norm)
+{
+    double lo = std::numeric_limits<double>::max(), hi = 0.0;
+    for(double n : norm)
+        if(n > 0) { lo = std::min(lo, n); hi = std::max(hi, n); }
+    return hi > 0 ? hi / lo : 1.0;
+}
+
+} // namespace detail
+
+template<typename ValueType, typename IndexType, typename Real>
+EquilibrationReport Equilibrate(EquilibrationMethod method,
+                                size_t num_rows,
+                                size_t num_cols,
+                                const IndexType* row_offsets,
+                                const IndexType* column_indices,
+                                const ValueType* values,
+                                std::vector<Real>& row_scale,
+                                std::vector<Real>& col_scale,
+                                size_t max_sweeps,
+                                double tolerance)
+{
+    EquilibrationReport report;
+    report.method = method;
+    row_scale.assign(num_rows, Real(1));
+    col_scale.assign(num_cols, Real(1));
+    // One plan and column workspace for all sweeps
+    const auto plan = make_transpose_plan<ValueType>(num_rows, num_cols, row_offsets, column_indices);
+    std::vector<std::atomic<uint64_t>> column_max;
+    std::vector<double> row_norm, col_norm;
+    auto norms = [&]() {
+        detail::scaled_norms(plan, num_rows, num_cols, row_offsets, column_indices, values, row_scale, col_scale, row_norm, col_norm, column_max);
+    };
+    norms();
+    report.row_spread_before = detail::norm_spread(row_norm);
+    report.col_spread_before = detail::norm_spread(col_norm);
+
+    auto inverse = [](double norm, double power) { return norm > 0 ? Real(std::pow(norm, -power)) : Real(1); };
+    if(method == EquilibrationMethod::RowColumn)
+    {
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)num_rows; i++) row_scale[i] = inverse(row_norm[i], 1.0);
+        norms();
+        #pragma omp parallel for schedule(static)
+        for(long long j = 0; j < (long long)num_cols; j++) col_scale[j] = inverse(col_norm[j], 1.0);
+        report.sweeps = 1;
+    }
+    else if(method == EquilibrationMethod::Ruiz)
+    {
+        // D_r <- D_r / sqrt(row norms), D_c <- D_c / sqrt(column norms), converges to unit norms
+        for(; report.sweeps < max_sweeps; report.sweeps++)
+        {
+            double deviation = 0.0;
+            for(double n : row_norm) if(n > 0) deviation = std::max(deviation, std::abs(1.0 - n));
+            for(double n : col_norm) if(n > 0) deviation = std::max(deviation, std::abs(1.0 - n));
+            if(deviation <= tolerance) break;
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)num_rows; i++) row_scale[i] *= inverse(row_norm[i], 0.5);
+            #pragma omp parallel for schedule(static)
+            for(long long j = 0; j < (long long)num_cols; j++) col_scale[j] *= inverse(col_norm[j], 0.5);
+            norms();
+        }
+    }
+
+    if(method != EquilibrationMethod::Ruiz)
+        norms();
+    report.row_spread_after = detail::norm_spread(row_norm);
+    report.col_spread_after = detail::norm_spread(col_norm);
+    return report;
+}
+
+}
@@ -0,0 +1,571 @@
+// Short-recurrence Krylov solvers with fused vector updates
+namespace puff{
+
+namespace detail{
+
+template<typename T>
+struct is_identity_operator : std::false_type {};
+
+template<typename ValueType, typename MemorySpace, typename IndexType>
+struct is_identity_operator<cusp::identity_operator<ValueType, MemorySpace, IndexType>> : std::true_type {};
+
+// Sum of f(i) over [0, n), per-thread partial sums added in thread order so results do not depend on the schedule.
+// f may update vectors at i on the way, which is how the sweeps fuse their axpys with the next dot product
+template<typename ValueType, typename F>
+ValueType krylov_reduce(size_t n, F f)
+{
+    const int threads = omp_get_max_threads();
+    std::vector<ValueType> partial(threads, ValueType(0));
+    #pragma omp parallel num_threads(threads)
+    {
+        ValueType sum(0);
+        #pragma omp for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+            sum += f((size_t)i);
+        partial[omp_get_thread_num()] = sum;
+    }
+    ValueType total(0);
+    for(const ValueType& sum : partial) total += sum;
+    return total;
+}
+
+// Unconjugated x^T y
+template<typename ValueType>
+ValueType krylov_dot(size_t n, const ValueType* x, const ValueType* y)
+{
+    return krylov_reduce<ValueType>(n, [&](size_t i) { return x[i] * y[i]; });
+}
+
+// r = b - A x
+template<typename LinearOperator, typename Array>
+void krylov_residual(LinearOperator& A, const Array& x, const Array& b, Array& r)
+{
+    cusp::multiply(A, x, r);
+    auto* pr = thrust::raw_pointer_cast(r.data());
+    const auto* pb = thrust::raw_pointer_cast(b.data());
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)r.size(); i++)
+        pr[i] = pb[i] - pr[i];
+}
+
+template<typename ValueType>
+ValueType krylov_conj(const ValueType& v)
+{
+    if constexpr(std::is_arithmetic_v<ValueType>) return v;
+    else return ValueType(v.real(), -v.imag());
+}
+
+template<typename ValueType>
+auto krylov_real(const ValueType& v)
+{
+    if constexpr(std::is_arithmetic_v<ValueType>) return v;
+    else return v.real();
+}
+
+template<typename ValueType>
+auto krylov_abs2(const ValueType& v)
+{
+    if constexpr(std::is_arithmetic_v<ValueType>) return v * v;
+    else return v.real() * v.real() + v.imag() * v.imag();
+}
+
+// m sums over [0, n) in one pass, f(i, sums) adds the contributions of i
+template<typename ValueType, typename F>
+void krylov_reduce_n(size_t n, size_t m, ValueType* out, F f)
+{
+    const int threads = omp_get_max_threads();
+    std::vector<ValueType> partial((size_t)threads * m, ValueType(0));
+    #pragma omp parallel num_threads(threads)
+    {
+        ValueType* sums = partial.data() + (size_t)omp_get_thread_num() * m;
+        #pragma omp for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+            f((size_t)i, sums);
+    }
+    std::fill(out, out + m, ValueType(0));
+    for(int t = 0; t < threads; t++)
+        for(size_t k = 0; k < m; k++) out[k] += partial[(size_t)t * m + k];
+}
+
+// Conjugated x^H y
+template<typename ValueType>
+ValueType krylov_cdot(size_t n, const ValueType* x, const ValueType* y)
+{
+    return krylov_reduce<ValueType>(n, [&](size_t i) { return krylov_conj(x[i]) * y[i]; });
+}
+
+// Solves the small dense system a z = rhs in place (row-major m x m, partial pivoting), false when singular
+template<typename ValueType>
+bool krylov_solve_small(size_t m, std::vector<ValueType> a, std::vector<ValueType>& rhs)
+{
+    for(size_t k = 0; k < m; k++)
+    {
+        size_t p = k;
+        for(size_t i = k + 1; i < m; i++)
+            if(krylov_abs2(a[i * m + k]) > krylov_abs2(a[p * m + k])) p = i;
+        if(a[p * m + k] == ValueType(0)) return false;
+        for(size_t j = 0; j < m; j++) std::swap(a[k * m + j], a[p * m + j]);
+        std::swap(rhs[k], rhs[p]);
+        for(size_t i = k + 1; i < m; i++)
+        {
+            const ValueType f = a[i * m + k] / a[k * m + k];
+            for(size_t j = k; j < m; j++) a[i * m + j] -= f * a[k * m + j];
+            rhs[i] -= f * rhs[k];
+        }
+    }
+    for(size_t k = m; k-- > 0;)
+    {
+        for(size_t j = k + 1; j < m; j++) rhs[k] -= a[k * m + j] * rhs[j];
+        rhs[k] /= a[k * m + k];
+    }
+    return true;
+}
+
+// out = A M v, workspace holds M v
+template<typename LinearOperator, typename Preconditioner, typename Array>
+void krylov_right_product(LinearOperator& A, Preconditioner& M, const Array& v, Array& workspace, Array& out)
+{
+    if constexpr(is_identity_operator<Preconditioner>::value)
+        cusp::multiply(A, v, out);
+    else
+    {
+        cusp::multiply(M, v, workspace);
+        cusp::multiply(A, workspace, out);
+    }
+}
+
+} // namespace detail
+
+template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+void cocg(LinearOperator& A, Array& x, const Array& b, Monitor& monitor, Preconditioner& M)
+{
+    typedef typename Array::value_type ValueType;
+    constexpr bool identity = detail::is_identity_operator<Preconditioner>::value;
+    const size_t n = A.num_rows;
+    Array r(n), p(n), q(n), z(identity ? 0 : n);
+    detail::krylov_residual(A, x, b, r);
+    if constexpr(!identity) cusp::multiply(M, r, z);
+    const Array& zr = identity ? r : z;
+    thrust::copy(zr.begin(), zr.end(), p.begin());
+
+    ValueType* px = thrust::raw_pointer_cast(x.data());
+    ValueType* pr = thrust::raw_pointer_cast(r.data());
+    ValueType* pp = thrust::raw_pointer_cast(p.data());
+    ValueType* pq = thrust::raw_pointer_cast(q.data());
+    const ValueType* pz = thrust::raw_pointer_cast(zr.data());
+    ValueType rho = detail::krylov_dot(n, pr, pz);
+
+    while(!monitor.finished(r))
+    {
+        cusp::multiply(A, p, q);
+        const ValueType pAp = detail::krylov_dot(n, pp, pq);
+        if(pAp == ValueType(0)) break; // quasi-null p, the bilinear form broke down
+        const ValueType alpha = rho / pAp;
+
+        // x += alpha p, r -= alpha q and, without preconditioner, r^T r in the same pass
+        ValueType rho_next = detail::krylov_reduce<ValueType>(n, [&](size_t i) {
+            px[i] += alpha * pp[i];
+            pr[i] -= alpha * pq[i];
+            return identity ? pr[i] * pr[i] : ValueType(0);
+        });
+        if constexpr(!identity)
+        {
+            cusp::multiply(M, r, z);
+            rho_next = detail::krylov_dot(n, pr, pz);
+        }
+
+        const ValueType beta = rho_next / rho;
+        rho = rho_next;
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+            pp[i] = pz[i] + beta * pp[i];
+        ++monitor;
+    }
+}
+
+template<typename LinearOperator, typename Array, typename Monitor>
+void cocg(LinearOperator& A, Array& x, const Array& b, Monitor& monitor)
+{
+    typedef typename Array::value_type ValueType;
+    typedef typename Array::memory_space MemorySpace;
+    cusp::identity_operator<ValueType, MemorySpace> M(A.num_rows, A.num_rows);
+    cocg(A, x, b, monitor, M);
+}
+
+template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+void cocr(LinearOperator& A, Array& x, const Array& b, Monitor& monitor, Preconditioner& M)
+{
+    typedef typename Array::value_type ValueType;
+    constexpr bool identity = detail::is_identity_operator<Preconditioner>::value;
+    const size_t n = A.num_rows;
+    // z = M r and u = M q alias r and q without preconditioner
+    Array r(n), p(n), q(n), w(n), z(identity ? 0 : n), u(identity ? 0 : n);
+    detail::krylov_residual(A, x, b, r);
+    if constexpr(!identity) cusp::multiply(M, r, z);
+    Array& zr = identity ? r : z;
+    Array& uq = identity ? q : u;
+    thrust::copy(zr.begin(), zr.end(), p.begin());
+    cusp::multiply(A, p, w);
+    thrust::copy(w.begin(), w.end(), q.begin());
+    if constexpr(!identity) cusp::multiply(M, q, u);
+
+    ValueType* px = thrust::raw_pointer_cast(x.data());
+    ValueType* pr = thrust::raw_pointer_cast(r.data());
+    ValueType* pp = thrust::raw_pointer_cast(p.data());
+    ValueType* pq = thrust::raw_pointer_cast(q.data());
+    ValueType* pw = thrust::raw_pointer_cast(w.data());
+    ValueType* pz = thrust::raw_pointer_cast(zr.data());
+    const ValueType* pu = thrust::raw_pointer_cast(uq.data());
+    ValueType zAz = detail::krylov_dot(n, pz, pw);
+    ValueType qMq = detail::krylov_dot(n, pq, pu);
+
+    while(!monitor.finished(r))
+    {
+        if(qMq == ValueType(0)) break;
+        const ValueType alpha = zAz / qMq;
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+        {
+            px[i] += alpha * pp[i];
+            pr[i] -= alpha * pq[i];
+            if constexpr(!identity) pz[i] -= alpha * pu[i];
+        }
+
+        cusp::multiply(A, zr, w);
+        const ValueType zAz_next = detail::krylov_dot(n, pz, pw);
+        const ValueType beta = zAz_next / zAz;
+        zAz = zAz_next;
+
+        // p = z + beta p, q = w + beta q (= A p) and, without preconditioner, q^T q in the same pass
+        qMq = detail::krylov_reduce<ValueType>(n, [&](size_t i) {
+            pp[i] = pz[i] + beta * pp[i];
+            pq[i] = pw[i] + beta * pq[i];
+            return identity ? pq[i] * pq[i] : ValueType(0);
+        });
+        if constexpr(!identity)
+        {
+            cusp::multiply(M, q, u);
+            qMq = detail::krylov_dot(n, pq, pu);
+        }
+        ++monitor;
+    }
+}
+
+template<typename LinearOperator, typename Array, typename Monitor>
+void cocr(LinearOperator& A, Array& x, const Array& b, Monitor& monitor)
+{
+    typedef typename Array::value_type ValueType;
+    typedef typename Array::memory_space MemorySpace;
+    cusp::identity_operator<ValueType, MemorySpace> M(A.num_rows, A.num_rows);
+    cocr(A, x, b, monitor, M);
+}
+
+
+template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+void idrs(LinearOperator& A, Array& x, const Array& b, size_t s, Monitor& monitor, Preconditioner& M)
+{
+    typedef typename Array::value_type ValueType;
+    typedef typename cusp::norm_type<ValueType>::type Real;
+    constexpr bool identity = detail::is_identity_operator<Preconditioner>::value;
+    const size_t n = A.num_rows;
+    assert(s > 0);
+    Array r(n), v(n), t(n), workspace(identity ? 0 : n);
+    std::vector<Array> P(s, Array(n)), U(s, Array(n, ValueType(0))), G(s, Array(n, ValueType(0)));
+    detail::krylov_residual(A, x, b, r);
+    if(monitor.finished(r)) return;
+
+    // Random orthonormal shadow space, fixed seed so runs are reproducible
+    std::mt19937 generator(0);
+    std::normal_distribution<Real> normal;
+    for(size_t k = 0; k < s; k++)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            if constexpr(std::is_arithmetic_v<ValueType>) P[k][i] = normal(generator);
+            else P[k][i] = ValueType(normal(generator), normal(generator));
+        }
+        ValueType* pk = thrust::raw_pointer_cast(P[k].data());
+        for(size_t j = 0; j < k; j++)
+        {
+            const ValueType* pj = thrust::raw_pointer_cast(P[j].data());
+            const ValueType d = detail::krylov_cdot(n, pj, pk);
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++) pk[i] -= d * pj[i];
+        }
+        const Real norm = std::sqrt(detail::krylov_real(detail::krylov_cdot(n, pk, pk)));
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)n; i++) pk[i] /= norm;
+    }
+
+    std::vector<const ValueType*> pP(s);
+    std::vector<ValueType*> pU(s), pG(s);
+    for(size_t k = 0; k < s; k++) pP[k] = thrust::raw_pointer_cast(P[k].data());
+    auto pointers = [&]() {
+        for(size_t k = 0; k < s; k++)
+        {
+            pU[k] = thrust::raw_pointer_cast(U[k].data());
+            pG[k] = thrust::raw_pointer_cast(G[k].data());
+        }
+    };
+    pointers();
+    ValueType* px = thrust::raw_pointer_cast(x.data());
+    ValueType* pr = thrust::raw_pointer_cast(r.data());
+    ValueType* pv = thrust::raw_pointer_cast(v.data());
+    ValueType* pt = thrust::raw_pointer_cast(t.data());
+
+    // Ms(i, k) = P_i^H G_k, lower triangular (row-major s x s)
+    std::vector<ValueType> Ms(s * s, ValueType(0)), f(s), c(s), d(s);
+    for(size_t k = 0; k < s; k++) Ms[k * s + k] = ValueType(1);
+    ValueType omega(1);
+    const Real kappa = Real(0.7);
+
+    while(true)
+    {
+        detail::krylov_reduce_n(n, s, f.data(), [&](size_t i, ValueType* sums) {
+            for(size_t j = 0; j < s; j++) sums[j] += detail::krylov_conj(pP[j][i]) * pr[i];
+        });
+        for(size_t k = 0; k < s; k++)
+        {
+            // Ms(k:s, k:s) c = f(k:s)
+            for(size_t i = k; i < s; i++)
+            {
+                ValueType sum = f[i];
+                for(size_t j = k; j < i; j++) sum -= Ms[i * s + j] * c[j];
+                c[i] = sum / Ms[i * s + i];
+            }
+
+            // v = r - G(:, k:s) c and the new direction t = U(:, k:s) c + omega M v, fused without preconditioner
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++)
+            {
+                ValueType vi = pr[i];
+                for(size_t j = k; j < s; j++) vi -= pG[j][i] * c[j];
+                pv[i] = vi;
+                if constexpr(identity)
+                {
+                    ValueType ti = omega * vi;
+                    for(size_t j = k; j < s; j++) ti += pU[j][i] * c[j];
+                    pt[i] = ti;
+                }
+            }
+            if constexpr(!identity)
+            {
+                cusp::multiply(M, v, workspace);
+                const ValueType* pw = thrust::raw_pointer_cast(workspace.data());
+                #pragma omp parallel for schedule(static)
+                for(long long i = 0; i < (long long)n; i++)
+                {
+                    ValueType ti = omega * pw[i];
+                    for(size_t j = k; j < s; j++) ti += pU[j][i] * c[j];
+                    pt[i] = ti;
+                }
+            }
+            U[k].swap(t);
+            pointers();
+            pt = thrust::raw_pointer_cast(t.data());
+            cusp::multiply(A, U[k], G[k]);
+
+            // Biorthogonalization against P_0 .. P_{k-1}: all P_j^H G_k in one pass, the coefficients from the
+            // lower triangular Ms(0:k, 0:k), then a single pass over G_k and U_k
+            detail::krylov_reduce_n(n, s, d.data(), [&](size_t i, ValueType* sums) {
+                for(size_t j = 0; j < s; j++) sums[j] += detail::krylov_conj(pP[j][i]) * pG[k][i];
+            });
+            std::vector<ValueType> alpha(k);
+            for(size_t i = 0; i < k; i++)
+            {
+                ValueType sum = d[i];
+                for(size_t j = 0; j < i; j++) sum -= Ms[i * s + j] * alpha[j];
+                alpha[i] = sum / Ms[i * s + i];
+            }
+            if(k > 0)
+            {
+                #pragma omp parallel for schedule(static)
+                for(long long i = 0; i < (long long)n; i++)
+                {
+                    ValueType g = pG[k][i], u = pU[k][i];
+                    for(size_t j = 0; j < k; j++)
+                    {
+                        g -= alpha[j] * pG[j][i];
+                        u -= alpha[j] * pU[j][i];
+                    }
+                    pG[k][i] = g;
+                    pU[k][i] = u;
+                }
+            }
+            for(size_t i = k; i < s; i++)
+            {
+                ValueType sum = d[i];
+                for(size_t j = 0; j < k; j++) sum -= alpha[j] * Ms[i * s + j];
+                Ms[i * s + k] = sum;
+            }
+            if(Ms[k * s + k] == ValueType(0)) return; // breakdown, the monitor keeps the last residual
+
+            // r -= beta G_k, x += beta U_k
+            const ValueType beta = f[k] / Ms[k * s + k];
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++)
+            {
+                pr[i] -= beta * pG[k][i];
+                px[i] += beta * pU[k][i];
+            }
+            ++monitor;
+            if(monitor.finished(r)) return;
+            for(size_t i = k + 1; i < s; i++) f[i] -= beta * Ms[i * s + k];
+        }
+
+        // Dimension reduction: v = M r, t = A v, omega minimizes ||r - omega t|| (kept away from 0 by kappa)
+        const ValueType* pmr = pr;
+        if constexpr(!identity)
+        {
+            cusp::multiply(M, r, v);
+            pmr = pv;
+        }
+        cusp::multiply(A, identity ? r : v, t);
+        ValueType dots[3];
+        detail::krylov_reduce_n(n, 3, dots, [&](size_t i, ValueType* sums) {
+            sums[0] += detail::krylov_conj(pt[i]) * pr[i];
+            sums[1] += detail::krylov_conj(pt[i]) * pt[i];
+            sums[2] += detail::krylov_conj(pr[i]) * pr[i];
+        });
+        const Real nt = std::sqrt(detail::krylov_real(dots[1])), nr = std::sqrt(detail::krylov_real(dots[2]));
+        if(nt == Real(0)) return;
+        omega = dots[0] / dots[1];
+        const Real rho = std::sqrt(detail::krylov_abs2(dots[0])) / (nt * nr);
+        if(rho < kappa) omega *= kappa / rho;
+        if(omega == ValueType(0)) return;
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+        {
+            px[i] += omega * pmr[i];
+            pr[i] -= omega * pt[i];
+        }
+        ++monitor;
+        if(monitor.finished(r)) return;
+    }
+}
+
+template<typename LinearOperator, typename Array, typename Monitor>
+void idrs(LinearOperator& A, Array& x, const Array& b, size_t s, Monitor& monitor)
+{
+    typedef typename Array::value_type ValueType;
+    typedef typename Array::memory_space MemorySpace;
+    cusp::identity_operator<ValueType, MemorySpace> M(A.num_rows, A.num_rows);
+    idrs(A, x, b, s, monitor, M);
+}
+
+template<typename LinearOperator, typename Array, typename Monitor, typename Preconditioner>
+void bicgstabl(LinearOperator& A, Array& x, const Array& b, size_t l, Monitor& monitor, Preconditioner& M)
+{
+    typedef typename Array::value_type ValueType;
+    constexpr bool identity = detail::is_identity_operator<Preconditioner>::value;
+    const size_t n = A.num_rows;
+    assert(l > 0);
+    // Updates go to y, x = x_0 + M y, so r stays the true residual. Without preconditioner y is x itself
+    std::vector<Array> R(l + 1, Array(n)), U(l + 1, Array(n, ValueType(0)));
+    Array shadow(n), workspace(identity ? 0 : n), y(identity ? 0 : n, ValueType(0));
+    detail::krylov_residual(A, x, b, R[0]);
+    thrust::copy(R[0].begin(), R[0].end(), shadow.begin());
+
+    std::vector<ValueType*> pR(l + 1), pU(l + 1);
+    for(size_t j = 0; j <= l; j++)
+    {
+        pR[j] = thrust::raw_pointer_cast(R[j].data());
+        pU[j] = thrust::raw_pointer_cast(U[j].data());
+    }
+    const ValueType* ps = thrust::raw_pointer_cast(shadow.data());
+    ValueType* py = identity ? thrust::raw_pointer_cast(x.data()) : thrust::raw_pointer_cast(y.data());
+    auto finish = [&]() {
+        if constexpr(!identity)
+        {
+            cusp::multiply(M, y, workspace);
+            ValueType* px = thrust::raw_pointer_cast(x.data());
+            const ValueType* pw = thrust::raw_pointer_cast(workspace.data());
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++) px[i] += pw[i];
+        }
+    };
+    if(monitor.finished(R[0])) return;
+
+    ValueType rho0(1), alpha(0), omega(1);
+    std::vector<ValueType> Z((l + 1) * (l + 1)), gram((l + 1) * (l + 2) / 2), Zs(l * l), gamma(l);
+    while(true)
+    {
+        rho0 = -omega * rho0;
+        // BiCG part
+        for(size_t j = 0; j < l; j++)
+        {
+            const ValueType rho1 = detail::krylov_cdot(n, ps, pR[j]);
+            if(rho0 == ValueType(0)) { finish(); return; }
+            const ValueType beta = alpha * rho1 / rho0;
+            rho0 = rho1;
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++)
+                for(size_t k = 0; k <= j; k++) pU[k][i] = pR[k][i] - beta * pU[k][i];
+            detail::krylov_right_product(A, M, U[j], workspace, U[j + 1]);
+            const ValueType sigma = detail::krylov_cdot(n, ps, pU[j + 1]);
+            if(sigma == ValueType(0)) { finish(); return; }
+            alpha = rho0 / sigma;
+            #pragma omp parallel for schedule(static)
+            for(long long i = 0; i < (long long)n; i++)
+            {
+                for(size_t k = 0; k <= j; k++) pR[k][i] -= alpha * pU[k + 1][i];
+                py[i] += alpha * pU[0][i];
+            }
+            detail::krylov_right_product(A, M, R[j], workspace, R[j + 1]);
+            ++monitor;
+            if(monitor.finished(R[0])) { finish(); return; }
+        }
+
+        // Minimal residual part: Gram matrix R^H R of the l + 1 residuals (upper triangle) in one pass,
+        // then gamma = argmin ||r_0 - sum_j gamma_j r_j|| from the normal equations
+        detail::krylov_reduce_n(n, gram.size(), gram.data(), [&](size_t i, ValueType* sums) {
+            size_t m = 0;
+            for(size_t a = 0; a <= l; a++)
+            {
+                const ValueType ra = detail::krylov_conj(pR[a][i]);
+                for(size_t c = a; c <= l; c++) sums[m++] += ra * pR[c][i];
+            }
+        });
+        for(size_t a = 0, m = 0; a <= l; a++)
+            for(size_t c = a; c <= l; c++, m++)
+            {
+                Z[a * (l + 1) + c] = gram[m];
+                Z[c * (l + 1) + a] = detail::krylov_conj(gram[m]);
+            }
+        for(size_t a = 0; a < l; a++)
+        {
+            for(size_t c = 0; c < l; c++) Zs[a * l + c] = Z[(a + 1) * (l + 1) + c + 1];
+            gamma[a] = Z[(a + 1) * (l + 1)];
+        }
+        if(!detail::krylov_solve_small(l, Zs, gamma)) { finish(); return; }
+        omega = gamma[l - 1];
+
+        // y += sum gamma_j r_{j-1}, r_0 -= sum gamma_j r_j, u_0 -= sum gamma_j u_j in one pass
+        #pragma omp parallel for schedule(static)
+        for(long long i = 0; i < (long long)n; i++)
+        {
+            ValueType dy(0), dr(0), du(0);
+            for(size_t j = 1; j <= l; j++)
+            {
+                dy += gamma[j - 1] * pR[j - 1][i];
+                dr += gamma[j - 1] * pR[j][i];
+                du += gamma[j - 1] * pU[j][i];
+            }
+            py[i] += dy;
+            pR[0][i] -= dr;
+            pU[0][i] -= du;
+        }
+        if(monitor.finished(R[0])) { finish(); return; }
+    }
+}
+
+template<typename LinearOperator, typename Array, typename Monitor>
+void bicgstabl(LinearOperator& A, Array& x, const Array& b, size_t l, Monitor& monitor)
+{
+    typedef typename Array::value_type ValueType;
+    typedef typename Array::memory_space MemorySpace;
+    cusp::identity_operator<ValueType, MemorySpace> M(A.num_rows, A.num_rows);
+    bicgstabl(A, x, b, l, monitor, M);
+}
+
+}
@@ -0,0 +1,450 @@
+// Spreading, interpolation and deconvolution of the host NUFFT
+namespace puff{
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::plan(size_t N1, size_t N2, size_t N3, int iflag_, double tol,
+                                                 NUFFTKernel kernel_)
+{
+    static_assert(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>,
+                  "NUFFT3D_h supports dcomplex and fcomplex only");
+    N[0] = N1; N[1] = N2; N[2] = N3;
+    iflag = iflag_ < 0 ? -1 : 1;
+    kernel = kernel_;
+
+    // Kernel width and shape for oversampling 2, the Gaussian needs ~2x the width for the same accuracy
+    tol = std::max(tol, (double)std::numeric_limits<Real>::epsilon());
+    int digits = (int)std::ceil(std::log10(1 / tol));
+    if(kernel == NUFFTKernel::ExponentialSemicircle)
+    {
+        w = std::min(16, std::max(2, digits + 1));
+        beta = Real(2.30 * w);
+    }
+    else
+    {
+        w = std::min(24, std::max(2, 2 * digits));
+        beta = Real(0.375 * M_PI_ * w);
+    }
+
+    for(int d = 0; d < 3; d++)
+    {
+        if(N[d] <= 1)
+        {
+            N[d] = 1; n[d] = 1;
+            correction[d] = Vector<Real, cusp::host_memory>(1, Real(1));
+            continue;
+        }
+        // Even 2-3-5 smooth fine grid of at least twice the modes and two kernel widths
+        size_t nd = std::max(2 * N[d], (size_t)(2 * w));
+        nd += nd % 2;
+        auto smooth = [](size_t v) {
+            for(size_t p : {2, 3, 5})
+                while(v % p == 0) v /= p;
+            return v == 1;
+        };
+        while(!smooth(nd)) nd += 2;
+        n[d] = nd;
+
+        // Deconvolution factor 2 / (w * phihat(k * pi * w / n)), phihat by Gauss-Legendre quadrature on [-1, 1]
+        std::vector<double> nodes, weights;
+        gauss_legendre(4 * w + 8, nodes, weights);
+        correction[d].resize(N[d]);
+        const double alpha = M_PI_ * w / n[d];
+        #pragma omp parallel for
+        for(long long p = 0; p < (long long)N[d]; p++)
+        {
+            double k = (double)p - (double)(N[d] / 2);
+            double phihat = 0;
+            for(size_t q = 0; q < nodes.size(); q++)
+                phihat += weights[q] * (double)kernel_value(Real(nodes[q])) * std::cos(k * alpha * nodes[q]);
+            correction[d][p] = Real(2.0 / (w * phihat));
+        }
+    }
+
+    fft.plan(n[0], n[1], n[2]);
+    fine.resize(n[0] * n[1] * n[2]);
+    for(int d = 0; d < 3; d++)
+        num_tiles[d] = (n[d] + TILE - 1) / TILE;
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::gauss_legendre(int q, std::vector<double>& nodes, std::vector<double>& weights)
+{
+    nodes.resize(q);
+    weights.resize(q);
+    for(int i = 0; i < (q + 1) / 2; i++)
+    {
+        // Newton iteration on P_q from the Chebyshev guess
+        double t = std::cos(M_PI_ * (i + 0.75) / (q + 0.5));
+        double dp = 1;
+        for(int it = 0; it < 100; it++)
+        {
+            double p0 = 1, p1 = t;
+            for(int k = 2; k <= q; k++)
+            {
+                double p2 = ((2 * k - 1) * t * p1 - (k - 1) * p0) / k;
+                p0 = p1; p1 = p2;
+            }
+            dp = q * (t * p1 - p0) / (t * t - 1);
+            double dt = p1 / dp;
+            t -= dt;
+            if(std::abs(dt) < 1e-15) break;
+        }
+        nodes[i] = -t; nodes[q - 1 - i] = t;
+        weights[i] = weights[q - 1 - i] = 2 / ((1 - t * t) * dp * dp);
+    }
+}
+
+template<typename ValueType>
+typename NUFFT3D<ValueType, cusp::host_memory>::Real
+NUFFT3D<ValueType, cusp::host_memory>::kernel_value(Real z) const
+{
+    if(std::abs(z) >= 1) return Real(0);
+    if(kernel == NUFFTKernel::ExponentialSemicircle)
+        return std::exp(beta * (std::sqrt(1 - z * z) - 1));
+    return std::exp(-beta * z * z);
+}
+
+template<typename ValueType>
+long long NUFFT3D<ValueType, cusp::host_memory>::kernel_weights(int d, Real xd, Real* weights) const
+{
+    if(n[d] == 1)
+    {
+        weights[0] = 1;
+        return 0;
+    }
+    long long l0 = (long long)std::ceil(xd - Real(0.5) * w);
+    const Real offset = Real(l0) - xd;
+    const Real scale = Real(2) / w;
+    if(kernel == NUFFTKernel::ExponentialSemicircle)
+    {
+        #pragma omp simd
+        for(int t = 0; t < w; t++)
+        {
+            Real z = (offset + t) * scale;
+            weights[t] = std::exp(beta * (std::sqrt(std::max(Real(0), 1 - z * z)) - 1));
+        }
+    }
+    else
+    {
+        #pragma omp simd
+        for(int t = 0; t < w; t++)
+        {
+            Real z = (offset + t) * scale;
+            weights[t] = std::exp(-beta * z * z);
+        }
+    }
+    return l0;
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::set_points(const Vector<Real, cusp::host_memory>& x1,
+                                                       const Vector<Real, cusp::host_memory>& x2,
+                                                       const Vector<Real, cusp::host_memory>& x3)
+{
+    const Vector<Real, cusp::host_memory>* in[3] = {&x1, &x2, &x3};
+    M = 0;
+    for(int d = 0; d < 3; d++)
+        if(n[d] > 1) M = std::max(M, in[d]->size());
+
+    // Scale to fine grid units and wrap into [0, n)
+    for(int d = 0; d < 3; d++)
+    {
+        if(n[d] == 1)
+        {
+            x[d] = Vector<Real, cusp::host_memory>(M, Real(0));
+            continue;
+        }
+        assert(in[d]->size() == M);
+        x[d].resize(M);
+        const Real h_inv = Real(n[d] / (2 * M_PI_));
+        const Real nd = Real(n[d]);
+        #pragma omp parallel for
+        for(long long j = 0; j < (long long)M; j++)
+        {
+            Real u = std::fmod(((*in[d])[j] + Real(M_PI_)) * h_inv, nd);
+            if(u < 0) u += nd;
+            if(u >= nd) u = 0;
+            x[d][j] = u;
+        }
+    }
+
+    // Bin points by fine grid tile so spreading of neighbouring points stays in cache
+    Vector<size_t, cusp::host_memory> keys(M);
+    order.resize(M);
+    #pragma omp parallel for
+    for(long long j = 0; j < (long long)M; j++)
+    {
+        size_t t[3];
+        for(int d = 0; d < 3; d++)
+            t[d] = std::min((size_t)x[d][j] / TILE, num_tiles[d] - 1);
+        keys[j] = (t[0] * num_tiles[1] + t[1]) * num_tiles[2] + t[2];
+        order[j] = j;
+    }
+    thrust::sort_by_key(keys.begin(), keys.end(), order.begin());
+
+    const size_t total_tiles = num_tiles[0] * num_tiles[1] * num_tiles[2];
+    tile_offsets.resize(total_tiles + 1);
+    thrust::lower_bound(keys.begin(), keys.end(),
+                        thrust::counting_iterator<size_t>(0),
+                        thrust::counting_iterator<size_t>(total_tiles + 1),
+                        tile_offsets.begin());
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::spread(const Vector<ValueType, cusp::host_memory>& c)
+{
+    assert(c.size() == M);
+    thrust::fill(fine.begin(), fine.end(), ValueType(0));
+    Real* fine_ptr = reinterpret_cast<Real*>(thrust::raw_pointer_cast(fine.data()));
+
+    int wd[3], e[3];
+    for(int d = 0; d < 3; d++)
+    {
+        wd[d] = n[d] > 1 ? w : 1;
+        e[d] = n[d] > 1 ? TILE + w : 1;
+    }
+    const size_t total_tiles = num_tiles[0] * num_tiles[1] * num_tiles[2];
+
+    #pragma omp parallel
+    {
+        // Split real / imaginary tile buffers so the inner loop vectorizes
+        std::vector<Real> buf_re(e[0] * e[1] * e[2]), buf_im(e[0] * e[1] * e[2]);
+        std::vector<Real> k1(w), k2(w), k3(w);
+
+        #pragma omp for schedule(dynamic)
+        for(long long tile = 0; tile < (long long)total_tiles; tile++)
+        {
+            const size_t begin = tile_offsets[tile], end = tile_offsets[tile + 1];
+            if(begin == end) continue;
+            long long t[3] = {(long long)(tile / (num_tiles[1] * num_tiles[2])),
+                              (long long)((tile / num_tiles[2]) % num_tiles[1]),
+                              (long long)(tile % num_tiles[2])};
+            long long o[3];
+            for(int d = 0; d < 3; d++)
+                o[d] = n[d] > 1 ? t[d] * TILE - w / 2 : 0;
+
+            std::fill(buf_re.begin(), buf_re.end(), Real(0));
+            std::fill(buf_im.begin(), buf_im.end(), Real(0));
+            for(size_t p = begin; p < end; p++)
+            {
+                const size_t j = order[p];
+                const long long l1 = kernel_weights(0, x[0][j], k1.data()) - o[0];
+                const long long l2 = kernel_weights(1, x[1][j], k2.data()) - o[1];
+                const long long l3 = kernel_weights(2, x[2][j], k3.data()) - o[2];
+                const Real cre = c[j].real(), cim = c[j].imag();
+                for(int i1 = 0; i1 < wd[0]; i1++)
+                {
+                    for(int i2 = 0; i2 < wd[1]; i2++)
+                    {
+                        const Real k12 = k1[i1] * k2[i2];
+                        Real* re = buf_re.data() + ((l1 + i1) * e[1] + (l2 + i2)) * e[2] + l3;
+                        Real* im = buf_im.data() + ((l1 + i1) * e[1] + (l2 + i2)) * e[2] + l3;
+                        #pragma omp simd
+                        for(int i3 = 0; i3 < wd[2]; i3++)
+                        {
+                            re[i3] += cre * k12 * k3[i3];
+                            im[i3] += cim * k12 * k3[i3];
+                        }
+                    }
+                }
+            }
+
+            // Periodic wrap into the shared fine grid, tiles overlap by w so adds are atomic
+            for(int i1 = 0; i1 < e[0]; i1++)
+            {
+                const size_t g1 = (size_t)((o[0] + i1 + (long long)n[0]) % (long long)n[0]);
+                for(int i2 = 0; i2 < e[1]; i2++)
+                {
+                    const size_t g2 = (size_t)((o[1] + i2 + (long long)n[1]) % (long long)n[1]);
+                    for(int i3 = 0; i3 < e[2]; i3++)
+                    {
+                        const size_t b = (i1 * e[1] + i2) * e[2] + i3;
+                        if(buf_re[b] == Real(0) && buf_im[b] == Real(0)) continue;
+                        const size_t g3 = (size_t)((o[2] + i3 + (long long)n[2]) % (long long)n[2]);
+                        const size_t g = (g1 * n[1] + g2) * n[2] + g3;
+                        #pragma omp atomic
+                        fine_ptr[2 * g] += buf_re[b];
+                        #pragma omp atomic
+                        fine_ptr[2 * g + 1] += buf_im[b];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::interpolate(Vector<ValueType, cusp::host_memory>& c) const
+{
+    c.resize(M);
+    const Real* fine_ptr = reinterpret_cast<const Real*>(thrust::raw_pointer_cast(fine.data()));
+    int wd[3];
+    for(int d = 0; d < 3; d++)
+        wd[d] = n[d] > 1 ? w : 1;
+    const size_t total_tiles = num_tiles[0] * num_tiles[1] * num_tiles[2];
+
+    #pragma omp parallel
+    {
+        std::vector<Real> k1(w), k2(w), k3(w);
+        std::vector<size_t> g1(w), g2(w), g3(w);
+
+        #pragma omp for schedule(dynamic)
+        for(long long tile = 0; tile < (long long)total_tiles; tile++)
+        {
+            for(size_t p = tile_offsets[tile]; p < tile_offsets[tile + 1]; p++)
+            {
+                const size_t j = order[p];
+                const long long l[3] = {kernel_weights(0, x[0][j], k1.data()),
+                                        kernel_weights(1, x[1][j], k2.data()),
+                                        kernel_weights(2, x[2][j], k3.data())};
+                size_t* g[3] = {g1.data(), g2.data(), g3.data()};
+                for(int d = 0; d < 3; d++)
+                    for(int i = 0; i < wd[d]; i++)
+                        g[d][i] = (size_t)((l[d] + i + (long long)n[d]) % (long long)n[d]);
+
+                Real sum_re = 0, sum_im = 0;
+                for(int i1 = 0; i1 < wd[0]; i1++)
+                {
+                    for(int i2 = 0; i2 < wd[1]; i2++)
+                    {
+                        const Real k12 = k1[i1] * k2[i2];
+                        const Real* row = fine_ptr + 2 * (g1[i1] * n[1] + g2[i2]) * n[2];
+                        #pragma omp simd reduction(+:sum_re, sum_im)
+                        for(int i3 = 0; i3 < wd[2]; i3++)
+                        {
+                            sum_re += k12 * k3[i3] * row[2 * g3[i3]];
+                            sum_im += k12 * k3[i3] * row[2 * g3[i3] + 1];
+                        }
+                    }
+                }
+                c[j] = ValueType(sum_re, sum_im);
+            }
+        }
+    }
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::type1(const Vector<ValueType, cusp::host_memory>& c,
+                                                  Vector<ValueType, cusp::host_memory>& f)
+{
+    spread(c);
+    if(iflag < 0) fft.forward(fine);
+    else fft.backward(fine);
+
+    // Pick the modes out of the fine grid, the (-1)^k shift moves the grid origin from 0 to -pi
+    f.resize(num_modes());
+    #pragma omp parallel for
+    for(long long p1 = 0; p1 < (long long)N[0]; p1++)
+    {
+        const long long m1 = p1 - (long long)(N[0] / 2);
+        const size_t g1 = (size_t)((m1 + (long long)n[0]) % (long long)n[0]);
+        for(size_t p2 = 0; p2 < N[1]; p2++)
+        {
+            const long long m2 = (long long)p2 - (long long)(N[1] / 2);
+            const size_t g2 = (size_t)((m2 + (long long)n[1]) % (long long)n[1]);
+            for(size_t p3 = 0; p3 < N[2]; p3++)
+            {
+                const long long m3 = (long long)p3 - (long long)(N[2] / 2);
+                const size_t g3 = (size_t)((m3 + (long long)n[2]) % (long long)n[2]);
+                Real scale = correction[0][p1] * correction[1][p2] * correction[2][p3];
+                if((m1 + m2 + m3) & 1) scale = -scale;
+                f[(p1 * N[1] + p2) * N[2] + p3] = fine[(g1 * n[1] + g2) * n[2] + g3] * scale;
+            }
+        }
+    }
+}
+
+template<typename ValueType>
+void NUFFT3D<ValueType, cusp::host_memory>::type2(const Vector<ValueType, cusp::host_memory>& f,
+                                                  Vector<ValueType, cusp::host_memory>& c)
+{
+    assert(f.size() == num_modes());
+    thrust::fill(fine.begin(), fine.end(), ValueType(0));
+    #pragma omp parallel for
+    for(long long p1 = 0; p1 < (long long)N[0]; p1++)
+    {
+        const long long m1 = p1 - (long long)(N[0] / 2);
+        const size_t g1 = (size_t)((m1 + (long long)n[0]) % (long long)n[0]);
+        for(size_t p2 = 0; p2 < N[1]; p2++)
+        {
+            const long long m2 = (long long)p2 - (long long)(N[1] / 2);
+            const size_t g2 = (size_t)((m2 + (long long)n[1]) % (long long)n[1]);
+            for(size_t p3 = 0; p3 < N[2]; p3++)
+            {
+                const long long m3 = (long long)p3 - (long long)(N[2] / 2);
+                const size_t g3 = (size_t)((m3 + (long long)n[2]) % (long long)n[2]);
+                Real scale = correction[0][p1] * correction[1][p2] * correction[2][p3];
+                if((m1 + m2 + m3) & 1) scale = -scale;
+                fine[(g1 * n[1] + g2) * n[2] + g3] = f[(p1 * N[1] + p2) * N[2] + p3] * scale;
+            }
+        }
+    }
+
+    if(iflag < 0) fft.forward(fine);
+    else fft.backward(fine);
+    interpolate(c);
+}
+
+template<typename T>
+void __2D_PGF_Plane_NUFFT__(const Vector<T, cusp::host_memory>& x,
+                            const Vector<T, cusp::host_memory>& y,
+                            T z, T Lx, T Ly,
+                            std::complex<T> Kx, std::complex<T> Ky, std::complex<T> K0,
+                            Vector<thrust::complex<T>, cusp::host_memory>& G,
+                            double epi)
+{
+    using ValueType = thrust::complex<T>;
+    assert(z != 0 && x.size() == y.size());
+
+    // Same truncation as __2D_PGF__
+    double epsilon = epi / std::min(Lx, Ly);
+    int M = __Floquet_truncation__<T>(Lx, Ly, z, epsilon);
+    const size_t P = 2 * M + 1;
+
+    // Floquet mode coefficients, modes ordered (m, n) row-major from -M
+    Vector<ValueType, cusp::host_memory> f(P * P);
+    #pragma omp parallel for
+    for(int m = -M; m <= M; m++)
+    {
+        std::complex<T> Kxm = Kx + T(2 * M_PI_ * m / Lx);
+        for(int n = -M; n <= M; n++)
+        {
+            std::complex<T> Kyn = Ky + T(2 * M_PI_ * n / Ly);
+            auto Kzmn = __Floquet_Kzmn__<T>(Kxm, Kyn, K0);
+            auto c = std::exp(std::complex<T>(0, -1) * Kzmn * std::abs(z)) / (T(2) * std::complex<T>(0, 1) * Kzmn * Lx * Ly);
+            f[(m + M) * P + (n + M)] = ValueType(c.real(), c.imag());
+        }
+    }
+
+    // Lattice phases 2 pi x / Lx, 2 pi y / Ly on the periodic box
+    Vector<T, cusp::host_memory> X(x.size()), Y(y.size());
+    thrust::transform(x.begin(), x.end(), thrust::make_constant_iterator(T(2 * M_PI_ / Lx)), X.begin(), thrust::multiplies<T>());
+    thrust::transform(y.begin(), y.end(), thrust::make_constant_iterator(T(2 * M_PI_ / Ly)), Y.begin(), thrust::multiplies<T>());
+
+    NUFFT3D<ValueType, cusp::host_memory> nufft(P, P, 1, -1, std::max(epi, 1e-14));
+    nufft.set_points(X, Y, Vector<T, cusp::host_memory>());
+    nufft.type2(f, G);
+
+    // Grazing modes outside the window are summed directly, like in __2D_PGF__
+    const auto grazing = __Floquet_grazing_modes__<T>(Lx, Ly, Kx, Ky, K0, M);
+    std::vector<std::complex<T>> grazing_coefficients;
+    for(auto [m, n] : grazing)
+    {
+        auto Kzmn = __Floquet_Kzmn__<T>(Kx + T(2 * M_PI_ * m / Lx), Ky + T(2 * M_PI_ * n / Ly), K0);
+        grazing_coefficients.push_back(std::exp(std::complex<T>(0, -1) * Kzmn * std::abs(z)) / (T(2) * std::complex<T>(0, 1) * Kzmn * Lx * Ly));
+    }
+
+    // Bloch phase of the incident wave
+    #pragma omp parallel for
+    for(long long j = 0; j < (long long)x.size(); j++)
+    {
+        std::complex<T> g(G[j].real(), G[j].imag());
+        for(size_t k = 0; k < grazing.size(); k++)
+            g += grazing_coefficients[k] * std::exp(std::complex<T>(0, -1) * (X[j] * T(grazing[k].first) + Y[j] * T(grazing[k].second)));
+        auto phase = std::exp(std::complex<T>(0, -1) * (Kx * x[j] + Ky * y[j]));
+        g *= phase;
+        G[j] = ValueType(g.real(), g.imag());
+    }
+}
+
+}
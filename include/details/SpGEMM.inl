@@ -0,0 +1,310 @@
+// Row-wise (Gustavson) sparse matrix products with a symbolic / numeric split
+namespace puff{
+
+namespace detail{
+
+// Home slot of a column in a table of 2^bits slots (Fibonacci hashing)
+inline size_t spgemm_home(uint64_t col, int bits)
+{
+    return bits == 0 ? 0 : (size_t)((col * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// splitmix64 finalizer
+inline uint64_t spgemm_mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline int spgemm_table_bits(size_t entries)
+{
+    int bits = 0;
+    while(((size_t)1 << bits) < 2 * entries) bits++;
+    return bits;
+}
+
+// Pattern of a product whose row i is enumerated by columns(i, f) -> f(col), bound(i) bounds the
+// products of row i (hash table size). Fills plan.row_offsets / column_indices, rows sorted
+template<typename IndexType, typename Bound, typename Columns>
+void gustavson_symbolic(SpGEMMPlan<IndexType>& plan, size_t value_bytes, Bound bound, Columns columns)
+{
+    const size_t rows = plan.num_rows, cols = plan.num_cols;
+    const IndexType empty = std::numeric_limits<IndexType>::max();
+    std::vector<size_t> products(rows);
+    size_t total = 0;
+    #pragma omp parallel for schedule(static) reduction(+:total)
+    for(long long i = 0; i < (long long)rows; i++)
+    {
+        products[i] = bound((IndexType)i);
+        total += products[i];
+    }
+
+    // A dense row is cheap when it stays in cache or when rows touch a good part of the columns anyway
+    if(plan.accumulator == SpGEMMAccumulator::Auto)
+    {
+        const bool fits = cols * (value_bytes + sizeof(IndexType)) <= ((size_t)1 << 20);
+        const bool busy = 16.0 * total >= (double)rows * cols;
+        plan.accumulator = fits || busy ? SpGEMMAccumulator::Dense : SpGEMMAccumulator::Hash;
+    }
+    const bool dense = plan.accumulator == SpGEMMAccumulator::Dense;
+
+    // Pass 0 counts the distinct columns of each row, pass 1 writes and sorts them
+    plan.row_offsets.assign(rows + 1, 0);
+    for(int pass = 0; pass < 2; pass++)
+    {
+        #pragma omp parallel
+        {
+            std::vector<IndexType> marker(dense ? cols : 0, empty);
+            std::vector<IndexType> table;
+            #pragma omp for schedule(dynamic, 64)
+            for(long long i = 0; i < (long long)rows; i++)
+            {
+                IndexType* out = pass == 1 ? plan.column_indices.data() + plan.row_offsets[i] : nullptr;
+                size_t count = 0;
+                if(dense)
+                {
+                    columns((IndexType)i, [&](IndexType col) {
+                        if(marker[col] == (IndexType)i) return;
+                        marker[col] = (IndexType)i;
+                        if(out) out[count] = col;
+                        count++;
+                    });
+                }
+                else
+                {
+                    const int bits = spgemm_table_bits(products[i]);
+                    const size_t mask = ((size_t)1 << bits) - 1;
+                    if(table.size() < mask + 1) table.resize(mask + 1);
+                    std::fill(table.begin(), table.begin() + mask + 1, empty);
+                    columns((IndexType)i, [&](IndexType col) {
+                        size_t s = spgemm_home(col, bits);
+                        while(table[s] != empty && table[s] != col) s = (s + 1) & mask;
+                        if(table[s] == col) return;
+                        table[s] = col;
+                        if(out) out[count] = col;
+                        count++;
+                    });
+                }
+                if(out) std::sort(out, out + count);
+                else plan.row_offsets[i + 1] = (IndexType)count;
+            }
+        }
+        if(pass == 0)
+        {
+            size_t nnz = 0;
+            for(size_t i = 0; i < rows; i++)
+            {
+                nnz += plan.row_offsets[i + 1];
+                if(nnz >= (size_t)std::numeric_limits<IndexType>::max())
+                    throw std::overflow_error("SpGEMM: the product has more entries than IndexType can address");
+                plan.row_offsets[i + 1] = (IndexType)nnz;
+            }
+            plan.column_indices.resize(nnz);
+        }
+    }
+}
+
+// Values on the pattern of plan, products(i, f) -> f(col, value) enumerates the terms of row i
+template<typename ValueType, typename IndexType, typename Products>
+void gustavson_numeric(const SpGEMMPlan<IndexType>& plan, Products products, ValueType* c_values)
+{
+    const size_t rows = plan.num_rows;
+    const bool dense = plan.accumulator != SpGEMMAccumulator::Hash;
+    const IndexType empty = std::numeric_limits<IndexType>::max();
+    const IndexType* offsets = plan.row_offsets.data();
+    const IndexType* indices = plan.column_indices.data();
+    #pragma omp parallel
+    {
+        std::vector<ValueType> sums(dense ? plan.num_cols : 0, ValueType(0));
+        std::vector<IndexType> keys;
+        #pragma omp for schedule(dynamic, 64)
+        for(long long i = 0; i < (long long)rows; i++)
+        {
+            const IndexType begin = offsets[i], end = offsets[i + 1];
+            if(dense)
+            {
+                products((IndexType)i, [&](IndexType col, const ValueType& value) { sums[col] += value; });
+                // Only the pattern of the row was touched, resetting it keeps the array clean
+                for(IndexType k = begin; k < end; k++)
+                {
+                    c_values[k] = sums[indices[k]];
+                    sums[indices[k]] = ValueType(0);
+                }
+                continue;
+            }
+            // The pattern is known, so the table holds exactly the columns of the row
+            const int bits = detail::spgemm_table_bits(end - begin);
+            const size_t mask = ((size_t)1 << bits) - 1;
+            if(keys.size() < mask + 1)
+            {
+                keys.resize(mask + 1);
+                sums.resize(mask + 1);
+            }
+            std::fill(keys.begin(), keys.begin() + mask + 1, empty);
+            std::fill(sums.begin(), sums.begin() + mask + 1, ValueType(0));
+            auto slot = [&](IndexType col) {
+                size_t s = spgemm_home(col, bits);
+                while(keys[s] != empty && keys[s] != col) s = (s + 1) & mask;
+                return s;
+            };
+            products((IndexType)i, [&](IndexType col, const ValueType& value) {
+                size_t s = slot(col);
+                keys[s] = col;
+                sums[s] += value;
+            });
+            for(IndexType k = begin; k < end; k++)
+            {
+                size_t s = slot(indices[k]);
+                c_values[k] = keys[s] == empty ? ValueType(0) : sums[s];
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+// Each entry is hashed with its row and position and the hashes are summed, so rows reduce in any order
+template<typename IndexType>
+uint64_t CSR_pattern_fingerprint(size_t num_rows, const IndexType* offsets, const IndexType* indices)
+{
+    uint64_t sum = 0;
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for(long long i = 0; i < (long long)num_rows; i++)
+        for(IndexType k = offsets[i]; k < offsets[i + 1]; k++)
+            sum += detail::spgemm_mix((((uint64_t)i << 32) | (uint64_t)indices[k]) + (uint64_t)k * 0x9E3779B97F4A7C15ULL);
+    return detail::spgemm_mix(sum ^ detail::spgemm_mix(num_rows)) + (num_rows > 0 ? (uint64_t)offsets[num_rows] : 0);
+}
+
+template<typename ValueType, typename IndexType>
+SpGEMMPlan<IndexType> SpGEMM_symbolic(size_t num_rows,
+                                      size_t num_inner,
+                                      size_t num_cols,
+                                      const IndexType* a_offsets,
+                                      const IndexType* a_indices,
+                                      const IndexType* b_offsets,
+                                      const IndexType* b_indices,
+                                      SpGEMMAccumulator accumulator)
+{
+    SpGEMMPlan<IndexType> plan;
+    plan.accumulator = accumulator;
+    plan.num_rows = num_rows;
+    plan.num_cols = num_cols;
+    plan.input_patterns = {CSR_pattern_fingerprint(num_rows, a_offsets, a_indices), CSR_pattern_fingerprint(num_inner, b_offsets, b_indices)};
+    detail::gustavson_symbolic(plan, sizeof(ValueType),
+        [&](IndexType i) {
+            size_t count = 0;
+            for(IndexType k = a_offsets[i]; k < a_offsets[i + 1]; k++)
+                count += b_offsets[a_indices[k] + 1] - b_offsets[a_indices[k]];
+            return count;
+        },
+        [&](IndexType i, auto&& f) {
+            for(IndexType k = a_offsets[i]; k < a_offsets[i + 1]; k++)
+                for(IndexType l = b_offsets[a_indices[k]]; l < b_offsets[a_indices[k] + 1]; l++)
+                    f(b_indices[l]);
+        });
+    return plan;
+}
+
+template<typename ValueType, typename IndexType>
+void SpGEMM_numeric(const SpGEMMPlan<IndexType>& plan,
+                    const IndexType* a_offsets,
+                    const IndexType* a_indices,
+                    const ValueType* a_values,
+                    const IndexType* b_offsets,
+                    const IndexType* b_indices,
+                    const ValueType* b_values,
+                    ValueType* c_values)
+{
+    detail::gustavson_numeric(plan,
+        [&](IndexType i, auto&& f) {
+            for(IndexType k = a_offsets[i]; k < a_offsets[i + 1]; k++)
+            {
+                const ValueType a = a_values[k];
+                for(IndexType l = b_offsets[a_indices[k]]; l < b_offsets[a_indices[k] + 1]; l++)
+                    f(b_indices[l], a * b_values[l]);
+            }
+        }, c_values);
+}
+
+template<typename ValueType, typename IndexType>
+SpGEMMPlan<IndexType> Triple_product_symbolic(size_t num_rows,
+                                              size_t num_cols,
+                                              const IndexType* p_offsets,
+                                              const IndexType* p_indices,
+                                              const IndexType* a_offsets,
+                                              const IndexType* a_indices,
+                                              SpGEMMAccumulator accumulator)
+{
+    SpGEMMPlan<IndexType> plan;
+    plan.accumulator = accumulator;
+    plan.num_rows = num_cols;
+    plan.num_cols = num_cols;
+    const size_t p_entries = num_rows > 0 ? (size_t)p_offsets[num_rows] : 0;
+    plan.input_patterns = {CSR_pattern_fingerprint(num_rows, p_offsets, p_indices), CSR_pattern_fingerprint(num_rows, a_offsets, a_indices)};
+
+    // P^T by a counting sort of the columns of P, rows of P are visited in order so P^T rows come out sorted
+    plan.transpose_offsets.assign(num_cols + 1, 0);
+    for(size_t k = 0; k < p_entries; k++) plan.transpose_offsets[p_indices[k] + 1]++;
+    for(size_t j = 0; j < num_cols; j++) plan.transpose_offsets[j + 1] += plan.transpose_offsets[j];
+    plan.transpose_indices.resize(p_entries);
+    plan.transpose_permutation.resize(p_entries);
+    std::vector<IndexType> fill(plan.transpose_offsets.begin(), plan.transpose_offsets.end() - 1);
+    for(size_t i = 0; i < num_rows; i++)
+        for(IndexType k = p_offsets[i]; k < p_offsets[i + 1]; k++)
+        {
+            const IndexType m = fill[p_indices[k]]++;
+            plan.transpose_indices[m] = (IndexType)i;
+            plan.transpose_permutation[m] = k;
+        }
+
+    const IndexType* t_offsets = plan.transpose_offsets.data();
+    const IndexType* t_indices = plan.transpose_indices.data();
+    detail::gustavson_symbolic(plan, sizeof(ValueType),
+        [&](IndexType j) {
+            size_t count = 0;
+            for(IndexType m = t_offsets[j]; m < t_offsets[j + 1]; m++)
+                for(IndexType k = a_offsets[t_indices[m]]; k < a_offsets[t_indices[m] + 1]; k++)
+                    count += p_offsets[a_indices[k] + 1] - p_offsets[a_indices[k]];
+            return count;
+        },
+        [&](IndexType j, auto&& f) {
+            for(IndexType m = t_offsets[j]; m < t_offsets[j + 1]; m++)
+                for(IndexType k = a_offsets[t_indices[m]]; k < a_offsets[t_indices[m] + 1]; k++)
+                    for(IndexType l = p_offsets[a_indices[k]]; l < p_offsets[a_indices[k] + 1]; l++)
+                        f(p_indices[l]);
+        });
+    return plan;
+}
+
+template<typename ValueType, typename IndexType>
+void Triple_product_numeric(const SpGEMMPlan<IndexType>& plan,
+                            const IndexType* p_offsets,
+                            const IndexType* p_indices,
+                            const ValueType* p_values,
+                            const IndexType* a_offsets,
+                            const IndexType* a_indices,
+                            const ValueType* a_values,
+                            ValueType* c_values,
+                            bool conjugate)
+{
+    const IndexType* t_offsets = plan.transpose_offsets.data();
+    const IndexType* t_indices = plan.transpose_indices.data();
+    std::vector<ValueType> t_values(plan.transpose_permutation.size());
+    #pragma omp parallel for schedule(static)
+    for(long long m = 0; m < (long long)t_values.size(); m++)
+        t_values[m] = detail::transpose_value(p_values[plan.transpose_permutation[m]], conjugate);
+
+    detail::gustavson_numeric(plan,
+        [&](IndexType j, auto&& f) {
+            for(IndexType m = t_offsets[j]; m < t_offsets[j + 1]; m++)
+                for(IndexType k = a_offsets[t_indices[m]]; k < a_offsets[t_indices[m] + 1]; k++)
+                {
+                    const ValueType ta = t_values[m] * a_values[k];
+                    for(IndexType l = p_offsets[a_indices[k]]; l < p_offsets[a_indices[k] + 1]; l++)
+                        f(p_indices[l], ta * p_values[l]);
+                }
+        }, c_values);
+}
+
+}
@@ -0,0 +1,799 @@
+// Explicit SIMD CSR SpMV kernels with runtime dispatch
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PUFF_X86_SIMD 1
+#include <immintrin.h>
+#endif
+#include <cstring>
+
+namespace puff{
+
+inline SpMVIsa SpMV_detect_isa()
+{
+    static const SpMVIsa isa = []() {
+#ifdef PUFF_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")) return SpMVIsa::AVX512;
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c")) return SpMVIsa::AVX2;
+#endif
+        return SpMVIsa::Scalar;
+    }();
+    return isa;
+}
+
+inline const char* SpMV_isa_name(SpMVIsa isa)
+{
+    switch(isa)
+    {
+        case SpMVIsa::AVX512: return "AVX-512";
+        case SpMVIsa::AVX2: return "AVX2";
+        default: return "Scalar";
+    }
+}
+
+inline const char* SpMV_backend_name(SpMVBackend backend)
+{
+    switch(backend)
+    {
+        case SpMVBackend::MKL: return "MKL";
+        case SpMVBackend::SIMD: return "SIMD";
+        default: return "Generic";
+    }
+}
+
+namespace detail{
+
+// Scalar fallback, also the remainder loop of the vector kernels
+template<typename Real, typename IndexType>
+inline void csr_row_complex_scalar(IndexType begin, IndexType end,
+                                   const IndexType* column_indices, const Real* A, const Real* x,
+                                   Real sign, Real& re, Real& im)
+{
+    for(IndexType k = begin; k < end; k++)
+    {
+        const Real ar = A[2 * k], ai = sign * A[2 * k + 1];
+        const Real xr = x[2 * column_indices[k]], xi = x[2 * column_indices[k] + 1];
+        re += ar * xr - ai * xi;
+        im += ar * xi + ai * xr;
+    }
+}
+
+template<typename Real, typename IndexType>
+void csr_spmv_complex_scalar(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                             const Real* A, const Real* x, Real* y, bool conjugate)
+{
+    const Real sign = conjugate ? Real(-1) : Real(1);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        Real re = 0, im = 0;
+        csr_row_complex_scalar(row_offsets[i], row_offsets[i + 1], column_indices, A, x, sign, re, im);
+        y[2 * i] = re;
+        y[2 * i + 1] = im;
+    }
+}
+
+#ifdef PUFF_X86_SIMD
+
+// The complex product is split into a * (xr, xr) and a * (xi, xi) accumulated separately per row,
+// combined once per row with an add/sub of the swapped second accumulator:
+// (ar xr - ai xi, ai xr + ar xi)
+
+template<typename IndexType>
+__attribute__((target("avx2,fma")))
+void csr_spmv_z_avx2(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                     const double* A, const double* x, double* y, bool conjugate)
+{
+    const __m256d sign = conjugate ? _mm256_setr_pd(0.0, -0.0, 0.0, -0.0) : _mm256_setzero_pd();
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m256d acc_r = _mm256_setzero_pd(), acc_i = _mm256_setzero_pd();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        for(; k + 2 <= end; k += 2)
+        {
+            __m256d a = _mm256_xor_pd(_mm256_loadu_pd(A + 2 * k), sign);
+            __m256d xv = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(x + 2 * column_indices[k])),
+                                              _mm_loadu_pd(x + 2 * column_indices[k + 1]), 1);
+            acc_r = _mm256_fmadd_pd(a, _mm256_movedup_pd(xv), acc_r);
+            acc_i = _mm256_fmadd_pd(a, _mm256_permute_pd(xv, 0xF), acc_i);
+        }
+        __m256d sum = _mm256_addsub_pd(acc_r, _mm256_permute_pd(acc_i, 0x5));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        double out[2];
+        _mm_storeu_pd(out, s);
+        csr_row_complex_scalar(k, end, column_indices, A, x, conjugate ? -1.0 : 1.0, out[0], out[1]);
+        y[2 * i] = out[0];
+        y[2 * i + 1] = out[1];
+    }
+}
+
+template<typename IndexType>
+__attribute__((target("avx512f")))
+void csr_spmv_z_avx512(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                       const double* A, const double* x, double* y, bool conjugate)
+{
+    const __m512i sign = conjugate ? _mm512_castpd_si512(_mm512_setr_pd(0.0, -0.0, 0.0, -0.0, 0.0, -0.0, 0.0, -0.0))
+                                   : _mm512_setzero_si512();
+    const __m512d ones = _mm512_set1_pd(1.0);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m512d acc_r = _mm512_setzero_pd(), acc_i = _mm512_setzero_pd();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        for(; k + 4 <= end; k += 4)
+        {
+            __m512d a = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(_mm512_loadu_pd(A + 2 * k)), sign));
+            __m256d lo = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(x + 2 * column_indices[k])),
+                                              _mm_loadu_pd(x + 2 * column_indices[k + 1]), 1);
+            __m256d hi = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(x + 2 * column_indices[k + 2])),
+                                              _mm_loadu_pd(x + 2 * column_indices[k + 3]), 1);
+            __m512d xv = _mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1);
+            acc_r = _mm512_fmadd_pd(a, _mm512_movedup_pd(xv), acc_r);
+            acc_i = _mm512_fmadd_pd(a, _mm512_permute_pd(xv, 0xFF), acc_i);
+        }
+        __m512d sum = _mm512_fmaddsub_pd(acc_r, ones, _mm512_permute_pd(acc_i, 0x55));
+        __m256d s4 = _mm256_add_pd(_mm512_castpd512_pd256(sum), _mm512_extractf64x4_pd(sum, 1));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(s4), _mm256_extractf128_pd(s4, 1));
+        double out[2];
+        _mm_storeu_pd(out, s);
+        csr_row_complex_scalar(k, end, column_indices, A, x, conjugate ? -1.0 : 1.0, out[0], out[1]);
+        y[2 * i] = out[0];
+        y[2 * i + 1] = out[1];
+    }
+}
+
+// Single precision: one complex<float> is 64 bits, so x is gathered as doubles with 32-bit indices
+
+template<typename IndexType>
+__attribute__((target("avx2,fma")))
+void csr_spmv_c_avx2(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                     const float* A, const float* x, float* y, bool conjugate)
+{
+    static_assert(sizeof(IndexType) == 4, "32-bit column indices are gathered directly");
+    const __m256 sign = conjugate ? _mm256_setr_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f) : _mm256_setzero_ps();
+    const double* xd = reinterpret_cast<const double*>(x);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m256 acc_r = _mm256_setzero_ps(), acc_i = _mm256_setzero_ps();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        for(; k + 4 <= end; k += 4)
+        {
+            __m256 a = _mm256_xor_ps(_mm256_loadu_ps(A + 2 * k), sign);
+            __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column_indices + k));
+            __m256 xv = _mm256_castpd_ps(_mm256_i32gather_pd(xd, idx, 8));
+            acc_r = _mm256_fmadd_ps(a, _mm256_moveldup_ps(xv), acc_r);
+            acc_i = _mm256_fmadd_ps(a, _mm256_movehdup_ps(xv), acc_i);
+        }
+        __m256 sum = _mm256_addsub_ps(acc_r, _mm256_permute_ps(acc_i, 0xB1));
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        float out[4];
+        _mm_storeu_ps(out, s);
+        csr_row_complex_scalar(k, end, column_indices, A, x, conjugate ? -1.f : 1.f, out[0], out[1]);
+        y[2 * i] = out[0];
+        y[2 * i + 1] = out[1];
+    }
+}
+
+template<typename IndexType>
+__attribute__((target("avx512f")))
+void csr_spmv_c_avx512(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                       const float* A, const float* x, float* y, bool conjugate)
+{
+    static_assert(sizeof(IndexType) == 4, "32-bit column indices are gathered directly");
+    const __m512i sign = conjugate ? _mm512_set1_epi64((long long)0x8000000000000000ULL) : _mm512_setzero_si512();
+    const __m512 ones = _mm512_set1_ps(1.f);
+    const double* xd = reinterpret_cast<const double*>(x);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m512 acc_r = _mm512_setzero_ps(), acc_i = _mm512_setzero_ps();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        for(; k + 8 <= end; k += 8)
+        {
+            __m512 a = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_loadu_ps(A + 2 * k)), sign));
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column_indices + k));
+            __m512 xv = _mm512_castpd_ps(_mm512_i32gather_pd(idx, xd, 8));
+            acc_r = _mm512_fmadd_ps(a, _mm512_moveldup_ps(xv), acc_r);
+            acc_i = _mm512_fmadd_ps(a, _mm512_movehdup_ps(xv), acc_i);
+        }
+        __m512 sum = _mm512_fmaddsub_ps(acc_r, ones, _mm512_permute_ps(acc_i, 0xB1));
+        __m256 s8 = _mm256_add_ps(_mm512_castps512_ps256(sum), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum), 1)));
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        float out[4];
+        _mm_storeu_ps(out, s);
+        csr_row_complex_scalar(k, end, column_indices, A, x, conjugate ? -1.f : 1.f, out[0], out[1]);
+        y[2 * i] = out[0];
+        y[2 * i + 1] = out[1];
+    }
+}
+
+#endif
+
+// 16-bit storage: scalar conversions, exact for every finite value, NaN stays NaN
+
+inline float half_bits_to_float(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16, exponent = (h >> 10) & 0x1F, mantissa = h & 0x3FF;
+    uint32_t bits;
+    if(exponent == 0x1F) bits = sign | 0x7F800000 | (mantissa << 13);
+    else if(exponent != 0) bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else
+    {
+        float f = std::ldexp((float)mantissa, -24); // zero or subnormal
+        return sign ? -f : f;
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t float_to_half_bits(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if(magnitude > 0x7F800000) return sign | 0x7E00;
+    if(magnitude >= 0x477FF000) return sign | 0x7C00; // rounds to infinity
+    if(magnitude < 0x38800000)
+    {
+        // Half subnormal: the scaled value rounds (to even) to the mantissa, 1024 becomes the smallest normal
+        float scaled = std::fabs(f) * 16777216.0f;
+        return sign | (uint16_t)std::nearbyint(scaled);
+    }
+    const uint32_t rebiased = magnitude - 0x38000000;
+    return sign | (uint16_t)((rebiased + 0xFFF + ((rebiased >> 13) & 1)) >> 13);
+}
+
+inline float bf16_bits_to_float(uint16_t h)
+{
+    uint32_t bits = (uint32_t)h << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t float_to_bf16_bits(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if((bits & 0x7FFFFFFF) > 0x7F800000) return (uint16_t)((bits >> 16) | 0x40);
+    return (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+template<bool BF16>
+inline float widen(uint16_t h) { return BF16 ? bf16_bits_to_float(h) : half_bits_to_float(h); }
+
+template<bool BF16>
+inline uint16_t narrow(float f) { return BF16 ? float_to_bf16_bits(f) : float_to_half_bits(f); }
+
+template<bool BF16, typename IndexType>
+inline void csr_row_half_scalar(IndexType begin, IndexType end, const IndexType* column_indices,
+                                const uint16_t* A, const float* x, bool complex, float sign, float& re, float& im)
+{
+    if(!complex)
+    {
+        for(IndexType k = begin; k < end; k++)
+            re += widen<BF16>(A[k]) * x[column_indices[k]];
+        return;
+    }
+    for(IndexType k = begin; k < end; k++)
+    {
+        const float ar = widen<BF16>(A[2 * k]), ai = sign * widen<BF16>(A[2 * k + 1]);
+        const float xr = x[2 * column_indices[k]], xi = x[2 * column_indices[k] + 1];
+        re += ar * xr - ai * xi;
+        im += ar * xi + ai * xr;
+    }
+}
+
+template<bool BF16, typename IndexType>
+void csr_spmv_half_scalar(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                          const uint16_t* A, const float* x, float* y, bool complex, bool conjugate)
+{
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        float re = 0, im = 0;
+        csr_row_half_scalar<BF16>(row_offsets[i], row_offsets[i + 1], column_indices, A, x, complex, conjugate ? -1.f : 1.f, re, im);
+        if(complex)
+        {
+            y[2 * i] = re;
+            y[2 * i + 1] = im;
+        }
+        else y[i] = re;
+    }
+}
+
+#ifdef PUFF_X86_SIMD
+
+// Widening loads: F16C / AVX-512F convert binary16, bfloat16 is the upper half of an fp32 so a shift suffices
+
+template<bool BF16>
+__attribute__((target("avx2,fma,f16c")))
+inline __m256 load8_half(const uint16_t* p)
+{
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    if constexpr(BF16) return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    else return _mm256_cvtph_ps(h);
+}
+
+template<bool BF16>
+__attribute__((target("avx512f")))
+inline __m512 load16_half(const uint16_t* p)
+{
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    if constexpr(BF16) return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+    else return _mm512_cvtph_ps(h);
+}
+
+template<bool BF16, typename IndexType>
+__attribute__((target("avx2,fma,f16c")))
+void csr_spmv_half_avx2(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                        const uint16_t* A, const float* x, float* y, bool complex, bool conjugate)
+{
+    static_assert(sizeof(IndexType) == 4, "32-bit column indices are gathered directly");
+    const __m256 sign = conjugate ? _mm256_setr_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f) : _mm256_setzero_ps();
+    const double* xd = reinterpret_cast<const double*>(x);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m256 acc_r = _mm256_setzero_ps(), acc_i = _mm256_setzero_ps();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        __m256 sum;
+        if(!complex)
+        {
+            for(; k + 8 <= end; k += 8)
+            {
+                __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column_indices + k));
+                acc_r = _mm256_fmadd_ps(load8_half<BF16>(A + k), _mm256_i32gather_ps(x, idx, 4), acc_r);
+            }
+            sum = acc_r;
+        }
+        else
+        {
+            for(; k + 4 <= end; k += 4)
+            {
+                __m256 a = _mm256_xor_ps(load8_half<BF16>(A + 2 * k), sign);
+                __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column_indices + k));
+                __m256 xv = _mm256_castpd_ps(_mm256_i32gather_pd(xd, idx, 8));
+                acc_r = _mm256_fmadd_ps(a, _mm256_moveldup_ps(xv), acc_r);
+                acc_i = _mm256_fmadd_ps(a, _mm256_movehdup_ps(xv), acc_i);
+            }
+            sum = _mm256_addsub_ps(acc_r, _mm256_permute_ps(acc_i, 0xB1));
+        }
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        float out[4];
+        _mm_storeu_ps(out, s);
+        if(!complex) out[0] += out[1];
+        csr_row_half_scalar<BF16>(k, end, column_indices, A, x, complex, conjugate ? -1.f : 1.f, out[0], out[1]);
+        if(complex)
+        {
+            y[2 * i] = out[0];
+            y[2 * i + 1] = out[1];
+        }
+        else y[i] = out[0];
+    }
+}
+
+template<bool BF16, typename IndexType>
+__attribute__((target("avx512f")))
+void csr_spmv_half_avx512(size_t num_rows, const IndexType* row_offsets, const IndexType* column_indices,
+                          const uint16_t* A, const float* x, float* y, bool complex, bool conjugate)
+{
+    static_assert(sizeof(IndexType) == 4, "32-bit column indices are gathered directly");
+    const __m512i sign = conjugate ? _mm512_set1_epi64((long long)0x8000000000000000ULL) : _mm512_setzero_si512();
+    const __m512 ones = _mm512_set1_ps(1.f);
+    const double* xd = reinterpret_cast<const double*>(x);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)num_rows; i++)
+    {
+        __m512 acc_r = _mm512_setzero_ps(), acc_i = _mm512_setzero_ps();
+        IndexType k = row_offsets[i];
+        const IndexType end = row_offsets[i + 1];
+        float out[2] = {0, 0};
+        if(!complex)
+        {
+            for(; k + 16 <= end; k += 16)
+            {
+                __m512i idx = _mm512_loadu_si512(column_indices + k);
+                acc_r = _mm512_fmadd_ps(load16_half<BF16>(A + k), _mm512_i32gather_ps(idx, x, 4), acc_r);
+            }
+            out[0] = _mm512_reduce_add_ps(acc_r);
+        }
+        else
+        {
+            for(; k + 8 <= end; k += 8)
+            {
+                __m512 a = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(load16_half<BF16>(A + 2 * k)), sign));
+                __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column_indices + k));
+                __m512 xv = _mm512_castpd_ps(_mm512_i32gather_pd(idx, xd, 8));
+                acc_r = _mm512_fmadd_ps(a, _mm512_moveldup_ps(xv), acc_r);
+                acc_i = _mm512_fmadd_ps(a, _mm512_movehdup_ps(xv), acc_i);
+            }
+            __m512 sum = _mm512_fmaddsub_ps(acc_r, ones, _mm512_permute_ps(acc_i, 0xB1));
+            // Even lanes hold real parts, odd lanes imaginary parts
+            out[0] = _mm512_mask_reduce_add_ps(0x5555, sum);
+            out[1] = _mm512_mask_reduce_add_ps(0xAAAA, sum);
+        }
+        csr_row_half_scalar<BF16>(k, end, column_indices, A, x, complex, conjugate ? -1.f : 1.f, out[0], out[1]);
+        if(complex)
+        {
+            y[2 * i] = out[0];
+            y[2 * i + 1] = out[1];
+        }
+        else y[i] = out[0];
+    }
+}
+
+template<bool BF16>
+__attribute__((target("avx2,fma,f16c")))
+void half_to_float_avx2(const uint16_t* in, float* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, load8_half<BF16>(in + i));
+    for(; i < n; i++) out[i] = widen<BF16>(in[i]);
+}
+
+template<bool BF16>
+__attribute__((target("avx512f")))
+void half_to_float_avx512(const uint16_t* in, float* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) _mm512_storeu_ps(out + i, load16_half<BF16>(in + i));
+    for(; i < n; i++) out[i] = widen<BF16>(in[i]);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline void float_to_fp16_avx2(const float* in, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    for(; i < n; i++) out[i] = float_to_half_bits(in[i]);
+}
+
+__attribute__((target("avx512f")))
+inline void float_to_fp16_avx512(const float* in, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    for(; i < n; i++) out[i] = float_to_half_bits(in[i]);
+}
+
+// AVX512-BF16 narrows 16 fp32 values per instruction with round to nearest even (fp32 subnormals flush to zero)
+__attribute__((target("avx512f,avx512bf16")))
+inline void float_to_bf16_avx512bf16(const float* in, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), (__m256i)_mm512_cvtneps_pbh(_mm512_loadu_ps(in + i)));
+    for(; i < n; i++) out[i] = float_to_bf16_bits(in[i]);
+}
+
+inline bool cpu_has_avx512bf16()
+{
+    static const bool has = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bf16") != 0;
+    }();
+    return has;
+}
+
+#endif
+
+// Conversions are split into blocks over the OpenMP threads
+constexpr size_t half_block = 1 << 14;
+
+} // namespace detail
+
+template<typename Real, typename IndexType>
+void CSR_SpMV_complex(size_t num_rows,
+                      const IndexType* row_offsets,
+                      const IndexType* column_indices,
+                      const thrust::complex<Real>* values,
+                      const thrust::complex<Real>* x,
+                      thrust::complex<Real>* y,
+                      bool conjugate,
+                      SpMVIsa isa)
+{
+    static_assert(std::is_same_v<Real, double> || std::is_same_v<Real, float>, "CSR_SpMV_complex supports dcomplex and fcomplex");
+    const Real* A = reinterpret_cast<const Real*>(values);
+    const Real* xr = reinterpret_cast<const Real*>(x);
+    Real* yr = reinterpret_cast<Real*>(y);
+    isa = std::min(isa, SpMV_detect_isa());
+#ifdef PUFF_X86_SIMD
+    if constexpr(std::is_same_v<Real, double>)
+    {
+        if(isa == SpMVIsa::AVX512) return detail::csr_spmv_z_avx512(num_rows, row_offsets, column_indices, A, xr, yr, conjugate);
+        if(isa == SpMVIsa::AVX2) return detail::csr_spmv_z_avx2(num_rows, row_offsets, column_indices, A, xr, yr, conjugate);
+    }
+    else if constexpr(sizeof(IndexType) == 4)
+    {
+        if(isa == SpMVIsa::AVX512) return detail::csr_spmv_c_avx512(num_rows, row_offsets, column_indices, A, xr, yr, conjugate);
+        if(isa == SpMVIsa::AVX2) return detail::csr_spmv_c_avx2(num_rows, row_offsets, column_indices, A, xr, yr, conjugate);
+    }
+#endif
+    detail::csr_spmv_complex_scalar(num_rows, row_offsets, column_indices, A, xr, yr, conjugate);
+}
+
+inline void Half_to_float(const uint16_t* in, float* out, size_t n, HalfFormat format)
+{
+    const SpMVIsa isa = SpMV_detect_isa();
+    const bool bf16 = format == HalfFormat::BF16;
+    #pragma omp parallel for schedule(static)
+    for(long long b = 0; b < (long long)((n + detail::half_block - 1) / detail::half_block); b++)
+    {
+        const size_t begin = b * detail::half_block, count = std::min(detail::half_block, n - begin);
+#ifdef PUFF_X86_SIMD
+        if(isa == SpMVIsa::AVX512)
+        {
+            bf16 ? detail::half_to_float_avx512<true>(in + begin, out + begin, count)
+                 : detail::half_to_float_avx512<false>(in + begin, out + begin, count);
+            continue;
+        }
+        if(isa == SpMVIsa::AVX2)
+        {
+            bf16 ? detail::half_to_float_avx2<true>(in + begin, out + begin, count)
+                 : detail::half_to_float_avx2<false>(in + begin, out + begin, count);
+            continue;
+        }
+#endif
+        for(size_t i = begin; i < begin + count; i++)
+            out[i] = bf16 ? detail::bf16_bits_to_float(in[i]) : detail::half_bits_to_float(in[i]);
+    }
+}
+
+inline void Float_to_half(const float* in, uint16_t* out, size_t n, HalfFormat format)
+{
+    const SpMVIsa isa = SpMV_detect_isa();
+    const bool bf16 = format == HalfFormat::BF16;
+    #pragma omp parallel for schedule(static)
+    for(long long b = 0; b < (long long)((n + detail::half_block - 1) / detail::half_block); b++)
+    {
+        const size_t begin = b * detail::half_block, count = std::min(detail::half_block, n - begin);
+#ifdef PUFF_X86_SIMD
+        if(!bf16 && isa == SpMVIsa::AVX512) { detail::float_to_fp16_avx512(in + begin, out + begin, count); continue; }
+        if(!bf16 && isa == SpMVIsa::AVX2) { detail::float_to_fp16_avx2(in + begin, out + begin, count); continue; }
+        if(bf16 && isa == SpMVIsa::AVX512 && detail::cpu_has_avx512bf16()) { detail::float_to_bf16_avx512bf16(in + begin, out + begin, count); continue; }
+#endif
+        for(size_t i = begin; i < begin + count; i++)
+            out[i] = bf16 ? detail::float_to_bf16_bits(in[i]) : detail::float_to_half_bits(in[i]);
+    }
+}
+
+template<typename IndexType>
+void CSR_SpMV_half(size_t num_rows,
+                   const IndexType* row_offsets,
+                   const IndexType* column_indices,
+                   const uint16_t* values,
+                   HalfFormat format,
+                   bool complex,
+                   const float* x,
+                   float* y,
+                   bool conjugate,
+                   SpMVIsa isa)
+{
+    isa = std::min(isa, SpMV_detect_isa());
+    const bool bf16 = format == HalfFormat::BF16;
+#ifdef PUFF_X86_SIMD
+    if constexpr(sizeof(IndexType) == 4)
+    {
+        if(isa == SpMVIsa::AVX512)
+            return bf16 ? detail::csr_spmv_half_avx512<true>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate)
+                        : detail::csr_spmv_half_avx512<false>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate);
+        if(isa == SpMVIsa::AVX2)
+            return bf16 ? detail::csr_spmv_half_avx2<true>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate)
+                        : detail::csr_spmv_half_avx2<false>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate);
+    }
+#endif
+    bf16 ? detail::csr_spmv_half_scalar<true>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate)
+         : detail::csr_spmv_half_scalar<false>(num_rows, row_offsets, column_indices, values, x, y, complex, conjugate);
+}
+
+}
+
+namespace puff{
+
+inline const char* Transpose_strategy_name(TransposeStrategy strategy)
+{
+    switch(strategy)
+    {
+        case TransposeStrategy::Coloring: return "Coloring";
+        case TransposeStrategy::ThreadBuffers: return "ThreadBuffers";
+        case TransposeStrategy::Atomics: return "Atomics";
+        default: return "Auto";
+    }
+}
+
+namespace detail{
+
+template<typename ValueType>
+constexpr bool is_complex_value = std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex> ||
+                                  std::is_same_v<ValueType, hcomplex> || std::is_same_v<ValueType, bcomplex>;
+
+// Types whose components can be updated with omp atomic
+template<typename ValueType>
+constexpr bool has_atomic_update = std::is_same_v<ValueType, double> || std::is_same_v<ValueType, float> ||
+                                   std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>;
+
+template<typename ValueType>
+inline ValueType transpose_value(const ValueType& v, bool conjugate)
+{
+    if constexpr(is_complex_value<ValueType>)
+        if(conjugate) return conjugate_functor<ValueType>()(v);
+    return v;
+}
+
+template<typename ValueType, typename IndexType>
+inline void scatter_rows(IndexType row_begin, IndexType row_end, const IndexType* row_offsets, const IndexType* column_indices,
+                         const ValueType* values, const ValueType* x, ValueType* y, bool conjugate)
+{
+    for(IndexType i = row_begin; i < row_end; i++)
+    {
+        const ValueType xi = x[i];
+        for(IndexType k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+            y[column_indices[k]] = y[column_indices[k]] + transpose_value(values[k], conjugate) * xi;
+    }
+}
+
+} // namespace detail
+
+template<typename ValueType, typename IndexType>
+TransposePlan<IndexType> make_transpose_plan(size_t num_rows,
+                                             size_t num_cols,
+                                             const IndexType* row_offsets,
+                                             const IndexType* column_indices,
+                                             TransposeStrategy strategy,
+                                             int threads)
+{
+    TransposePlan<IndexType> plan;
+    plan.threads = std::max(1, threads);
+    const size_t nnz = num_rows > 0 ? (size_t)row_offsets[num_rows] : 0;
+
+    // nnz balanced row blocks, several per thread so every color can still feed all threads
+    const size_t num_blocks = std::max<size_t>(1, std::min(num_rows, (size_t)(8 * plan.threads)));
+    plan.block_rows.resize(num_blocks + 1);
+    for(size_t b = 0; b <= num_blocks; b++)
+        plan.block_rows[b] = (IndexType)(std::lower_bound(row_offsets, row_offsets + num_rows, (IndexType)(nnz * b / num_blocks)) - row_offsets);
+    plan.block_rows[0] = 0;
+    plan.block_rows[num_blocks] = (IndexType)num_rows;
+
+    // Column range of each block: rows are sorted by column, so first and last entries bound it
+    std::vector<std::pair<IndexType, IndexType>> range(num_blocks, {std::numeric_limits<IndexType>::max(), 0});
+    for(size_t b = 0; b < num_blocks; b++)
+        for(IndexType i = plan.block_rows[b]; i < plan.block_rows[b + 1]; i++)
+            if(row_offsets[i] < row_offsets[i + 1])
+            {
+                range[b].first = std::min(range[b].first, column_indices[row_offsets[i]]);
+                range[b].second = std::max(range[b].second, column_indices[row_offsets[i + 1] - 1]);
+            }
+
+    // Greedy interval coloring in order of range start, optimal for intervals
+    std::vector<int> order(num_blocks), color(num_blocks);
+    for(size_t b = 0; b < num_blocks; b++) order[b] = (int)b;
+    std::sort(order.begin(), order.end(), [&](int u, int v) { return range[u].first < range[v].first; });
+    std::vector<long long> color_end;
+    for(int b : order)
+    {
+        if(range[b].first > range[b].second) { color[b] = 0; if(color_end.empty()) color_end.push_back(-1); continue; } // empty block
+        size_t c = 0;
+        while(c < color_end.size() && color_end[c] >= (long long)range[b].first) c++;
+        if(c == color_end.size()) color_end.push_back(-1);
+        color_end[c] = range[b].second;
+        color[b] = (int)c;
+    }
+    const size_t num_colors = plan.threads == 1 ? 1 : std::max<size_t>(1, color_end.size());
+    if(plan.threads == 1) std::fill(color.begin(), color.end(), 0);
+    plan.color_offsets.assign(num_colors + 1, 0);
+    for(size_t b = 0; b < num_blocks; b++) plan.color_offsets[color[b] + 1]++;
+    for(size_t c = 0; c < num_colors; c++) plan.color_offsets[c + 1] += plan.color_offsets[c];
+    plan.color_blocks.resize(num_blocks);
+    std::vector<int> fill(plan.color_offsets.begin(), plan.color_offsets.end() - 1);
+    for(size_t b = 0; b < num_blocks; b++) plan.color_blocks[fill[color[b]]++] = (int)b;
+
+    if(strategy == TransposeStrategy::Auto)
+    {
+        const double buffer_bytes = (double)plan.threads * num_cols * sizeof(ValueType);
+        const double matrix_bytes = (double)nnz * (sizeof(ValueType) + sizeof(IndexType));
+        if(plan.threads == 1 || num_blocks >= num_colors * (size_t)plan.threads) strategy = TransposeStrategy::Coloring;
+        else if(buffer_bytes <= matrix_bytes || !detail::has_atomic_update<ValueType>) strategy = TransposeStrategy::ThreadBuffers;
+        else strategy = TransposeStrategy::Atomics;
+    }
+    if(strategy == TransposeStrategy::Atomics && !detail::has_atomic_update<ValueType>)
+        strategy = TransposeStrategy::ThreadBuffers;
+    plan.strategy = strategy;
+    return plan;
+}
+
+template<typename ValueType, typename IndexType>
+void CSR_SpMV_transpose(const TransposePlan<IndexType>& plan,
+                        size_t num_rows,
+                        size_t num_cols,
+                        const IndexType* row_offsets,
+                        const IndexType* column_indices,
+                        const ValueType* values,
+                        const ValueType* x,
+                        ValueType* y,
+                        bool conjugate,
+                        std::vector<ValueType>& workspace)
+{
+    const int threads = plan.threads;
+    if(plan.strategy == TransposeStrategy::ThreadBuffers)
+    {
+        workspace.resize((size_t)threads * num_cols);
+        ValueType* buffers = workspace.data();
+        #pragma omp parallel num_threads(threads)
+        {
+            const int t = omp_get_thread_num();
+            ValueType* yt = buffers + (size_t)t * num_cols;
+            std::fill(yt, yt + num_cols, ValueType(0));
+            #pragma omp for schedule(static)
+            for(long long b = 0; b < (long long)plan.block_rows.size() - 1; b++)
+                detail::scatter_rows(plan.block_rows[b], plan.block_rows[b + 1], row_offsets, column_indices, values, x, yt, conjugate);
+            #pragma omp for schedule(static)
+            for(long long j = 0; j < (long long)num_cols; j++)
+            {
+                ValueType sum = buffers[j];
+                for(int u = 1; u < omp_get_num_threads(); u++) sum = sum + buffers[(size_t)u * num_cols + j];
+                y[j] = sum;
+            }
+        }
+        return;
+    }
+
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for(long long j = 0; j < (long long)num_cols; j++) y[j] = ValueType(0);
+
+    if(plan.strategy == TransposeStrategy::Atomics)
+    {
+        if constexpr(detail::has_atomic_update<ValueType>)
+        {
+            #pragma omp parallel for num_threads(threads) schedule(static)
+            for(long long i = 0; i < (long long)num_rows; i++)
+            {
+                const ValueType xi = x[i];
+                for(IndexType k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+                {
+                    const ValueType v = detail::transpose_value(values[k], conjugate) * xi;
+                    if constexpr(detail::is_complex_value<ValueType>)
+                    {
+                        auto* yj = reinterpret_cast<typename ValueType::value_type*>(&y[column_indices[k]]);
+                        #pragma omp atomic
+                        yj[0] += v.real();
+                        #pragma omp atomic
+                        yj[1] += v.imag();
+                    }
+                    else
+                    {
+                        #pragma omp atomic
+                        y[column_indices[k]] += v;
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // Coloring: blocks of one color touch disjoint column ranges of y
+    for(size_t c = 0; c < plan.num_colors(); c++)
+    {
+        #pragma omp parallel for num_threads(threads) schedule(dynamic)
+        for(int p = plan.color_offsets[c]; p < plan.color_offsets[c + 1]; p++)
+        {
+            const int b = plan.color_blocks[p];
+            detail::scatter_rows(plan.block_rows[b], plan.block_rows[b + 1], row_offsets, column_indices, values, x, y, conjugate);
+        }
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+// Merge-based sparse linear combinations of sorted CSR matrices
+namespace puff{
+
+template<typename ValueType, typename IndexType>
+void CSR_add(size_t a_rows,
+             const IndexType* a_offsets,
+             const IndexType* a_indices,
+             const ValueType* a_values,
+             ValueType alpha,
+             size_t b_rows,
+             const IndexType* b_offsets,
+             const IndexType* b_indices,
+             const ValueType* b_values,
+             ValueType beta,
+             std::vector<IndexType>& c_offsets,
+             std::vector<IndexType>& c_indices,
+             std::vector<ValueType>& c_values)
+{
+    const size_t rows = std::max(a_rows, b_rows);
+    auto a_row = [&](size_t i) { return i < a_rows ? std::make_pair(a_offsets[i], a_offsets[i + 1]) : std::make_pair(IndexType(0), IndexType(0)); };
+    auto b_row = [&](size_t i) { return i < b_rows ? std::make_pair(b_offsets[i], b_offsets[i + 1]) : std::make_pair(IndexType(0), IndexType(0)); };
+
+    // Union size of every row, then a prefix sum places the rows of C
+    c_offsets.assign(rows + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(long long i = 0; i < (long long)rows; i++)
+    {
+        auto [ka, ea] = a_row(i);
+        auto [kb, eb] = b_row(i);
+        IndexType count = 0;
+        while(ka < ea && kb < eb)
+        {
+            const IndexType ca = a_indices[ka], cb = b_indices[kb];
+            ka += ca <= cb;
+            kb += cb <= ca;
+            count++;
+        }
+        c_offsets[i + 1] = count + (ea - ka) + (eb - kb);
+    }
+    for(size_t i = 0; i < rows; i++) c_offsets[i + 1] += c_offsets[i];
+
+    const size_t nnz = c_offsets[rows];
+    c_indices.resize(nnz);
+    c_values.resize(nnz);
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(long long i = 0; i < (long long)rows; i++)
+    {
+        auto [ka, ea] = a_row(i);
+        auto [kb, eb] = b_row(i);
+        IndexType k = c_offsets[i];
+        while(ka < ea || kb < eb)
+        {
+            const bool take_a = ka < ea && (kb == eb || a_indices[ka] <= b_indices[kb]);
+            const bool take_b = kb < eb && (ka == ea || b_indices[kb] <= a_indices[ka]);
+            if(take_a && take_b)
+            {
+                c_indices[k] = a_indices[ka];
+                c_values[k] = alpha * a_values[ka++] + beta * b_values[kb++];
+            }
+            else if(take_a)
+            {
+                c_indices[k] = a_indices[ka];
+                c_values[k] = alpha * a_values[ka++];
+            }
+            else
+            {
+                c_indices[k] = b_indices[kb];
+                c_values[k] = beta * b_values[kb++];
+            }
+            k++;
+        }
+    }
+}
+
+template<typename ValueType, typename IndexType>
+bool CSR_add_inplace(size_t a_rows,
+                     const IndexType* a_offsets,
+                     const IndexType* a_indices,
+                     ValueType* a_values,
+                     ValueType alpha,
+                     size_t b_rows,
+                     const IndexType* b_offsets,
+                     const IndexType* b_indices,
+                     const ValueType* b_values,
+                     ValueType beta)
+{
+    // Every column of B has to be found in its row of A before anything is written
+    bool subset = true;
+    #pragma omp parallel for schedule(dynamic, 256) reduction(&&:subset)
+    for(long long i = 0; i < (long long)b_rows; i++)
+    {
+        if(b_offsets[i] == b_offsets[i + 1]) continue;
+        if((size_t)i >= a_rows) { subset = false; continue; }
+        IndexType ka = a_offsets[i];
+        const IndexType ea = a_offsets[i + 1];
+        for(IndexType kb = b_offsets[i]; kb < b_offsets[i + 1] && subset; kb++)
+        {
+            while(ka < ea && a_indices[ka] < b_indices[kb]) ka++;
+            subset = ka < ea && a_indices[ka] == b_indices[kb];
+        }
+    }
+    if(!subset) return false;
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(long long i = 0; i < (long long)a_rows; i++)
+    {
+        IndexType kb = (size_t)i < b_rows ? b_offsets[i] : 0;
+        const IndexType eb = (size_t)i < b_rows ? b_offsets[i + 1] : 0;
+        for(IndexType ka = a_offsets[i]; ka < a_offsets[i + 1]; ka++)
+        {
+            ValueType value = alpha * a_values[ka];
+            if(kb < eb && b_indices[kb] == a_indices[ka])
+                value += beta * b_values[kb++];
+            a_values[ka] = value;
+        }
+    }
+    return true;
+}
+
+}
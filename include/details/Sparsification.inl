@@ -0,0 +1,104 @@
+// Drop policies applied while assembling a sparse matrix
+namespace puff{
+
+namespace detail{
+
+// |v| in double for every stored value type
+template<typename ValueType>
+inline double drop_magnitude(const ValueType& v)
+{
+    if constexpr(std::is_same_v<ValueType, dcomplex> || std::is_same_v<ValueType, fcomplex>)
+        return (double)thrust::abs(v);
+    else if constexpr(std::is_same_v<ValueType, hcomplex> || std::is_same_v<ValueType, bcomplex>)
+        return std::hypot((double)(float)v.real(), (double)(float)v.imag());
+    else if constexpr(std::is_same_v<ValueType, double> || std::is_same_v<ValueType, float>)
+        return std::abs((double)v);
+    else
+        return std::abs((double)(float)v);
+}
+
+} // namespace detail
+
+template<typename ValueType, typename IndexType>
+DropReport Drop_entries(const DropPolicy& policy,
+                        size_t num_rows,
+                        const IndexType* row_offsets,
+                        const IndexType* column_indices,
+                        const ValueType* values,
+                        uint8_t* keep)
+{
+    size_t kept = 0, dropped = 0;
+    double kept_mass = 0.0, dropped_mass = 0.0;
+    #pragma omp parallel reduction(+:kept, dropped, kept_mass, dropped_mass)
+    {
+        std::vector<std::pair<double, IndexType>> ranked;
+        #pragma omp for schedule(dynamic, 256)
+        for(long long i = 0; i < (long long)num_rows; i++)
+        {
+            const IndexType begin = row_offsets[i], end = row_offsets[i + 1];
+            auto is_diagonal = [&](IndexType k) { return column_indices[k] == (IndexType)i; };
+            auto protected_entry = [&](IndexType k) { return policy.keep_diagonal && is_diagonal(k); };
+
+            // Threshold of the row, entries below it are dropped
+            double threshold = 0.0;
+            switch(policy.rule)
+            {
+                case DropRule::Absolute:
+                    threshold = policy.tolerance;
+                    break;
+                case DropRule::RowRelative:
+                {
+                    double norm = 0.0;
+                    for(IndexType k = begin; k < end; k++)
+                    {
+                        const double m = detail::drop_magnitude(values[k]);
+                        norm += m * m;
+                    }
+                    threshold = policy.tolerance * std::sqrt(norm);
+                    break;
+                }
+                case DropRule::DiagonalRelative:
+                {
+                    // Rows are sorted, the diagonal is found by bisection
+                    const IndexType* d = std::lower_bound(column_indices + begin, column_indices + end, (IndexType)i);
+                    if(d != column_indices + end && *d == (IndexType)i)
+                        threshold = policy.tolerance * detail::drop_magnitude(values[d - column_indices]);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            for(IndexType k = begin; k < end; k++)
+                keep[k] = protected_entry(k) || policy.rule == DropRule::TopK || detail::drop_magnitude(values[k]) >= threshold;
+
+            if(policy.rule == DropRule::TopK)
+            {
+                ranked.clear();
+                for(IndexType k = begin; k < end; k++)
+                    if(!protected_entry(k)) ranked.emplace_back(detail::drop_magnitude(values[k]), k);
+                if(ranked.size() > policy.top_k)
+                {
+                    std::nth_element(ranked.begin(), ranked.begin() + policy.top_k, ranked.end(),
+                                     [](const auto& a, const auto& b) { return a.first > b.first; });
+                    for(size_t r = policy.top_k; r < ranked.size(); r++) keep[ranked[r].second] = 0;
+                }
+            }
+
+            for(IndexType k = begin; k < end; k++)
+            {
+                const double m = detail::drop_magnitude(values[k]);
+                if(keep[k]) { kept++; kept_mass += m * m; }
+                else { dropped++; dropped_mass += m * m; }
+            }
+        }
+    }
+    DropReport report;
+    report.kept_entries = kept;
+    report.dropped_entries = dropped;
+    report.kept_norm = std::sqrt(kept_mass);
+    report.dropped_norm = std::sqrt(dropped_mass);
+    return report;
+}
+
+}
@@ -7,6 +7,16 @@
 #include "SparseMatrix.h"
 #include "CConv3D.h"
 #include "PGF.h"
+#include "FarField.h"
+#include "NUFFT.h"
+#include "FieldMap.h"
+#include "Sweep.h"
+#include "FrequencyInterpolation.h"
+#include "NearFieldOperator.h"
+#ifdef USE_MPI
+#include "DistributedSparseMatrix.h"
+#include "DistributedCConv3D.h"
+#endif
 
 namespace puff {
 	
@@ -4,6 +4,8 @@
 #include <thrust/complex.h>
 #include <thrust/transform.h>
 #include <thrust/functional.h>
+#include <thrust/remove.h>
+#include <thrust/iterator/zip_iterator.h>
 #include <thrust/device_ptr.h>
 #include <cusp/coo_matrix.h>
 #include <cusp/multiply.h>
@@ -14,6 +16,8 @@
 #include <cusp/krylov/gmres.h>
 #include <cusp/monitor.h>
 #include <cusp/functional.h>
+#include <cusp/format_utils.h>
+#include <cusp/linear_operator.h>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
@@ -23,6 +27,9 @@
 #include <cuda_bf16.h>
 #include <cuda_fp16.h>
 #include <cuda.h>
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
 
 
 #define CHECK_CUDA(call) { \
@@ -52,9 +59,34 @@
     } \
 }
 
+#define CHECK_MKL_SPARSE(call) { \
+    sparse_status_t err = call; \
+    if(err != SPARSE_STATUS_SUCCESS) { \
+        fprintf(stderr, "MKL sparse error in %s at line %d: status %d\n", \
+        __FILE__, __LINE__, (int)err); \
+        exit(EXIT_FAILURE); \
+    } \
+}
+
+#define CHECK_PARDISO(error) { \
+    if(error != 0) { \
+        fprintf(stderr, "PARDISO error in %s at line %d: %d\n", \
+        __FILE__, __LINE__, (int)error); \
+        exit(EXIT_FAILURE); \
+    } \
+}
+
 
 namespace puff{
 
+#ifndef USE_OPENMP
+    // Serial stand-ins for the OpenMP runtime calls of the host kernels, the pragmas are ignored without OpenMP
+    inline int omp_get_max_threads() { return 1; }
+    inline int omp_get_num_threads() { return 1; }
+    inline int omp_get_thread_num() { return 0; }
+    inline void omp_set_num_threads(int) {}
+#endif
+
     template <typename T>
     struct conjugate_functor {
         __host__ __device__
@@ -1,6 +1,8 @@
 #include "../include/puff.h"
 #include <gtest/gtest.h>
 #include <omp.h>
+#include <map>
+#include <set>
 
 static constexpr int N = 1e6;
 
@@ -275,4 +277,1311 @@ TEST(PUFF, Check_complex_gmres_device)
         EXPECT_NEAR(h_x[i].real(), 1.0, 1e-3);
         EXPECT_NEAR(h_x[i].imag(), 1.0, 1e-3);
     }
-}
\ No newline at end of file
+}
+
+TEST(PUFF, Check_Floquet_far_field_host)
+{
+    const int Ns = 16;
+    const double Lx = 1.0, Ly = 1.0, K0 = 3.0;
+    const std::complex<double> Kx(0.5, 0), Ky(-0.3, 0);
+    puff::Vector_h<double> x(Ns), y(Ns), z(Ns);
+    puff::Vector_h<std::complex<double>> J(Ns);
+    for(int i = 0; i < Ns; i++)
+    {
+        x[i] = 0.05 * i; y[i] = 0.9 - 0.05 * i; z[i] = 0.01 * (i % 3);
+        J[i] = std::complex<double>(1.0 + i, 0.5 * i);
+    }
+
+    // Only the (0,0) mode propagates for K0 < 2 pi - |Kx|, with Kz = sqrt(9 - 0.25 - 0.09)
+    auto modes = puff::Floquet_propagating_modes(Lx, Ly, Kx, Ky, std::complex<double>(K0, 0));
+    ASSERT_EQ(modes.size(), 1u);
+    EXPECT_EQ(modes[0].m, 0);
+    EXPECT_EQ(modes[0].n, 0);
+    const std::complex<double> Kz00(std::sqrt(8.66), 0);
+    EXPECT_NEAR(std::abs(modes[0].Kzmn - Kz00), 0.0, 1e-12);
+
+    // K0 = 7: Kxm = 0.5 + 2 pi m, Kyn = -0.3 + 2 pi n, by hand (0,0), (+-1,0), (0,+-1) propagate while
+    // (-1,-1) gives Kxm^2 + Kyn^2 = 33.4 + 43.3 > 49
+    auto modes7 = puff::Floquet_propagating_modes(Lx, Ly, Kx, Ky, std::complex<double>(7.0, 0));
+    std::set<std::pair<int, int>> mn;
+    for(const auto& mode : modes7) mn.insert({mode.m, mode.n});
+    EXPECT_EQ(modes7.size(), 5u);
+    EXPECT_EQ(mn, (std::set<std::pair<int, int>>{{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}}));
+    puff::Vector_h<std::complex<double>> R, T;
+    puff::Floquet_coefficients(x, y, z, J, Lx, Ly, modes, R, T);
+
+    // Compare against the direct PGF sum far above the array, where evanescent modes vanished
+    double xo = 0.3, yo = 0.7, zo = 6.0;
+    std::complex<double> direct(0, 0);
+    for(int i = 0; i < Ns; i++)
+        direct += J[i] * puff::__2D_PGF__<double>(xo - x[i], yo - y[i], zo - z[i], Lx, Ly, 0.0,
+                                                 Kx, Ky, 0.0, std::complex<double>(K0, 0));
+    auto from_modes = T[0] * std::exp(std::complex<double>(0, -1) * (Kx * xo + Ky * yo + Kz00 * zo));
+    EXPECT_NEAR(std::abs(direct - from_modes) / std::abs(direct), 0.0, 1e-8);
+
+    // Batched radiation pattern against a direct sum
+    const int Na = 300;
+    puff::Vector_h<double> theta(Na), phi(Na);
+    for(int a = 0; a < Na; a++)
+    {
+        theta[a] = puff::M_PI_ * a / (2 * Na);
+        phi[a] = 2 * puff::M_PI_ * a / Na;
+    }
+    puff::Vector_h<std::complex<double>> F;
+    puff::Radiation_pattern(x, y, z, J, 1, theta, phi, K0, F, 64);
+    for(int a = 0; a < Na; a++)
+    {
+        std::complex<double> ref(0, 0);
+        for(int i = 0; i < Ns; i++)
+        {
+            double phase = K0 * (std::sin(theta[a]) * std::cos(phi[a]) * x[i] +
+                                 std::sin(theta[a]) * std::sin(phi[a]) * y[i] +
+                                 std::cos(theta[a]) * z[i]);
+            ref += J[i] * std::exp(std::complex<double>(0, phase));
+        }
+        EXPECT_NEAR(std::abs(F[a] - ref), 0.0, 1e-9 * std::abs(ref) + 1e-12);
+    }
+}
+
+TEST(PUFF, Check_NUFFT_PGF_host)
+{
+    const int Np = 64;
+    const double z = 0.1, Lx = 1.0, Ly = 1.3;
+    const std::complex<double> Kx(0.4, 0), Ky(1.1, 0), K0(3.0, -0.01);
+    puff::Vector_h<double> x(Np), y(Np);
+    for(int j = 0; j < Np; j++)
+    {
+        x[j] = -2.0 + 4.0 * j / Np;
+        y[j] = 1.5 * std::sin(0.37 * j);
+    }
+
+    // Type 1 against the direct sum
+    const size_t N1 = 12, N2 = 9;
+    puff::Vector_h<puff::dcomplex> c(Np), f;
+    for(int j = 0; j < Np; j++)
+        c[j] = puff::dcomplex(std::cos(j), std::sin(2.0 * j));
+    puff::NUFFT3D_h<puff::dcomplex> nufft(N1, N2, 1, 1, 1e-10);
+    nufft.set_points(x, y, puff::Vector_h<double>());
+    nufft.type1(c, f);
+    for(size_t p1 = 0; p1 < N1; p1++)
+    {
+        for(size_t p2 = 0; p2 < N2; p2++)
+        {
+            double k1 = (double)p1 - N1 / 2, k2 = (double)p2 - N2 / 2;
+            puff::dcomplex ref(0, 0);
+            for(int j = 0; j < Np; j++)
+                ref += c[j] * thrust::exp(puff::dcomplex(0, k1 * x[j] + k2 * y[j]));
+            EXPECT_NEAR(thrust::abs(f[p1 * N2 + p2] - ref), 0.0, 1e-8 * Np);
+        }
+    }
+
+    // Floquet sum on a plane against the direct PGF
+    puff::Vector_h<puff::dcomplex> G;
+    puff::__2D_PGF_Plane_NUFFT__<double>(x, y, z, Lx, Ly, Kx, Ky, K0, G);
+    for(int j = 0; j < Np; j++)
+    {
+        auto ref = puff::__2D_PGF__<double>(x[j], y[j], z, Lx, Ly, 0.0, Kx, Ky, 0.0, K0);
+        EXPECT_NEAR(std::abs(std::complex<double>(G[j].real(), G[j].imag()) - ref), 0.0, 1e-8 * std::abs(ref));
+    }
+}
+
+TEST(PUFF, Check_PGF_stream_host)
+{
+    const double Lx = 1.0, Ly = 1.2;
+    const std::complex<double> Kx(0.3, 0), Ky(-0.2, 0), K0(2.0, -0.01);
+    puff::GridDescriptor<double> grid;
+    grid.x0 = -0.5; grid.y0 = -0.6; grid.z0 = 0.2;
+    grid.dx = 0.05; grid.dy = 0.04; grid.dz = 0.1;
+    grid.nx = 20; grid.ny = 30; grid.nz = 2;
+
+    // Tiles smaller than the grid and not dividing it, so the last tile is partial
+    puff::PGFStreamEvaluator<double> evaluator(Lx, Ly, Kx, Ky, K0, 1e-10, 97);
+    std::vector<std::complex<double>> collected(grid.size());
+    std::vector<int> written(grid.size(), 0);
+    size_t n = evaluator.run(grid.generator(), [&](size_t offset, const std::complex<double>* values, size_t count) {
+        for(size_t p = 0; p < count; p++)
+        {
+            collected[offset + p] = values[p];
+            written[offset + p]++;
+        }
+    });
+    ASSERT_EQ(n, grid.size());
+
+    // Written under the test temp directory and removed on every exit path, including failed assertions
+    const std::string path = ::testing::TempDir() + "puff_stream_test.bin";
+    struct RemoveOnExit {
+        const std::string& path;
+        ~RemoveOnExit() { std::remove(path.c_str()); }
+    } remove_on_exit{path};
+    {
+        auto file = std::make_shared<puff::MappedFile>(path, grid.size() * sizeof(std::complex<double>));
+        evaluator.run(grid.generator(), puff::make_mapped_file_sink<double>(file));
+    }
+    puff::MappedFile mapped(path);
+    ASSERT_EQ(mapped.size(), grid.size() * sizeof(std::complex<double>));
+    auto* from_file = static_cast<const std::complex<double>*>(mapped.data());
+
+    for(size_t p = 0; p < grid.size(); p++)
+    {
+        double x, y, z;
+        grid.point(p, x, y, z);
+        auto ref = puff::__2D_PGF__<double>(x, y, z, Lx, Ly, 0.0, Kx, Ky, 0.0, K0);
+        EXPECT_EQ(written[p], 1);
+        EXPECT_EQ(collected[p], ref);
+        EXPECT_EQ(from_file[p], ref);
+    }
+    mapped.close();
+}
+
+TEST(PUFF, Check_PGF_grid_host)
+{
+    const double Lx = 1.0, Ly = 1.2;
+    const std::complex<double> Kx(0.3, 0), Ky(-0.2, 0), K0(2.0, -0.01);
+    for(int periodic = 0; periodic < 2; periodic++)
+    {
+        // Arbitrary spacing goes through the GEMM path, one full period through the FFT path
+        puff::GridDescriptor<double> grid;
+        grid.x0 = -0.5; grid.y0 = -0.6; grid.z0 = 0.2;
+        grid.nx = periodic ? 10 : 13; grid.ny = periodic ? 12 : 7; grid.nz = 3;
+        grid.dx = periodic ? Lx / 10 : 0.07; grid.dy = periodic ? Ly / 12 : 0.09; grid.dz = 0.15;
+
+        puff::Vector_h<std::complex<double>> G;
+        puff::__2D_PGF_Grid__(grid, Lx, Ly, Kx, Ky, K0, G, 0.01, 0.02, -0.03);
+        ASSERT_EQ(G.size(), grid.size());
+        for(size_t p = 0; p < grid.size(); p++)
+        {
+            double x, y, z;
+            grid.point(p, x, y, z);
+            auto ref = puff::__2D_PGF__<double>(x - 0.01, y - 0.02, z + 0.03, Lx, Ly, 0.0, Kx, Ky, 0.0, K0);
+            EXPECT_NEAR(std::abs(G[p] - ref), 0.0, 1e-12 * std::abs(ref));
+        }
+    }
+
+    // Triply periodic grid against the pointwise series. __3D_PGF__ takes the largest coordinate as the
+    // spectral direction, so the planes sit above the in-plane extent of the grid to keep it along z
+    const double Lz = 1.5;
+    const std::complex<double> Kz(0.1, 0);
+    for(int periodic = 0; periodic < 2; periodic++)
+    {
+        puff::GridDescriptor<double> grid;
+        grid.x0 = -0.5; grid.y0 = -0.6; grid.z0 = 0.7;
+        grid.nx = periodic ? 5 : 6; grid.ny = periodic ? 4 : 5; grid.nz = 2;
+        grid.dx = periodic ? Lx / 5 : 0.15; grid.dy = periodic ? Ly / 4 : 0.2; grid.dz = 0.1;
+
+        puff::Vector_h<std::complex<double>> G;
+        puff::__3D_PGF_Grid__(grid, Lx, Ly, Lz, Kx, Ky, Kz, K0, G, 0.01, 0.02, -0.03);
+        ASSERT_EQ(G.size(), grid.size());
+        for(size_t p = 0; p < grid.size(); p++)
+        {
+            double x, y, z;
+            grid.point(p, x, y, z);
+            auto ref = puff::__3D_PGF__<double>(x - 0.01, y - 0.02, z + 0.03, Lx, Ly, Lz, Kx, Ky, Kz, K0);
+            EXPECT_NEAR(std::abs(G[p] - ref), 0.0, 1e-12 * std::abs(ref));
+        }
+    }
+}
+
+TEST(PUFF, Check_Sweep_scheduler_host)
+{
+    std::vector<double> K0s{1.0, 1.5, 2.0, 2.5, 3.0}, Kxs{0.0, 0.1, 0.2}, Kys{0.0, 0.3};
+    puff::SweepScheduler<double> sweep(3, 2);
+    sweep.set_grid(K0s, Kxs, Kys);
+
+    // Every point is visited once, warm starts come from a neighbour one step away
+    auto shared = std::make_shared<const std::vector<double>>(K0s.size() * Kxs.size() * Kys.size(), 2.0);
+    std::vector<std::atomic<int>> visits(shared->size());
+    std::atomic<int> far_neighbours(0), wrong_threads(0);
+    sweep.run(shared, [&](const puff::SweepPoint<double>& point, const puff::SweepContext<double>& context, const std::vector<double>& scale) {
+        visits[point.index] += (int)scale[point.index] / 2;
+        if(context.previous != nullptr)
+        {
+            int steps = (context.previous->K0 != point.K0) + (context.previous->Kx != point.Kx) + (context.previous->Ky != point.Ky);
+            if(steps != 1) far_neighbours++;
+        }
+#ifdef USE_OPENMP
+        #pragma omp parallel
+        {
+            if(omp_get_num_threads() > context.threads) wrong_threads++;
+        }
+#endif
+    });
+
+    for(auto& count : visits)
+        EXPECT_EQ(count.load(), 1);
+    EXPECT_EQ(far_neighbours.load(), 0);
+    EXPECT_EQ(wrong_threads.load(), 0);
+    size_t done = 0;
+    for(auto count : sweep.get_group_points()) done += count;
+    EXPECT_EQ(done, visits.size());
+    EXPECT_GT(sweep.get_points_per_hour(), 0.0);
+    sweep.report();
+}
+
+TEST(PUFF, Check_PGF_frequency_interpolation_host)
+{
+    const double Lx = 1.0, Ly = 1.2, Kx = 0.3, Ky = -0.2, K0_min = 2.0, K0_max = 6.0;
+    std::vector<double> x{0.1, -0.3, 0.25}, y{0.05, 0.4, -0.1}, z{0.2, 0.35, 0.5};
+
+    // Every anomaly is a grazing mode
+    auto anomalies = puff::__Floquet_Wood_anomalies__<double>(Lx, Ly, Kx, Ky, K0_min, K0_max);
+    ASSERT_FALSE(anomalies.empty());
+    for(double w : anomalies)
+    {
+        double closest = 1e300;
+        for(int m = -10; m <= 10; m++)
+            for(int n = -10; n <= 10; n++)
+                closest = std::min(closest, std::abs(puff::__Floquet_Kzmn__<double>(Kx + 2 * puff::M_PI_ * m / Lx, Ky + 2 * puff::M_PI_ * n / Ly, w)));
+        EXPECT_LT(closest, 1e-6);
+    }
+
+    auto evaluator = puff::make_PGF_frequency_evaluator<double>(x, y, z, Lx, Ly, Kx, Ky);
+    puff::FrequencyInterpolant<double> interpolant(x.size(), evaluator, 1e-8);
+    interpolant.build(K0_min, K0_max, anomalies);
+    interpolant.report();
+
+    const int sweep = 1000;
+    std::vector<std::complex<double>> values, ref(x.size());
+    for(int q = 0; q < sweep; q++)
+    {
+        double K0 = K0_min + (K0_max - K0_min) * (q + 0.5) / sweep;
+        interpolant.evaluate(K0, values);
+        evaluator(K0, ref.data());
+        for(size_t p = 0; p < x.size(); p++)
+            EXPECT_NEAR(std::abs(values[p] - ref[p]), 0.0, 1e-6 * std::abs(ref[p]));
+    }
+    // At least 10x fewer evaluations than the sweep (88 for these three anomalies)
+    EXPECT_LE(interpolant.get_build_evaluations() + interpolant.get_direct_evaluations(), (size_t)sweep / 10);
+}
+
+TEST(PUFF, Check_PGF_Wood_anomaly_host)
+{
+    const double Lx = 1.0, Ly = 1.2, Lz = 1.3;
+    const std::complex<double> Kx(0.3, 0), Ky(-0.2, 0), Kz(0.4, 0);
+    auto anomalies = puff::__Floquet_Wood_anomalies__<double>(Lx, Ly, 0.3, -0.2, 4.0, 8.0);
+    ASSERT_FALSE(anomalies.empty());
+    const double w = anomalies.front();
+
+    // The grazing pole is split off, the remainder stays bounded as K0 approaches the anomaly
+    std::complex<double> previous_3D;
+    for(double offset : {1e-6, 1e-9, 1e-12})
+    {
+        std::complex<double> K0(w * (1 + offset), 0), singular;
+        auto regular = puff::__2D_PGF_split__<double>(0.1, 0.2, 0.3, Lx, Ly, 0.0, Kx, Ky, 0.0, K0, singular);
+        auto full = puff::__2D_PGF__<double>(0.1, 0.2, 0.3, Lx, Ly, 0.0, Kx, Ky, 0.0, K0);
+        EXPECT_NEAR(std::abs(regular + singular - full), 0.0, 1e-12 * std::abs(full));
+        EXPECT_LT(std::abs(regular), 10.0);
+        // |Kzmn| ~ w sqrt(2 offset), so the pole grows like 1 / sqrt(offset)
+        EXPECT_GT(std::abs(singular), 0.01 / std::sqrt(offset));
+
+        // The triply periodic series has no pole there, its value converges (like sqrt(offset))
+        auto G3 = puff::__3D_PGF__<double>(0.1, 0.2, 0.3, Lx, Ly, Lz, Kx, Ky, Kz, K0);
+        if(offset < 1e-6)
+            EXPECT_NEAR(std::abs(G3 - previous_3D), 0.0, std::sqrt(1e3 * offset) * std::abs(G3));
+        previous_3D = G3;
+    }
+
+    // Far from the lattice plane the window keeps its z-based size, a grazing mode outside it is still added
+    const double z_far = 5.0;
+    const int M = puff::__Floquet_truncation__<double>(Lx, Ly, z_far, 1e-10 / std::min(Lx, Ly));
+    const std::complex<double> K0(std::sqrt(std::norm(Kx + 2 * puff::M_PI_ * (M + 1) / Lx) + std::norm(Ky)) * (1 + 1e-8), 0);
+    auto grazing = puff::__Floquet_grazing_modes__<double>(Lx, Ly, Kx, Ky, K0, M);
+    ASSERT_EQ(grazing.size(), 1u);
+    EXPECT_EQ(grazing[0], std::make_pair(M + 1, 0));
+    auto G = puff::__2D_PGF__<double>(0.1, 0.2, z_far, Lx, Ly, 0.0, Kx, Ky, 0.0, K0);
+    std::complex<double> ref(0, 0);
+    auto mode = [&](int m, int n) {
+        auto Kxm = Kx + 2 * puff::M_PI_ * m / Lx;
+        auto Kyn = Ky + 2 * puff::M_PI_ * n / Ly;
+        auto Kzmn = puff::__Floquet_Kzmn__<double>(Kxm, Kyn, K0);
+        return std::exp(std::complex<double>(0, -1) * (Kxm * 0.1 + Kyn * 0.2 + Kzmn * z_far)) / (2.0 * std::complex<double>(0, 1) * Kzmn * Lx * Ly);
+    };
+    for(int m = -M; m <= M; m++)
+        for(int n = -M; n <= M; n++)
+            ref += mode(m, n);
+    ref += mode(M + 1, 0);
+    EXPECT_NEAR(std::abs(G - ref), 0.0, 1e-10 * std::abs(ref));
+
+    // Kz Lz a multiple of 2 pi (Gamma point): the bracket has a pole at Kzmn = 0 instead of a zero and
+    // near grazing it must match the direct formula, Kz and Kz + 2 pi / Lz give the same series
+    for(double Kz_gamma : {0.0, 2 * puff::M_PI_ / 1.0})
+    {
+        const std::complex<double> I(0, 1), Kzmn(0.5, 0), Kzg(Kz_gamma, 0);
+        const double z = 0.3, Lz_unit = 1.0;
+        auto direct = (std::exp(-I * Kzmn * z) +
+                       std::exp(-I * (Kzmn - Kzg) * Lz_unit) * std::exp(-I * Kzmn * z) / (1.0 - std::exp(-I * (Kzmn - Kzg) * Lz_unit)) +
+                       std::exp(-I * (Kzmn + Kzg) * Lz_unit) * std::exp(I * Kzmn * z) / (1.0 - std::exp(-I * (Kzmn + Kzg) * Lz_unit))) / Kzmn;
+        auto bracket = puff::__3D_PGF_bracket__<double>(Kzmn, Kzg, z, Lz_unit);
+        EXPECT_TRUE(std::isfinite(bracket.real()) && std::isfinite(bracket.imag()));
+        EXPECT_NEAR(std::abs(bracket - direct), 0.0, 1e-12 * std::abs(direct));
+        EXPECT_NEAR(std::abs(bracket - std::complex<double>(0, -8.043558949)), 0.0, 1e-8);
+    }
+    const std::complex<double> K0_3D(5.0, 0);
+    auto G_gamma = puff::__3D_PGF__<double>(0.1, 0.2, 0.3, Lx, Ly, Lz, Kx, Ky, std::complex<double>(0, 0), K0_3D);
+    auto G_shift = puff::__3D_PGF__<double>(0.1, 0.2, 0.3, Lx, Ly, Lz, Kx, Ky, std::complex<double>(2 * puff::M_PI_ / Lz, 0), K0_3D);
+    EXPECT_TRUE(std::isfinite(G_gamma.real()) && std::isfinite(G_gamma.imag()));
+    EXPECT_NEAR(std::abs(G_gamma - G_shift), 0.0, 1e-8 * std::abs(G_gamma));
+}
+
+TEST(PUFF, Check_Split_complex_host)
+{
+    const int N = 2000;
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+    {
+        A.insert_entry(i, i, puff::dcomplex(4.0, 1.0 + 0.001 * i));
+        if(i > 0) A.insert_entry(i, i - 1, puff::dcomplex(-1.0, 0.5));
+        if(i + 7 < N) A.insert_entry(i, i + 7, puff::dcomplex(0.3, -0.2));
+    }
+    A.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x(N), y(N), y_ref(N);
+    for(int i = 0; i < N; i++)
+        x[i] = puff::dcomplex(std::sin(0.1 * i), std::cos(0.3 * i));
+    puff::SplitVector<double> xs(x), ys;
+
+    // Split SpMV matches the interleaved one, also conjugated and transposed
+    for(int variant = 0; variant < 3; variant++)
+    {
+        bool transpose = variant == 2, conjugate = variant == 1;
+        A.SpMV(x, y_ref, transpose, conjugate);
+        A.SpMV(xs, ys, transpose, conjugate);
+        ys.to_interleaved(y);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(y[i] - y_ref[i]), 0.0, 1e-12);
+    }
+
+    // BLAS-1 against interleaved references
+    puff::dcomplex a(0.5, -1.5);
+    puff::SplitVector<double> zs(ys.size());
+    for(size_t i = 0; i < ys.size(); i++) zs.set(i, ys.get(i));
+    puff::Split_axpy(a, xs, zs);
+    puff::dcomplex dot(0, 0), dotu(0, 0);
+    double norm2 = 0;
+    for(int i = 0; i < N; i++)
+    {
+        EXPECT_NEAR(thrust::abs(zs.get(i) - (a * x[i] + y[i])), 0.0, 1e-12);
+        dot += thrust::conj(x[i]) * y[i];
+        dotu += x[i] * y[i];
+        norm2 += thrust::norm(x[i]);
+    }
+    EXPECT_NEAR(thrust::abs(puff::Split_dot(xs, ys) - dot), 0.0, 1e-9);
+    EXPECT_NEAR(thrust::abs(puff::Split_dot(xs, ys, false) - dotu), 0.0, 1e-9);
+    EXPECT_NEAR(puff::Split_nrm2(xs), std::sqrt(norm2), 1e-9);
+    puff::Vector_element_wise_multiply_Vector(xs, ys, zs);
+    for(int i = 0; i < N; i++)
+        EXPECT_NEAR(thrust::abs(zs.get(i) - x[i] * y[i]), 0.0, 1e-12);
+
+    // The same GMRES solve with either storage
+    puff::Vector_h<puff::dcomplex> b = y_ref, x1(N, puff::dcomplex(0, 0)), x2(N, puff::dcomplex(0, 0));
+    A.SpMV(x, b);
+    A.gmres(x1, b, 30, 500, 1e-10);
+    A.gmres(x2, b, 30, 500, 1e-10, false, puff::ComplexStorage::Split);
+    for(int i = 0; i < N; i++)
+    {
+        EXPECT_NEAR(thrust::abs(x1[i] - x[i]), 0.0, 1e-6);
+        EXPECT_NEAR(thrust::abs(x2[i] - x[i]), 0.0, 1e-6);
+    }
+}
+
+TEST(PUFF, Check_SIMD_SpMV_host)
+{
+    const int N = 3000;
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    puff::SparseMatrix_h<puff::fcomplex> B;
+    for(int i = 0; i < N; i++)
+    {
+        // Rows of 1 to 19 entries exercise the vector loops and the scalar remainders
+        for(int k = 0; k <= i % 19; k++)
+        {
+            int j = (i + 53 * k) % N;
+            A.insert_entry(i, j, puff::dcomplex(1.0 + 0.01 * k, 0.5 - 0.002 * i));
+            B.insert_entry(i, j, puff::fcomplex(1.0f + 0.01f * k, 0.5f - 0.002f * (i % 100)));
+        }
+    }
+    A.make_matrix();
+    B.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x(N), y(N), y_ref(N);
+    puff::Vector_h<puff::fcomplex> xf(N), yf(N), yf_ref(N);
+    for(int i = 0; i < N; i++)
+    {
+        x[i] = puff::dcomplex(std::sin(0.1 * i), std::cos(0.3 * i));
+        xf[i] = puff::fcomplex(x[i].real(), x[i].imag());
+    }
+
+    // Every instruction set up to the one of this CPU matches the generic path, also conjugated
+    for(int isa = 0; isa <= (int)puff::SpMV_detect_isa(); isa++)
+    {
+        for(bool conjugate : {false, true})
+        {
+            A.set_spmv_backend(puff::SpMVBackend::Generic);
+            B.set_spmv_backend(puff::SpMVBackend::Generic);
+            A.SpMV(x, y_ref, false, conjugate);
+            B.SpMV(xf, yf_ref, false, conjugate);
+            A.set_spmv_backend(puff::SpMVBackend::SIMD, (puff::SpMVIsa)isa);
+            B.set_spmv_backend(puff::SpMVBackend::SIMD, (puff::SpMVIsa)isa);
+            A.SpMV(x, y, false, conjugate);
+            B.SpMV(xf, yf, false, conjugate);
+            for(int i = 0; i < N; i++)
+            {
+                EXPECT_NEAR(thrust::abs(y[i] - y_ref[i]), 0.0, 1e-12);
+                EXPECT_NEAR(thrust::abs(yf[i] - yf_ref[i]), 0.0, 1e-3);
+            }
+        }
+    }
+
+    // In-place product and a GMRES solve on the SIMD path
+    A.set_spmv_backend(puff::SpMVBackend::Generic);
+    A.SpMV(x, y_ref);
+    A.set_spmv_backend(puff::SpMVBackend::SIMD);
+    y = x;
+    A.SpMV(y, y);
+    for(int i = 0; i < N; i++)
+        EXPECT_NEAR(thrust::abs(y[i] - y_ref[i]), 0.0, 1e-12);
+
+    puff::SparseMatrix_h<puff::dcomplex> M;
+    for(int i = 0; i < N; i++)
+    {
+        M.insert_entry(i, i, puff::dcomplex(4.0, 1.0));
+        if(i > 0) M.insert_entry(i, i - 1, puff::dcomplex(-1.0, 0.5));
+        if(i + 7 < N) M.insert_entry(i, i + 7, puff::dcomplex(0.3, -0.2));
+    }
+    M.make_matrix();
+    M.set_spmv_backend(puff::SpMVBackend::SIMD);
+    puff::Vector_h<puff::dcomplex> b(N), x0(N, puff::dcomplex(0, 0));
+    M.SpMV(x, b);
+    M.gmres(x0, b, 30, 500, 1e-10);
+    for(int i = 0; i < N; i++)
+        EXPECT_NEAR(thrust::abs(x0[i] - x[i]), 0.0, 1e-6);
+}
+
+TEST(PUFF, Check_Half_SpMV_host)
+{
+    const int N = 3000;
+    puff::SparseMatrix_h<half> A;
+    puff::SparseMatrix_h<puff::bcomplex> B;
+    for(int i = 0; i < N; i++)
+        for(int k = 0; k <= i % 37; k++)
+        {
+            int j = (i + 53 * k) % N;
+            A.insert_entry(i, j, half(0.5f + 0.01f * k));
+            B.insert_entry(i, j, puff::bcomplex(__nv_bfloat16(0.5f + 0.01f * k), __nv_bfloat16(0.25f - 0.001f * (i % 100))));
+        }
+    A.make_matrix();
+    B.make_matrix();
+
+    puff::Vector_h<half> x(N), y(N);
+    puff::Vector_h<puff::bcomplex> xb(N), yb(N);
+    for(int i = 0; i < N; i++)
+    {
+        x[i] = half(std::sin(0.1f * i));
+        xb[i] = puff::bcomplex(__nv_bfloat16(std::sin(0.1f * i)), __nv_bfloat16(std::cos(0.3f * i)));
+    }
+
+    // Double precision references from the stored 16-bit values
+    std::vector<double> ref(N, 0);
+    std::vector<std::complex<double>> ref_b(N, 0), ref_bc(N, 0);
+    auto& a = A.get_matrix();
+    for(size_t k = 0; k < a.num_entries; k++)
+        ref[a.row_indices[k]] += (double)__half2float(a.values[k]) * __half2float(x[a.column_indices[k]]);
+    auto& b = B.get_matrix();
+    for(size_t k = 0; k < b.num_entries; k++)
+    {
+        std::complex<double> v(__bfloat162float(b.values[k].real()), __bfloat162float(b.values[k].imag()));
+        std::complex<double> xv(__bfloat162float(xb[b.column_indices[k]].real()), __bfloat162float(xb[b.column_indices[k]].imag()));
+        ref_b[b.row_indices[k]] += v * xv;
+        ref_bc[b.row_indices[k]] += std::conj(v) * xv;
+    }
+
+    puff::Vector_h<float> yf(N);
+    puff::Vector_h<puff::fcomplex> yc(N);
+    for(int isa = 0; isa <= (int)puff::SpMV_detect_isa(); isa++)
+    {
+        A.set_spmv_backend(puff::SpMVBackend::SIMD, (puff::SpMVIsa)isa);
+        B.set_spmv_backend(puff::SpMVBackend::SIMD, (puff::SpMVIsa)isa);
+
+        // fp32 output keeps the fp32 accumulation, 16-bit output is rounded once at the end
+        A.SpMV_mixed(x, yf);
+        A.SpMV(x, y);
+        for(int i = 0; i < N; i++)
+        {
+            EXPECT_NEAR(yf[i], ref[i], 1e-4);
+            EXPECT_NEAR(__half2float(y[i]), ref[i], 1e-3 * (1 + std::abs(ref[i])));
+        }
+        for(bool conjugate : {false, true})
+        {
+            B.SpMV_mixed(xb, yc, conjugate);
+            B.SpMV(xb, yb, false, conjugate);
+            auto& r = conjugate ? ref_bc : ref_b;
+            for(int i = 0; i < N; i++)
+            {
+                EXPECT_NEAR(std::abs(std::complex<double>(yc[i].real(), yc[i].imag()) - r[i]), 0.0, 1e-4);
+                EXPECT_NEAR(std::abs(std::complex<double>(__bfloat162float(yb[i].real()), __bfloat162float(yb[i].imag())) - r[i]), 0.0,
+                            1e-2 * (1 + std::abs(r[i])));
+            }
+        }
+    }
+}
+
+TEST(PUFF, Check_Transpose_SpMV_host)
+{
+    const int N = 4000;
+    // Banded rows color well, scattered rows fall back to buffers or atomics
+    for(bool scattered : {false, true})
+    {
+        puff::SparseMatrix_h<puff::dcomplex> A;
+        for(int i = 0; i < N; i++)
+            for(int k = -5; k <= 5; k++)
+            {
+                int j = scattered ? (i * 7919 + k * 104729 + N) % N : i + 13 * k;
+                if(j >= 0 && j < N) A.insert_entry(i, j, puff::dcomplex(1.0 + 0.1 * k, 0.01 * (i % 17)));
+            }
+        A.make_matrix();
+
+        puff::Vector_h<puff::dcomplex> x(N), y(N);
+        for(int i = 0; i < N; i++)
+            x[i] = puff::dcomplex(std::sin(0.1 * i), std::cos(0.3 * i));
+
+        std::vector<puff::dcomplex> ref(N, 0), ref_h(N, 0);
+        auto& a = A.get_matrix();
+        for(size_t k = 0; k < a.num_entries; k++)
+        {
+            ref[a.column_indices[k]] += a.values[k] * x[a.row_indices[k]];
+            ref_h[a.column_indices[k]] += thrust::conj(a.values[k]) * x[a.row_indices[k]];
+        }
+
+        for(auto strategy : {puff::TransposeStrategy::Auto, puff::TransposeStrategy::Coloring,
+                             puff::TransposeStrategy::ThreadBuffers, puff::TransposeStrategy::Atomics})
+        {
+            A.set_transpose_strategy(strategy);
+            if(strategy != puff::TransposeStrategy::Auto)
+                EXPECT_EQ(A.get_transpose_strategy(), strategy);
+            for(bool conjugate : {false, true})
+            {
+                A.SpMV(x, y, true, conjugate);
+                auto& r = conjugate ? ref_h : ref;
+                for(int i = 0; i < N; i++)
+                    EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-12);
+            }
+        }
+
+        // In place
+        y = x;
+        A.SpMV(y, y, true);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(y[i] - ref[i]), 0.0, 1e-12);
+    }
+}
+
+TEST(PUFF, Check_Concurrent_insertion_host)
+{
+    const int N = 20000;
+    // A small hint overflows some probe windows, those entries go through the locked map
+    for(size_t hint : {(size_t)(9 * N), (size_t)N})
+    {
+        puff::SparseMatrix_h<puff::dcomplex> A, B;
+        A.insert_entry(0, 0, puff::dcomplex(5.0, 5.0)); // moved into the table by the hint
+        A.set_capacity_hint(hint);
+        #pragma omp parallel for
+        for(int i = 0; i < N; i++)
+            for(int k = -4; k <= 4; k++)
+                if(i + 37 * k >= 0 && i + 37 * k < N)
+                {
+                    A.insert_entry(i, i + 37 * k, puff::dcomplex(i, k));
+                    B.insert_entry(i, i + 37 * k, puff::dcomplex(i, k));
+                }
+        // Overwrites, removals and explicit zeros behave as with the map alone
+        #pragma omp parallel for
+        for(int i = 0; i < N; i += 3)
+        {
+            A.insert_entry(i, i, puff::dcomplex(-1.0, 2.0));
+            B.insert_entry(i, i, puff::dcomplex(-1.0, 2.0));
+            if(i + 37 < N)
+            {
+                A.remove_entry(i, i + 37);
+                B.remove_entry(i, i + 37);
+            }
+        }
+        A.make_matrix();
+        B.make_matrix();
+
+        auto& a = A.get_matrix();
+        auto& b = B.get_matrix();
+        ASSERT_EQ(a.num_entries, b.num_entries);
+        for(size_t k = 0; k < a.num_entries; k++)
+        {
+            EXPECT_EQ(a.row_indices[k], b.row_indices[k]);
+            EXPECT_EQ(a.column_indices[k], b.column_indices[k]);
+            EXPECT_EQ(a.values[k], b.values[k]);
+        }
+    }
+}
+
+TEST(PUFF, Check_Pattern_hint_insertion_host)
+{
+    const int N = 20000;
+    // Exact, under-estimated (rows spill into the table / map) and partial (rows beyond the hint) patterns
+    for(int variant = 0; variant < 3; variant++)
+    {
+        puff::SparseMatrix_h<puff::dcomplex> A, B;
+        A.insert_entry(5, 5, puff::dcomplex(3.0, 0.0)); // moved into the buckets by the hint
+        if(variant == 1) A.reserve(2 * N);
+        const size_t slots = A.get_table_capacity();
+        if(variant == 1) EXPECT_GE(slots, (size_t)(2 * N));
+        if(variant == 2) A.set_pattern_hint(N / 2, 9);
+        else A.set_pattern_hint(N, variant == 0 ? 9 : 4);
+        // The pattern hint keeps the reserved table, both hints last over repeated assemblies
+        EXPECT_EQ(A.get_table_capacity(), slots);
+        const size_t bucket_capacity = A.get_bucket_capacity();
+        for(int assembly = 0; assembly < 2; assembly++)
+        {
+            if(assembly > 0) A.insert_entry(5, 5, puff::dcomplex(3.0, 0.0));
+            B.insert_entry(5, 5, puff::dcomplex(3.0, 0.0));
+            #pragma omp parallel for
+            for(int i = 0; i < N; i++)
+                for(int k = 4; k >= -4; k--)
+                    if(i + 37 * k >= 0 && i + 37 * k < N && !(i == 5 && k == 0))
+                    {
+                        A.insert_entry(i, i + 37 * k, puff::dcomplex(i, k + assembly));
+                        B.insert_entry(i, i + 37 * k, puff::dcomplex(i, k + assembly));
+                    }
+            #pragma omp parallel for
+            for(int i = 0; i < N; i += 3)
+            {
+                A.insert_entry(i, i, puff::dcomplex(-1.0, 2.0));
+                B.insert_entry(i, i, puff::dcomplex(-1.0, 2.0));
+                if(i + 37 < N)
+                {
+                    A.remove_entry(i, i + 37);
+                    B.remove_entry(i, i + 37);
+                }
+            }
+            A.make_matrix();
+            B.make_matrix();
+            EXPECT_EQ(A.get_table_capacity(), slots);
+            EXPECT_EQ(A.get_bucket_capacity(), bucket_capacity);
+
+            auto& a = A.get_matrix();
+            auto& b = B.get_matrix();
+            ASSERT_EQ(a.num_entries, b.num_entries);
+            for(size_t k = 0; k < a.num_entries; k++)
+            {
+                EXPECT_EQ(a.row_indices[k], b.row_indices[k]);
+                EXPECT_EQ(a.column_indices[k], b.column_indices[k]);
+                EXPECT_EQ(a.values[k], b.values[k]);
+            }
+        }
+    }
+}
+
+TEST(PUFF, Check_MKL_SpMV_host)
+{
+    const int N = 3000;
+    puff::SparseMatrix_h<puff::dcomplex> A, B;
+    for(int i = 0; i < N; i++)
+        for(int k = -3; k <= 3; k++)
+        {
+            int j = (i * 31 + k * 997 + N) % N;
+            A.insert_entry(i, j, puff::dcomplex(1.0 + 0.1 * k, 0.02 * (i % 11)));
+            B.insert_entry(i, j, puff::dcomplex(1.0 + 0.1 * k, 0.02 * (i % 11)));
+        }
+    A.set_spmv_backend(puff::SpMVBackend::MKL);
+    A.set_mv_hint(50, {puff::SpMVOperation::NonTranspose, puff::SpMVOperation::Transpose, puff::SpMVOperation::ConjugateTranspose});
+    A.make_matrix();
+    B.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x(N), y(N), r(N);
+    for(int i = 0; i < N; i++)
+        x[i] = puff::dcomplex(std::sin(0.1 * i), std::cos(0.3 * i));
+
+    // Every operation against the generic path
+    for(bool transpose : {false, true})
+        for(bool conjugate : {false, true})
+        {
+            A.SpMV(x, y, transpose, conjugate);
+            B.SpMV(x, r, transpose, conjugate);
+            for(int i = 0; i < N; i++)
+                EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-12);
+        }
+
+    // y = alpha * A^H * x + beta * y, and in place
+    puff::dcomplex alpha(0.5, -1.0), beta(2.0, 0.25);
+    for(bool conjugate : {false, true})
+    {
+        y = x;
+        r = x;
+        A.SpMVP(alpha, x, beta, y, false, conjugate);
+        B.SpMVP(alpha, x, beta, r, false, conjugate);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-11);
+    }
+    y = x;
+    A.SpMV(y, y, true, true);
+    B.SpMV(x, r, true, true);
+    for(int i = 0; i < N; i++)
+        EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-12);
+
+    // Real matrices take the same backend
+    puff::SparseMatrix_h<double> C;
+    for(int i = 0; i < N; i++)
+    {
+        C.insert_entry(i, i, 4.0);
+        if(i > 0) C.insert_entry(i, i - 1, -1.0);
+    }
+    C.set_spmv_backend(puff::SpMVBackend::MKL);
+    C.make_matrix();
+    puff::Vector_h<double> u(N, 1.0), v(N);
+    C.SpMV(u, v);
+    EXPECT_NEAR(v[0], 4.0, 1e-14);
+    for(int i = 1; i < N; i++)
+        EXPECT_NEAR(v[i], 3.0, 1e-14);
+}
+
+TEST(PUFF, Check_SpGEMM_host)
+{
+    const int N = 1500, M = N / 4;
+    auto fill = [&](puff::SparseMatrix_h<puff::dcomplex>& A, double scale) {
+        for(int i = 0; i < N; i++)
+            for(int k = -2; k <= 2; k++)
+            {
+                int j = (i + 53 * k + N) % N;
+                A.insert_entry(i, j, puff::dcomplex(scale * (1.0 + 0.1 * k), 0.01 * (i % 13)));
+            }
+        A.make_matrix();
+    };
+    // Reference products on std::map, rows of the result in column order
+    using Dense = std::map<std::pair<size_t, size_t>, puff::dcomplex>;
+    auto to_map = [](puff::SparseMatrix_h<puff::dcomplex>& A) {
+        Dense d;
+        auto& a = A.get_matrix();
+        for(size_t k = 0; k < a.num_entries; k++) d[{a.row_indices[k], a.column_indices[k]}] += a.values[k];
+        return d;
+    };
+    auto product = [](const Dense& a, const Dense& b, bool conjugate_a_transpose) {
+        Dense c;
+        for(auto& [ik, x] : a)
+        {
+            auto [i, k] = ik;
+            if(conjugate_a_transpose) std::swap(i, k);
+            for(auto it = b.lower_bound({k, 0}); it != b.end() && it->first.first == k; ++it)
+                c[{i, it->first.second}] += (conjugate_a_transpose ? thrust::conj(x) : x) * it->second;
+        }
+        return c;
+    };
+    auto expect_equal = [](puff::SparseMatrix_h<puff::dcomplex>& C, const Dense& ref) {
+        auto& c = C.get_matrix();
+        ASSERT_EQ(c.num_entries, ref.size());
+        size_t k = 0;
+        for(auto& [ij, value] : ref)
+        {
+            EXPECT_EQ(c.row_indices[k], ij.first);
+            EXPECT_EQ(c.column_indices[k], ij.second);
+            EXPECT_NEAR(thrust::abs(c.values[k] - value), 0.0, 1e-12);
+            k++;
+        }
+    };
+
+    puff::SparseMatrix_h<puff::dcomplex> P;
+    for(int i = 0; i < N; i++)
+    {
+        P.insert_entry(i, i / 4, puff::dcomplex(1.0, 0.5));
+        if(i % 4 == 3 && i / 4 + 1 < M) P.insert_entry(i, i / 4 + 1, puff::dcomplex(0.5, -0.25));
+    }
+    P.make_matrix();
+
+    for(auto accumulator : {puff::SpGEMMAccumulator::Auto, puff::SpGEMMAccumulator::Dense, puff::SpGEMMAccumulator::Hash})
+    {
+        puff::SpGEMMPlan<INDEX_TYPE> plan, triple;
+        // The second pass changes only values, both plans are reused
+        for(double scale : {1.0, 2.5})
+        {
+            puff::SparseMatrix_h<puff::dcomplex> A, C, G;
+            fill(A, scale);
+            C.multiply(A, A, plan, accumulator);
+            if(accumulator != puff::SpGEMMAccumulator::Auto)
+                EXPECT_EQ(plan.accumulator, accumulator);
+            auto a = to_map(A);
+            expect_equal(C, product(a, a, false));
+
+            G.triple_product(P, A, triple, true, accumulator);
+            auto p = to_map(P);
+            expect_equal(G, product(p, product(a, p, false), true));
+        }
+
+        // Same shapes and entry counts but one entry moved: the pattern fingerprints rerun the symbolic phase
+        puff::SparseMatrix_h<puff::dcomplex> A, S, C, G;
+        fill(A, 1.0);
+        for(auto& [ij, value] : to_map(A))
+            S.insert_entry(ij.first, ij.first == 7 && ij.second == 7 ? 8 : ij.second, value);
+        S.make_matrix();
+        ASSERT_EQ(S.get_matrix().num_entries, A.get_matrix().num_entries);
+        auto s = to_map(S), p = to_map(P);
+        C.multiply(S, S, plan, accumulator);
+        expect_equal(C, product(s, s, false));
+        G.triple_product(P, S, triple, true, accumulator);
+        expect_equal(G, product(p, product(s, p, false), true));
+    }
+
+    // Shapes come from the largest indices: operands whose trailing rows are empty are padded, not read past
+    puff::SparseMatrix_h<puff::dcomplex> A, B, Q, C, G, H;
+    fill(A, 1.0);
+    auto a = to_map(A);
+    for(auto& [ij, value] : a)
+    {
+        if(ij.first < N - 7) B.insert_entry(ij.first, ij.second, value);
+        if(ij.first < N - 4) Q.insert_entry(ij.first, ij.second / 4, value);
+    }
+    B.make_matrix();
+    Q.make_matrix();
+    auto b = to_map(B), q = to_map(Q);
+    C.multiply(A, B);
+    expect_equal(C, product(a, b, false));
+    G.triple_product(P, B, true);
+    auto p = to_map(P);
+    expect_equal(G, product(p, product(b, p, false), true));
+    H.triple_product(Q, A, true);
+    expect_equal(H, product(q, product(a, q, false), true));
+}
+
+TEST(PUFF, Check_Sparse_add_host)
+{
+    const int N = 2000;
+    // Near field, precorrection on a sub-pattern and coupling terms off the band
+    puff::SparseMatrix_h<puff::dcomplex> A, B, D, R;
+    for(int i = 0; i < N; i++)
+        for(int k = -3; k <= 3; k++)
+        {
+            int j = i + 41 * k;
+            if(j < 0 || j >= N) continue;
+            A.insert_entry(i, j, puff::dcomplex(1.0 + k, 0.1 * (i % 7)));
+            if(k % 2 == 0) B.insert_entry(i, j, puff::dcomplex(0.5, -0.25 * k));
+        }
+    for(int i = 0; i < N; i += 2)
+        D.insert_entry(i, i + 1, puff::dcomplex(2.0, 1.0));
+    A.make_matrix();
+    B.make_matrix();
+    D.make_matrix();
+
+    puff::dcomplex alpha(1.0, 0.5), beta(-1.0, 0.0);
+    for(int i = 0; i < N; i++)
+        for(int k = -3; k <= 3; k++)
+        {
+            int j = i + 41 * k;
+            if(j < 0 || j >= N) continue;
+            R.insert_entry(i, j, alpha * puff::dcomplex(1.0 + k, 0.1 * (i % 7)) + (k % 2 == 0 ? beta * puff::dcomplex(0.5, -0.25 * k) : puff::dcomplex(0.0)));
+        }
+    for(int i = 0; i < N; i += 2)
+        R.insert_entry(i, i + 1, puff::dcomplex(2.0, 1.0));
+    R.make_matrix();
+
+    auto expect_equal = [](puff::SparseMatrix_h<puff::dcomplex>& X, puff::SparseMatrix_h<puff::dcomplex>& Y) {
+        auto& x = X.get_matrix();
+        auto& y = Y.get_matrix();
+        ASSERT_EQ(x.num_entries, y.num_entries);
+        for(size_t k = 0; k < x.num_entries; k++)
+        {
+            EXPECT_EQ(x.row_indices[k], y.row_indices[k]);
+            EXPECT_EQ(x.column_indices[k], y.column_indices[k]);
+            EXPECT_NEAR(thrust::abs(x.values[k] - y.values[k]), 0.0, 1e-12);
+        }
+    };
+
+    // Union of patterns, then terms on a pattern not contained in A
+    puff::SparseMatrix_h<puff::dcomplex> C;
+    C.add(alpha, A, beta, B);
+    C.add(puff::dcomplex(1.0), C, puff::dcomplex(1.0), D);
+    expect_equal(C, R);
+
+    // In place: B is inside the pattern of A, D is not
+    EXPECT_TRUE(A.add_inplace(alpha, beta, B));
+    EXPECT_FALSE(A.add_inplace(puff::dcomplex(1.0), puff::dcomplex(1.0), D));
+    puff::SparseMatrix_h<puff::dcomplex> E;
+    E.add(puff::dcomplex(1.0), A, puff::dcomplex(1.0), D);
+    expect_equal(E, R);
+}
+
+TEST(PUFF, Check_Drop_policy_host)
+{
+    const int N = 1000;
+    // Diagonally dominant rows with entries decaying away from the diagonal
+    auto assemble = [&](puff::SparseMatrix_h<puff::dcomplex>& A, const puff::DropPolicy& policy) {
+        A.set_drop_policy(policy);
+        for(int i = 0; i < N; i++)
+            for(int k = -6; k <= 6; k++)
+                if(i + k >= 0 && i + k < N)
+                    A.insert_entry(i, i + k, puff::dcomplex(10.0 * std::pow(0.1, std::abs(k)), 0.5 * std::pow(0.1, std::abs(k))));
+        A.make_matrix();
+    };
+    puff::SparseMatrix_h<puff::dcomplex> full;
+    assemble(full, puff::DropPolicy());
+    EXPECT_EQ(full.get_drop_report().dropped_entries, 0u);
+    const double diagonal = thrust::abs(puff::dcomplex(10.0, 0.5));
+
+    std::vector<puff::DropPolicy> policies(3);
+    policies[0] = {puff::DropRule::Absolute, 5e-3 * diagonal};
+    policies[1] = {puff::DropRule::RowRelative, 5e-3};
+    policies[2] = {puff::DropRule::DiagonalRelative, 5e-3};
+    for(auto& policy : policies)
+    {
+        puff::SparseMatrix_h<puff::dcomplex> A;
+        assemble(A, policy);
+        auto& a = A.get_matrix();
+        auto report = A.get_drop_report();
+        EXPECT_EQ(report.kept_entries, a.num_entries);
+        EXPECT_EQ(report.kept_entries + report.dropped_entries, full.get_num_entries());
+        EXPECT_EQ(a.num_rows, (size_t)N);
+        EXPECT_EQ(a.num_cols, (size_t)N);
+
+        // Every threshold lands between |k| = 2 and |k| = 3
+        for(size_t k = 0; k < a.num_entries; k++)
+            EXPECT_LE(std::abs((int)a.column_indices[k] - (int)a.row_indices[k]), 2);
+        double dropped = 0.0;
+        size_t kept = 0;
+        for(int i = 0; i < N; i++)
+            for(int k = -6; k <= 6; k++)
+                if(i + k >= 0 && i + k < N)
+                {
+                    if(std::abs(k) <= 2) kept++;
+                    else dropped += std::pow(diagonal * std::pow(0.1, std::abs(k)), 2);
+                }
+        EXPECT_EQ(a.num_entries, kept);
+        EXPECT_NEAR(report.dropped_norm, std::sqrt(dropped), 1e-9 * std::sqrt(dropped));
+        EXPECT_GT(report.relative_dropped_norm(), 0.0);
+        EXPECT_LT(report.relative_dropped_norm(), 1e-2);
+    }
+
+    // Top 4 off-diagonal entries of each row plus the diagonal, the nearest ones
+    puff::SparseMatrix_h<puff::dcomplex> T;
+    assemble(T, {puff::DropRule::TopK, 0.0, 4});
+    auto& t = T.get_matrix();
+    auto& offsets = T.get_row_offsets();
+    for(int i = 0; i < N; i++)
+    {
+        std::vector<int> distances;
+        for(int k = -6; k <= 6; k++)
+            if(k != 0 && i + k >= 0 && i + k < N) distances.push_back(std::abs(k));
+        std::sort(distances.begin(), distances.end());
+        ASSERT_EQ(offsets[i + 1] - offsets[i], 5u);
+        int farthest = 0;
+        for(auto k = offsets[i]; k < offsets[i + 1]; k++)
+            farthest = std::max(farthest, std::abs((int)t.column_indices[k] - i));
+        EXPECT_EQ(farthest, distances[3]);
+    }
+    EXPECT_EQ(T.get_drop_report().kept_entries, 5u * N);
+}
+
+TEST(PUFF, Check_Near_field_operator_host)
+{
+    const int N = 2000;
+    auto value = [](INDEX_TYPE i, INDEX_TYPE j) {
+        double r = 1.0 + std::abs((double)i - (double)j);
+        return puff::dcomplex(std::cos(0.3 * r), -std::sin(0.3 * r)) / r + (i == j ? puff::dcomplex(4.0, 0.0) : puff::dcomplex(0.0));
+    };
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+        for(int k = -4; k <= 4; k++)
+            if(i + 29 * k >= 0 && i + 29 * k < N)
+                A.insert_entry(i, i + 29 * k, value(i, i + 29 * k));
+    A.make_matrix();
+
+    // Scalar kernel, and batched kernel with a cache holding the diagonal-heavy rows
+    auto batched = [&](INDEX_TYPE i, const INDEX_TYPE* cols, size_t n, puff::dcomplex* out) {
+        for(size_t k = 0; k < n; k++) out[k] = value(i, cols[k]);
+    };
+    puff::NearFieldOperator<puff::dcomplex, decltype(value)> F(value);
+    puff::NearFieldOperator<puff::dcomplex, decltype(batched)> G(batched);
+    F.set_pattern(A);
+    G.set_pattern(A);
+    G.set_cache_budget(A.get_num_entries() / 4 * sizeof(puff::dcomplex));
+    std::vector<double> cost(N, 1.0);
+    for(int i = 0; i < N; i += 10) cost[i] = 50.0;
+    G.set_row_cost(cost);
+    EXPECT_EQ(F.get_num_entries(), A.get_num_entries());
+
+    puff::Vector_h<puff::dcomplex> x(N), y(N), r(N);
+    for(int i = 0; i < N; i++)
+        x[i] = puff::dcomplex(std::sin(0.1 * i), std::cos(0.3 * i));
+    for(bool transpose : {false, true})
+        for(bool conjugate : {false, true})
+        {
+            A.SpMV(x, r, transpose, conjugate);
+            F.SpMV(x, y, transpose, conjugate);
+            for(int i = 0; i < N; i++)
+                EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-12);
+            G.SpMV(x, y, transpose, conjugate);
+            for(int i = 0; i < N; i++)
+                EXPECT_NEAR(thrust::abs(y[i] - r[i]), 0.0, 1e-12);
+        }
+    EXPECT_GT(G.get_cached_rows(), (size_t)N / 10);
+    EXPECT_LE(G.get_cache_bytes(), A.get_num_entries() / 4 * sizeof(puff::dcomplex));
+
+    // Same solve as the assembled matrix
+    puff::Vector_h<puff::dcomplex> xa(N, 0), xf(N, 0);
+    A.gmres(xa, x, 50, 200, 1e-10);
+    F.gmres(xf, x, 50, 200, 1e-10);
+    for(int i = 0; i < N; i++)
+        EXPECT_NEAR(thrust::abs(xa[i] - xf[i]), 0.0, 1e-8);
+}
+
+TEST(PUFF, Check_Equilibration_host)
+{
+    const int N = 1500;
+    // Rows scaled by element size over several decades, a well conditioned matrix underneath
+    auto row_factor = [](int i) { return std::pow(10.0, (i % 7) - 3); };
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+        for(int k = -3; k <= 3; k++)
+            if(i + 13 * k >= 0 && i + 13 * k < N)
+                A.insert_entry(i, i + 13 * k, row_factor(i) * (k == 0 ? puff::dcomplex(6.0, 1.0) : puff::dcomplex(0.5, 0.2 * k)));
+    A.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x_ref(N), b(N), x(N, 0);
+    for(int i = 0; i < N; i++)
+        x_ref[i] = puff::dcomplex(std::sin(0.1 * i), 1.0);
+    A.SpMV(x_ref, b);
+    A.gmres(x, b, 30, 300, 1e-10);
+    const size_t plain = A.get_gmres_iterations();
+
+    for(auto method : {puff::EquilibrationMethod::RowColumn, puff::EquilibrationMethod::Ruiz})
+    {
+        A.set_equilibration(method);
+        auto& report = A.get_equilibration_report();
+        EXPECT_GT(report.row_spread_before, 1e5);
+        EXPECT_LT(report.row_spread_after, 2.0);
+        EXPECT_LT(report.col_spread_after, 2.0);
+        EXPECT_EQ(A.get_row_scale().size(), (size_t)N);
+
+        // The stored operator is unchanged
+        puff::Vector_h<puff::dcomplex> y(N);
+        A.SpMV(x_ref, y);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(y[i] - b[i]), 0.0, 1e-12 * thrust::abs(b[i]));
+
+        // Solution comes back unscaled, in fewer iterations
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.gmres(x, b, 30, 300, 1e-10);
+        const size_t equilibrated = A.get_gmres_iterations();
+        EXPECT_EQ(A.get_unequilibrated_iterations(), plain);
+        EXPECT_LT(equilibrated, plain);
+        std::cout << (method == puff::EquilibrationMethod::Ruiz ? "Ruiz" : "Row/column") << " equilibration: "
+                  << plain << " -> " << equilibrated << " GMRES iterations" << std::endl;
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-6);
+
+        // Split storage solves the same scaled system
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.gmres(x, b, 30, 300, 1e-10, false, puff::ComplexStorage::Split);
+        EXPECT_LT(A.get_gmres_iterations(), plain);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-6);
+    }
+
+    // Switching it off drops the factors
+    A.set_equilibration(puff::EquilibrationMethod::None);
+    EXPECT_TRUE(A.get_row_scale().empty());
+}
+
+TEST(PUFF, Check_Block_Jacobi_host)
+{
+    const int cells = 200, cell = 8, N = cells * cell;
+    // Strong coupling inside a unit cell, weak coupling to the neighbouring cells
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+    {
+        const int c = i / cell;
+        for(int j = c * cell; j < (c + 1) * cell; j++)
+            A.insert_entry(i, j, i == j ? puff::dcomplex(2.0, 0.5) : puff::dcomplex(1.0 / (1 + std::abs(i - j)), 0.3));
+        if(i + cell < N) A.insert_entry(i, i + cell, puff::dcomplex(0.1, 0.05));
+        if(i >= cell) A.insert_entry(i, i - cell, puff::dcomplex(0.1, -0.05));
+    }
+    A.make_matrix();
+
+    // Blocks come out column-major, with the entries of the matrix. Unequal sizes form separate batch groups
+    std::vector<uint32_t> offsets{0, 5, 8};
+    for(int c = 1; c < cells; c++) offsets.push_back((c + 1) * cell);
+    puff::BlockJacobi<puff::dcomplex> U(offsets);
+    U.extract(thrust::raw_pointer_cast(A.get_row_offsets().data()),
+              thrust::raw_pointer_cast(A.get_matrix().column_indices.data()),
+              thrust::raw_pointer_cast(A.get_matrix().values.data()));
+    EXPECT_EQ(U.num_blocks(), (size_t)cells + 1);
+    EXPECT_EQ(U.block(1)[0], puff::dcomplex(2.0, 0.5));                           // (5, 5)
+    EXPECT_EQ(U.block(1)[1], puff::dcomplex(0.5, 0.3));                           // (6, 5)
+    EXPECT_EQ(U.block(2)[cell], puff::dcomplex(0.5, 0.3));                        // (8, 9)
+    EXPECT_EQ(U.factor(), (size_t)0);
+
+    // Malformed partitions and shapes are rejected
+    EXPECT_THROW(puff::BlockJacobi<puff::dcomplex>(std::vector<uint32_t>{0}), std::invalid_argument);
+    EXPECT_THROW(puff::BlockJacobi<puff::dcomplex>(std::vector<uint32_t>{1, 8}), std::invalid_argument);
+    EXPECT_THROW(puff::BlockJacobi<puff::dcomplex>(std::vector<uint32_t>{0, 8, 5}), std::invalid_argument);
+    EXPECT_THROW(puff::BlockJacobi<puff::dcomplex>::uniform_blocks(N, 0), std::invalid_argument);
+    EXPECT_THROW(A.block_jacobi(puff::BlockJacobi<puff::dcomplex>::uniform_blocks(N - cell, cell)), std::invalid_argument);
+    puff::BlockJacobi<puff::dcomplex> unfactored(offsets);
+    puff::Vector_h<puff::dcomplex> short_r(N - 1), short_z(N - 1);
+    EXPECT_THROW(U(short_r, short_z), std::invalid_argument);
+    EXPECT_THROW(unfactored.apply(&short_r[0], &short_z[0]), std::logic_error);
+
+    // M^{-1} inverts the diagonal blocks
+    auto M = A.block_jacobi(puff::BlockJacobi<puff::dcomplex>::uniform_blocks(N, cell));
+    puff::Vector_h<puff::dcomplex> r(N), z(N);
+    for(int i = 0; i < N; i++)
+        r[i] = puff::dcomplex(std::cos(0.3 * i), std::sin(0.1 * i));
+    M(r, z);
+    for(int c = 0; c < cells; c += 37)
+        for(int i = c * cell; i < (c + 1) * cell; i++)
+        {
+            puff::dcomplex sum(0);
+            for(int j = c * cell; j < (c + 1) * cell; j++)
+                sum += (i == j ? puff::dcomplex(2.0, 0.5) : puff::dcomplex(1.0 / (1 + std::abs(i - j)), 0.3)) * z[j];
+            EXPECT_NEAR(thrust::abs(sum - r[i]), 0.0, 1e-12);
+        }
+
+    puff::Vector_h<puff::dcomplex> x_ref(N), b(N), x(N, 0);
+    for(int i = 0; i < N; i++)
+        x_ref[i] = puff::dcomplex(std::sin(0.1 * i), 1.0);
+    A.SpMV(x_ref, b);
+    A.gmres(x, b, 30, 300, 1e-10);
+    const size_t plain = A.get_gmres_iterations();
+
+    // Preconditioned, also on top of an equilibration
+    for(auto method : {puff::EquilibrationMethod::None, puff::EquilibrationMethod::Ruiz})
+    {
+        A.set_equilibration(method);
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.gmres(x, b, M, 30, 300, 1e-10);
+        EXPECT_LT(A.get_gmres_iterations(), plain);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-6);
+    }
+}
+
+TEST(PUFF, Check_Pardiso_host)
+{
+    const int N = 2000, nrhs = 3;
+    // Complex symmetric near-field like matrix, zero diagonal entries on a few rows
+    auto entry = [](int i, int j) { return i == j ? puff::dcomplex(5.0, 1.0) : puff::dcomplex(1.0 / (1 + std::abs(i - j)), 0.1 * std::min(i, j) / N); };
+    puff::SparseMatrix_h<puff::dcomplex> A, B;
+    for(int i = 0; i < N; i++)
+        for(int k = -4; k <= 4; k++)
+        {
+            const int j = i + 17 * k;
+            if(j < 0 || j >= N || (k == 0 && i % 100 == 7)) continue;
+            A.insert_entry(i, j, entry(i, j));
+            B.insert_entry(i, j, puff::dcomplex(0.5, 0.0));
+        }
+    A.make_matrix();
+    B.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> b(N * nrhs), x, r(N);
+    for(int k = 0; k < N * nrhs; k++)
+        b[k] = puff::dcomplex(std::sin(0.01 * k), std::cos(0.02 * k));
+    auto check = [&]() {
+        for(int c = 0; c < nrhs; c++)
+        {
+            puff::Vector_h<puff::dcomplex> xc(x.begin() + c * N, x.begin() + (c + 1) * N);
+            A.SpMV(xc, r);
+            for(int i = 0; i < N; i++)
+                EXPECT_NEAR(thrust::abs(r[i] - b[c * N + i]), 0.0, 1e-10);
+        }
+    };
+
+    for(auto type : {puff::PardisoMatrixType::Unsymmetric, puff::PardisoMatrixType::Symmetric})
+    {
+        A.direct_solve(x, b, nrhs, type);
+        EXPECT_EQ(x.size(), (size_t)N * nrhs);
+        EXPECT_GT(A.get_direct_solver_report().factor_entries, (size_t)0);
+        check();
+
+        // New values on the same pattern refactor, the analysis is kept
+        A.add_inplace(puff::dcomplex(1.0), puff::dcomplex(1.0), B);
+        A.direct_solve(x, b, nrhs, type);
+        check();
+        A.add_inplace(puff::dcomplex(1.0), puff::dcomplex(-1.0), B);
+    }
+    A.release_direct_solver();
+}
+
+TEST(PUFF, Check_COCG_COCR_host)
+{
+    const int cells = 250, cell = 8, N = cells * cell;
+    // Complex symmetric (not Hermitian): A(i, j) = A(j, i)
+    auto entry = [](int i, int j) {
+        const int d = std::abs(i - j);
+        return i == j ? puff::dcomplex(4.0 + (i % 5), 1.0) : puff::dcomplex(0.8 / (1 + d), 0.2 * std::cos(0.1 * (i + j)));
+    };
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+        for(int j = std::max(0, i - 12); j < std::min(N, i + 13); j++)
+            A.insert_entry(i, j, entry(i, j));
+    A.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x_ref(N), b(N), x(N);
+    for(int i = 0; i < N; i++)
+        x_ref[i] = puff::dcomplex(std::sin(0.1 * i), 1.0);
+    A.SpMV(x_ref, b);
+    auto M = A.block_jacobi(puff::BlockJacobi<puff::dcomplex>::uniform_blocks(N, cell));
+
+    // Plain and block-Jacobi preconditioned, which needs fewer iterations
+    for(bool cr : {false, true})
+    {
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        if(cr) A.cocr(x, b, 1000, 1e-10);
+        else A.cocg(x, b, 1000, 1e-10);
+        const size_t plain = A.get_gmres_iterations();
+        EXPECT_LT(plain, (size_t)1000);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-7);
+
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        if(cr) A.cocr(x, b, M, 1000, 1e-10);
+        else A.cocg(x, b, M, 1000, 1e-10);
+        EXPECT_LT(A.get_gmres_iterations(), plain);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-7);
+    }
+}
+
+TEST(PUFF, Check_IDRs_BiCGStabl_host)
+{
+    const int cells = 250, cell = 8, N = cells * cell;
+    // Non-symmetric, complex
+    auto entry = [](int i, int j) {
+        const int d = i - j;
+        return i == j ? puff::dcomplex(3.0 + (i % 5), 1.0) : puff::dcomplex(0.8 / (1 + std::abs(d)) * (d > 0 ? 1.5 : 0.5), 0.3 * std::sin(0.1 * i + 0.2 * j));
+    };
+    puff::SparseMatrix_h<puff::dcomplex> A;
+    for(int i = 0; i < N; i++)
+        for(int j = std::max(0, i - 12); j < std::min(N, i + 13); j++)
+            A.insert_entry(i, j, entry(i, j));
+    A.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x_ref(N), b(N), x(N);
+    for(int i = 0; i < N; i++)
+        x_ref[i] = puff::dcomplex(std::sin(0.1 * i), 1.0);
+    A.SpMV(x_ref, b);
+    auto M = A.block_jacobi(puff::BlockJacobi<puff::dcomplex>::uniform_blocks(N, cell));
+
+    auto check = [&]() {
+        EXPECT_LT(A.get_gmres_iterations(), (size_t)1000);
+        for(int i = 0; i < N; i++)
+            EXPECT_NEAR(thrust::abs(x[i] - x_ref[i]), 0.0, 1e-7);
+    };
+    for(size_t s : {1, 2, 4, 8})
+    {
+        // Plain and block-Jacobi preconditioned, which needs fewer iterations
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.idrs(x, b, s, 1000, 1e-10);
+        check();
+        const size_t plain = A.get_gmres_iterations();
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.idrs(x, b, M, s, 1000, 1e-10);
+        check();
+        EXPECT_LT(A.get_gmres_iterations(), plain);
+
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.bicgstabl(x, b, s, 1000, 1e-10);
+        check();
+        thrust::fill(x.begin(), x.end(), puff::dcomplex(0));
+        A.bicgstabl(x, b, M, s, 1000, 1e-10);
+        check();
+    }
+}
@@ -0,0 +1,148 @@
+#include "../include/puff.h"
+#include <gtest/gtest.h>
+#include <mpi.h>
+
+// Run with e.g. mpirun -np 4 ./test_mpi
+static constexpr int N = 100001;
+
+static double max_over_ranks(double value)
+{
+    double result;
+    MPI_Allreduce(&value, &result, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return result;
+}
+
+TEST(PUFF_MPI, Check_Distributed_SpMV_Host)
+{
+    puff::DistributedSparseMatrix_h<puff::dcomplex> A(MPI_COMM_WORLD, N, N);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Owners insert their tridiagonal rows, rank 0 adds long range couplings for every rank
+    for(size_t i = A.row_begin(); i < A.row_end(); i++)
+    {
+        A.insert_entry(i, i, puff::dcomplex(4.0, 1.0));
+        if(i > 0) A.insert_entry(i, i - 1, puff::dcomplex(-1.0, 0.5));
+        if(i + 1 < N) A.insert_entry(i, i + 1, puff::dcomplex(-1.0, -0.5));
+    }
+    if(rank == 0)
+        for(size_t i = 0; i + N / 2 < N; i += 7)
+            A.insert_entry(i, i + N / 2, puff::dcomplex(0.25, 0.0));
+    A.make_matrix();
+
+    puff::Vector_h<puff::dcomplex> x(A.local_cols()), y;
+    for(size_t i = 0; i < x.size(); i++)
+        x[i] = puff::dcomplex(1.0, double(A.col_begin() + i) / N);
+    A.SpMV(x, y);
+
+    auto X = [](size_t g) { return puff::dcomplex(1.0, double(g) / N); };
+    double err = 0;
+    for(size_t i = A.row_begin(); i < A.row_end(); i++)
+    {
+        puff::dcomplex ref = puff::dcomplex(4.0, 1.0) * X(i);
+        if(i > 0) ref += puff::dcomplex(-1.0, 0.5) * X(i - 1);
+        if(i + 1 < N) ref += puff::dcomplex(-1.0, -0.5) * X(i + 1);
+        if(i % 7 == 0 && i + N / 2 < N) ref += puff::dcomplex(0.25, 0.0) * X(i + N / 2);
+        err = std::max(err, (double)thrust::abs(ref - y[i - A.row_begin()]));
+    }
+    EXPECT_LT(max_over_ranks(err), 1e-12);
+
+    // Distributed reductions
+    double ref_norm2 = 0;
+    for(size_t g = 0; g < N; g++)
+        ref_norm2 += thrust::norm(X(g));
+    EXPECT_NEAR(A.dot(x, x).real(), ref_norm2, 1e-8 * ref_norm2);
+    EXPECT_NEAR(A.nrm2(x) * A.nrm2(x), ref_norm2, 1e-8 * ref_norm2);
+
+    // Solve A x = b with the distributed GMRES
+    puff::Vector_h<puff::dcomplex> b = y;
+    puff::Vector_h<puff::dcomplex> z(x.size(), puff::dcomplex(0, 0));
+    A.gmres(z, b, 30, 1000, 1e-10);
+    err = 0;
+    for(size_t i = 0; i < z.size(); i++)
+        err = std::max(err, (double)thrust::abs(z[i] - x[i]));
+    EXPECT_LT(max_over_ranks(err), 1e-6);
+}
+
+TEST(PUFF_MPI, Check_Distributed_CCONV3D_Host)
+{
+    const size_t Nx = 12, Ny = 10, Nz = 9;
+    auto f = [](size_t x, size_t y, size_t z) { return puff::dcomplex(std::sin(1.0 + x + 2.0 * y + 0.3 * z), std::cos(0.5 * x * y + 0.7 * z)); };
+    auto g = [](size_t x, size_t y, size_t z) { return puff::dcomplex(1.0 / (1 + x + y + z), 0.1 * x - 0.2 * z); };
+
+    puff::DistributedCCONV3D_h<puff::dcomplex> conv(MPI_COMM_WORLD, Nx, Ny, Nz);
+    auto& fft = conv.get_fft();
+    const size_t* n = fft.real_extent();
+    const size_t* o = fft.real_offset();
+    puff::Vector_h<puff::dcomplex> a(fft.real_size()), k(fft.real_size());
+    for(size_t z = 0; z < n[2]; z++)
+        for(size_t y = 0; y < n[1]; y++)
+            for(size_t x = 0; x < n[0]; x++)
+            {
+                a[(z * n[1] + y) * n[0] + x] = f(x + o[0], y + o[1], z + o[2]);
+                k[(z * n[1] + y) * n[0] + x] = g(x + o[0], y + o[1], z + o[2]);
+            }
+
+    // Forward transform against the direct DFT in the Z-pencil layout
+    puff::Vector_h<puff::dcomplex> s;
+    fft.forward(a, s);
+    const size_t* sn = fft.spectral_extent();
+    const size_t* so = fft.spectral_offset();
+    double err = 0;
+    for(size_t x = 0; x < sn[0]; x++)
+        for(size_t y = 0; y < sn[1]; y++)
+            for(size_t z = 0; z < sn[2]; z++)
+            {
+                puff::dcomplex ref(0, 0);
+                for(size_t X = 0; X < Nx; X++)
+                    for(size_t Y = 0; Y < Ny; Y++)
+                        for(size_t Z = 0; Z < Nz; Z++)
+                        {
+                            double phase = -2 * M_PI * (double((x + so[0]) * X) / Nx + double((y + so[1]) * Y) / Ny + double((z + so[2]) * Z) / Nz);
+                            ref += f(X, Y, Z) * puff::dcomplex(cos(phase), sin(phase));
+                        }
+                err = std::max(err, (double)thrust::abs(ref - s[(x * sn[1] + y) * sn[2] + z]));
+            }
+    EXPECT_LT(max_over_ranks(err), 1e-10);
+
+    // Circular convolution against the direct sum
+    conv.set_kernel(k);
+    conv.convolve(a);
+    err = 0;
+    for(size_t z = 0; z < n[2]; z++)
+        for(size_t y = 0; y < n[1]; y++)
+            for(size_t x = 0; x < n[0]; x++)
+            {
+                size_t X = x + o[0], Y = y + o[1], Z = z + o[2];
+                puff::dcomplex ref(0, 0);
+                for(size_t i = 0; i < Nx; i++)
+                    for(size_t j = 0; j < Ny; j++)
+                        for(size_t l = 0; l < Nz; l++)
+                            ref += g(i, j, l) * f((X + Nx - i) % Nx, (Y + Ny - j) % Ny, (Z + Nz - l) % Nz);
+                err = std::max(err, (double)thrust::abs(ref - a[(z * n[1] + y) * n[0] + x]));
+            }
+    EXPECT_LT(max_over_ranks(err), 1e-10);
+
+    double comm = max_over_ranks(fft.get_comm_time()), compute = max_over_ranks(fft.get_compute_time());
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank == 0)
+        printf("Distributed FFT3D: communication %f s, compute %f s\n", comm, compute);
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    ::testing::InitGoogleTest(&argc, argv);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    // Only rank 0 prints results
+    if(rank != 0)
+    {
+        auto& listeners = ::testing::UnitTest::GetInstance()->listeners();
+        delete listeners.Release(listeners.default_result_printer());
+    }
+    int result = RUN_ALL_TESTS();
+    MPI_Finalize();
+    return result;
+}